@@ -2,11 +2,13 @@
 #include "board.h"
 #include "display.h"
 #include "system_info.h"
+#include "settings.h"
 #include "audio_codec.h"
 #include "mqtt_protocol.h"
 #include "websocket_protocol.h"
 #include "assets/lang_config.h"
 #include "mcp_server.h"
+#include "display_benchmark.h"
 
 #include <cstring>
 #include <esp_log.h>
@@ -42,6 +44,8 @@ Application::Application() {
     aec_mode_ = kAecOnDeviceSide;
 #elif CONFIG_USE_SERVER_AEC
     aec_mode_ = kAecOnServerSide;
+#elif CONFIG_USE_SOFTWARE_AEC
+    aec_mode_ = kAecOnDeviceSide;
 #else
     aec_mode_ = kAecOff;
 #endif
@@ -178,7 +182,7 @@ void Application::CheckNewVersion(Ota& ota) {
 void Application::ShowActivationCode(const std::string& code, const std::string& message) {
     struct digit_sound {
         char digit;
-        const std::string_view& sound;
+        std::string_view sound;
     };
     static const std::array<digit_sound, 10> digit_sounds{{
         digit_sound{'0', Lang::Sounds::OGG_0},
@@ -212,7 +216,7 @@ void Application::Alert(const char* status, const char* message, const char* emo
     display->SetEmotion(emotion);
     display->SetChatMessage("system", message);
     if (!sound.empty()) {
-        audio_service_.PlaySound(sound);
+        audio_service_.PlaySound(sound, kAudioStreamAlert);
     }
 }
 
@@ -256,9 +260,7 @@ void Application::ToggleChatState() {
             SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
         });
     } else if (device_state_ == kDeviceStateSpeaking) {
-        Schedule([this]() {
-            AbortSpeaking(kAbortReasonNone);
-        });
+        ScheduleAbortSpeaking(kAbortReasonNone);
     } else if (device_state_ == kDeviceStateListening) {
         Schedule([this]() {
             protocol_->CloseAudioChannel();
@@ -293,7 +295,12 @@ void Application::StartListening() {
             SetListeningMode(kListeningModeManualStop);
         });
     } else if (device_state_ == kDeviceStateSpeaking) {
-        Schedule([this]() {
+        uint32_t session = speaking_session_;
+        Schedule([this, session]() {
+            if (session != speaking_session_) {
+                ESP_LOGI(TAG, "Ignoring listen request from a previous response");
+                return;
+            }
             AbortSpeaking(kAbortReasonNone);
             SetListeningMode(kListeningModeManualStop);
         });
@@ -331,6 +338,9 @@ void Application::Start() {
 
     /* Setup the display */
     auto display = board.GetDisplay();
+#if CONFIG_USE_DISPLAY_BENCHMARK
+    DisplayBenchmark(display).Run();
+#endif
 
     /* Setup the audio service */
     auto codec = board.GetAudioCodec();
@@ -342,9 +352,20 @@ void Application::Start() {
         xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
     };
     callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
+        // Barge-in: stop playback from the audio task, the main loop tells the server
+        if (device_state_ == kDeviceStateSpeaking) {
+            wake_word_session_ = speaking_session_.load();
+            audio_service_.AbortPlayback();
+        }
         xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
     };
     callbacks.on_vad_change = [this](bool speaking) {
+#if CONFIG_USE_VAD_BARGE_IN
+        if (speaking && device_state_ == kDeviceStateSpeaking && listening_mode_ == kListeningModeRealtime) {
+            audio_service_.AbortPlayback();
+            ScheduleAbortSpeaking(kAbortReasonNone);
+        }
+#endif
         xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
     };
     audio_service_.SetCallbacks(callbacks);
@@ -352,6 +373,15 @@ void Application::Start() {
     /* Start the clock timer to update the status bar */
     esp_timer_start_periodic(clock_timer_handle_, 1000000);
 
+    // 音量写入后立即刷新静音图标，不必等下一次时钟更新
+    Settings::OnChange("audio", [this](const std::string& ns, const std::string& key) {
+        if (key.empty() || key == "output_volume") {
+            Schedule([]() {
+                Board::GetInstance().GetDisplay()->UpdateStatusBar();
+            });
+        }
+    });
+
     /* Wait for the network to be ready */
     board.StartNetwork();
 
@@ -367,6 +397,9 @@ void Application::Start() {
 
     // Add MCP common tools before initializing the protocol
     McpServer::GetInstance().AddCommonTools();
+#if CONFIG_USE_MCP_BENCHMARK
+    McpServer::GetInstance().RunBenchmark();
+#endif
 
     if (ota.HasMqttConfig()) {
         protocol_ = std::make_unique<MqttProtocol>();
@@ -411,6 +444,10 @@ void Application::Start() {
         if (strcmp(type->valuestring, "tts") == 0) {
             auto state = cJSON_GetObjectItem(root, "state");
             if (strcmp(state->valuestring, "start") == 0) {
+                // Reopen right away so the first packets of this response are not dropped,
+                // aborts still queued for the previous response are stale from here on
+                speaking_session_++;
+                audio_service_.ResumePlayback();
                 Schedule([this]() {
                     aborted_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
@@ -614,7 +651,11 @@ void Application::OnWakeWordDetected() {
         audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
 #endif
     } else if (device_state_ == kDeviceStateSpeaking) {
-        AbortSpeaking(kAbortReasonWakeWordDetected);
+        if (wake_word_session_ == speaking_session_) {
+            AbortSpeaking(kAbortReasonWakeWordDetected);
+        } else {
+            ESP_LOGI(TAG, "Ignoring wake word from a previous response");
+        }
     } else if (device_state_ == kDeviceStateActivating) {
         SetDeviceState(kDeviceStateIdle);
     }
@@ -623,9 +664,22 @@ void Application::OnWakeWordDetected() {
 void Application::AbortSpeaking(AbortReason reason) {
     ESP_LOGI(TAG, "Abort speaking");
     aborted_ = true;
+    audio_service_.AbortPlayback();
     protocol_->SendAbortSpeaking(reason);
 }
 
+// Abort from the main loop, unless the response it was meant for has been replaced by then
+void Application::ScheduleAbortSpeaking(AbortReason reason) {
+    uint32_t session = speaking_session_;
+    Schedule([this, reason, session]() {
+        if (session != speaking_session_ || device_state_ != kDeviceStateSpeaking) {
+            ESP_LOGI(TAG, "Ignoring abort of a previous response");
+            return;
+        }
+        AbortSpeaking(reason);
+    });
+}
+
 void Application::SetListeningMode(ListeningMode mode) {
     listening_mode_ = mode;
     SetDeviceState(kDeviceStateListening);
@@ -660,10 +714,13 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetStatus(Lang::Strings::CONNECTING);
             display->SetEmotion("neutral");
             display->SetChatMessage("system", "");
+            // Listening and the reply follow shortly, warm the codec up while the channel opens
+            audio_service_.Prewarm();
             break;
         case kDeviceStateListening:
             display->SetStatus(Lang::Strings::LISTENING);
             display->SetEmotion("neutral");
+            audio_service_.Prewarm();
 
             // Make sure the audio processor is running
             if (!audio_service_.IsAudioProcessorRunning()) {
@@ -695,6 +752,7 @@ void Application::SetDeviceState(DeviceState state) {
 
 void Application::Reboot() {
     ESP_LOGI(TAG, "Rebooting...");
+    Settings::Flush();
     esp_restart();
 }
 
@@ -707,9 +765,7 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
             }
         }); 
     } else if (device_state_ == kDeviceStateSpeaking) {
-        Schedule([this]() {
-            AbortSpeaking(kAbortReasonNone);
-        });
+        ScheduleAbortSpeaking(kAbortReasonNone);
     } else if (device_state_ == kDeviceStateListening) {   
         Schedule([this]() {
             if (protocol_) {
@@ -736,10 +792,10 @@ bool Application::CanEnterSleepMode() {
     return true;
 }
 
-void Application::SendMcpMessage(const std::string& payload) {
-    Schedule([this, payload]() {
+void Application::SendMcpMessage(std::shared_ptr<MessageBuffer> message) {
+    Schedule([this, message = std::move(message)]() {
         if (protocol_) {
-            protocol_->SendMcpMessage(payload);
+            protocol_->SendMcpMessage(*message);
         }
     });
 }
@@ -10,6 +10,7 @@
 #include <mutex>
 #include <deque>
 #include <memory>
+#include <atomic>
 
 #include "protocol.h"
 #include "ota.h"
@@ -54,7 +55,7 @@ public:
     void Reboot();
     void WakeWordInvoke(const std::string& wake_word);
     bool CanEnterSleepMode();
-    void SendMcpMessage(const std::string& payload);
+    void SendMcpMessage(std::shared_ptr<MessageBuffer> message);
     void SetAecMode(AecMode mode);
     AecMode GetAecMode() const { return aec_mode_; }
     void PlaySound(const std::string_view& sound);
@@ -77,6 +78,9 @@ private:
 
     bool has_server_time_ = false;
     bool aborted_ = false;
+    // Bumped on every "tts start", scheduled aborts carry the value they were requested under
+    std::atomic<uint32_t> speaking_session_{0};
+    std::atomic<uint32_t> wake_word_session_{UINT32_MAX};
     int clock_ticks_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
 
@@ -85,6 +89,7 @@ private:
     void ShowActivationCode(const std::string& code, const std::string& message);
     void OnClockTimer();
     void SetListeningMode(ListeningMode mode);
+    void ScheduleAbortSpeaking(AbortReason reason);
 };
 
 #endif // _APPLICATION_H_
@@ -0,0 +1,108 @@
+#include "assets.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_rom_crc.h>
+
+#include <cstring>
+
+#define TAG "Assets"
+
+#define ASSETS_PARTITION_LABEL "assets"
+
+Assets::~Assets() {
+    if (data_ != nullptr) {
+        esp_partition_munmap(mmap_handle_);
+    }
+}
+
+void Assets::Map() {
+    auto start_time = esp_timer_get_time();
+    auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, ASSETS_PARTITION_LABEL);
+    if (partition == nullptr) {
+        ESP_LOGW(TAG, "No %s partition", ASSETS_PARTITION_LABEL);
+        return;
+    }
+
+    // 先读取头部确认格式，只映射实际使用的部分
+    AssetsHeader header;
+    if (esp_partition_read(partition, 0, &header, sizeof(header)) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read assets header");
+        return;
+    }
+    if (memcmp(header.magic, ASSETS_MAGIC, sizeof(header.magic)) != 0) {
+        ESP_LOGW(TAG, "Partition %s does not contain packed assets", ASSETS_PARTITION_LABEL);
+        return;
+    }
+    if (header.version != ASSETS_VERSION || header.entry_size != sizeof(AssetsEntry)) {
+        ESP_LOGE(TAG, "Unsupported assets version %u, entry size %u", header.version, header.entry_size);
+        return;
+    }
+    size_t index_end = sizeof(AssetsHeader) + (size_t)header.count * sizeof(AssetsEntry);
+    if (header.total_size > partition->size || index_end > header.total_size) {
+        ESP_LOGE(TAG, "Invalid assets size %lu, partition size %lu", header.total_size, partition->size);
+        return;
+    }
+
+    const void* mapped = nullptr;
+    esp_partition_mmap_handle_t handle;
+    auto err = esp_partition_mmap(partition, 0, header.total_size, ESP_PARTITION_MMAP_DATA, &mapped, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map assets partition: %s", esp_err_to_name(err));
+        return;
+    }
+
+    auto data = static_cast<const uint8_t*>(mapped);
+    auto entries = reinterpret_cast<const AssetsEntry*>(data + sizeof(AssetsHeader));
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(entries), header.count * sizeof(AssetsEntry));
+    if (crc != header.index_crc32) {
+        ESP_LOGE(TAG, "Assets index checksum mismatch");
+        esp_partition_munmap(handle);
+        return;
+    }
+    for (uint32_t i = 0; i < header.count; i++) {
+        if (entries[i].offset < index_end || entries[i].offset > header.total_size ||
+            entries[i].size > header.total_size - entries[i].offset) {
+            ESP_LOGE(TAG, "Asset %.*s is out of bounds", ASSETS_NAME_SIZE, entries[i].name);
+            esp_partition_munmap(handle);
+            return;
+        }
+    }
+
+    data_ = data;
+    entries_ = entries;
+    count_ = header.count;
+    total_size_ = header.total_size;
+    mmap_handle_ = handle;
+    ESP_LOGI(TAG, "Mapped %lu assets, %lu bytes in %lld us", count_, total_size_, esp_timer_get_time() - start_time);
+}
+
+bool Assets::IsAvailable() {
+    std::call_once(map_once_, [this]() { Map(); });
+    return data_ != nullptr;
+}
+
+std::string_view Assets::Get(std::string_view name) {
+    if (!IsAvailable() || name.size() >= ASSETS_NAME_SIZE) {
+        return std::string_view();
+    }
+
+    // 索引按名称排序，直接在映射的 Flash 上二分查找
+    uint32_t low = 0;
+    uint32_t high = count_;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        auto& entry = entries_[mid];
+        std::string_view entry_name(entry.name, strnlen(entry.name, ASSETS_NAME_SIZE));
+        int result = entry_name.compare(name);
+        if (result == 0) {
+            return std::string_view(reinterpret_cast<const char*>(data_ + entry.offset), entry.size);
+        } else if (result < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    ESP_LOGW(TAG, "Asset not found: %.*s", (int)name.size(), name.data());
+    return std::string_view();
+}
@@ -0,0 +1,62 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <esp_partition.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+
+#define ASSETS_MAGIC "XZAS"
+#define ASSETS_VERSION 1
+#define ASSETS_NAME_SIZE 48
+
+// assets 分区打包格式（由 scripts/pack_assets.py 生成，小端序）：
+//   AssetsHeader | AssetsEntry[count]（按名称升序） | 数据（4 字节对齐）
+struct AssetsHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t entry_size;    // sizeof(AssetsEntry)
+    uint32_t count;
+    uint32_t total_size;    // Header, index and data
+    uint32_t index_crc32;   // CRC32 of the entry table, checked when mapping
+    uint32_t data_crc32;    // CRC32 of the data region, checked by the host tool
+};
+
+struct AssetsEntry {
+    char name[ASSETS_NAME_SIZE];    // NUL-terminated path, e.g. "locales/en-US/0.ogg"
+    uint32_t offset;                // From the start of the partition
+    uint32_t size;
+};
+
+static_assert(sizeof(AssetsHeader) == 24, "AssetsHeader layout must match pack_assets.py");
+static_assert(sizeof(AssetsEntry) == ASSETS_NAME_SIZE + 8, "AssetsEntry layout must match pack_assets.py");
+
+// 首次查找时将 assets 分区映射到地址空间，索引直接在 Flash 上二分查找，
+// 资源以 std::string_view 零拷贝返回，映射在程序运行期间一直有效
+class Assets {
+public:
+    static Assets& GetInstance() {
+        static Assets instance;
+        return instance;
+    }
+
+    // Returns an empty view when the asset or the partition is missing
+    std::string_view Get(std::string_view name);
+    bool IsAvailable();
+
+private:
+    Assets() = default;
+    ~Assets();
+
+    std::once_flag map_once_;
+    const uint8_t* data_ = nullptr;
+    const AssetsEntry* entries_ = nullptr;
+    uint32_t count_ = 0;
+    uint32_t total_size_ = 0;
+    esp_partition_mmap_handle_t mmap_handle_ = 0;
+
+    void Map();
+};
+
+#endif // ASSETS_H
@@ -0,0 +1,108 @@
+#include "audio_capture_ring.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#define TAG "AudioCaptureRing"
+
+AudioCaptureRing::AudioCaptureRing(int channels, size_t capacity_frames)
+    : channels_(channels), capacity_(1) {
+    // 容量取 2 的幂，帧计数器在 32 位回绕时槽位仍然连续
+    while (capacity_ < capacity_frames) {
+        capacity_ <<= 1;
+    }
+    size_t size = capacity_ * channels_ * sizeof(int16_t);
+#if CONFIG_SPIRAM
+    buffer_ = (int16_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+#endif
+    if (buffer_ == nullptr) {
+        buffer_ = (int16_t*)heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    assert(buffer_ != nullptr);
+    memset(buffer_, 0, size);
+    ESP_LOGI(TAG, "Capture ring: %u frames x %d channels, %u bytes", (unsigned)capacity_, channels_, (unsigned)size);
+}
+
+AudioCaptureRing::~AudioCaptureRing() {
+    heap_caps_free(buffer_);
+}
+
+void AudioCaptureRing::Write(const int16_t* data, size_t frames) {
+    if (frames > capacity_) {
+        data += (frames - capacity_) * channels_;
+        frames = capacity_;
+    }
+    if (frames > max_write_frames_.load(std::memory_order_relaxed)) {
+        max_write_frames_.store(frames, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint32_t position = write_position_.load(std::memory_order_relaxed);
+    size_t offset = position % capacity_;
+    size_t first = std::min(frames, capacity_ - offset);
+    memcpy(buffer_ + offset * channels_, data, first * channels_ * sizeof(int16_t));
+    if (first < frames) {
+        memcpy(buffer_, data + first * channels_, (frames - first) * channels_ * sizeof(int16_t));
+    }
+    write_position_.store(position + frames, std::memory_order_release);
+}
+
+void AudioCaptureRing::Attach(Cursor& cursor, size_t preroll_frames) {
+    uint32_t write_position = write_position_.load(std::memory_order_acquire);
+    // 预读不能超过环中仍然有效的数据
+    size_t limit = capacity_ - max_write_frames_.load(std::memory_order_relaxed);
+    preroll_frames = std::min({ preroll_frames, limit, (size_t)write_position });
+    cursor.position.store(write_position - preroll_frames, std::memory_order_release);
+}
+
+// The slots of [read_position, write_position) stay valid until the producer wraps onto them
+bool AudioCaptureRing::CheckOverrun(Cursor& cursor, uint32_t read_position, uint32_t write_position) {
+    uint32_t behind = write_position - read_position;
+    if (behind + max_write_frames_.load(std::memory_order_relaxed) <= capacity_) {
+        return false;
+    }
+
+    cursor.overruns++;
+    cursor.dropped_frames += behind;
+    cursor.position.store(write_position, std::memory_order_release);
+    ESP_LOGW(TAG, "Consumer %s overrun, dropped %u frames (%u overruns)", cursor.name, (unsigned)behind,
+        (unsigned)cursor.overruns);
+    return true;
+}
+
+size_t AudioCaptureRing::Available(Cursor& cursor) {
+    uint32_t write_position = write_position_.load(std::memory_order_acquire);
+    uint32_t read_position = cursor.position.load(std::memory_order_acquire);
+    if (CheckOverrun(cursor, read_position, write_position)) {
+        return 0;
+    }
+    return write_position - read_position;
+}
+
+bool AudioCaptureRing::Read(Cursor& cursor, std::vector<int16_t>& data, size_t frames) {
+    uint32_t write_position = write_position_.load(std::memory_order_acquire);
+    uint32_t read_position = cursor.position.load(std::memory_order_acquire);
+    if (CheckOverrun(cursor, read_position, write_position) || write_position - read_position < frames) {
+        return false;
+    }
+
+    data.resize(frames * channels_);
+    size_t offset = read_position % capacity_;
+    size_t first = std::min(frames, capacity_ - offset);
+    memcpy(data.data(), buffer_ + offset * channels_, first * channels_ * sizeof(int16_t));
+    if (first < frames) {
+        memcpy(data.data() + first * channels_, buffer_, (frames - first) * channels_ * sizeof(int16_t));
+    }
+
+    // 复制期间生产者可能已经覆盖了这段数据，此时丢弃本次读取
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (CheckOverrun(cursor, read_position, write_position_.load(std::memory_order_acquire))) {
+        return false;
+    }
+    cursor.position.store(read_position + frames, std::memory_order_release);
+    return true;
+}
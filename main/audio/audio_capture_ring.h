@@ -0,0 +1,56 @@
+#ifndef AUDIO_CAPTURE_RING_H
+#define AUDIO_CAPTURE_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Microphone capture ring, written by the audio input task only.
+ *
+ * Samples are stored as interleaved 16 kHz frames (mic, plus the reference channel when the codec
+ * has one). Every consumer keeps its own cursor and reads at its own chunk size, so wake word,
+ * audio processor and testing see the same continuous stream. Positions are free-running frame
+ * counters; a consumer that falls more than the ring capacity behind is resynchronized and the
+ * overrun is counted on its cursor.
+ */
+class AudioCaptureRing {
+public:
+    struct Cursor {
+        const char* name = "";
+        std::atomic<uint32_t> position{0};
+        uint32_t overruns = 0;
+        uint32_t dropped_frames = 0;
+
+        Cursor(const char* name) : name(name) {}
+    };
+
+    AudioCaptureRing(int channels, size_t capacity_frames);
+    ~AudioCaptureRing();
+
+    int channels() const { return channels_; }
+    size_t capacity() const { return capacity_; }
+    uint32_t write_position() const { return write_position_.load(std::memory_order_acquire); }
+
+    // Producer side
+    void Write(const int16_t* data, size_t frames);
+
+    // Start reading from the current position, or up to preroll_frames earlier
+    void Attach(Cursor& cursor, size_t preroll_frames = 0);
+    size_t Available(Cursor& cursor);
+    // Copy exactly `frames` interleaved frames, returns false if not enough data is buffered yet
+    bool Read(Cursor& cursor, std::vector<int16_t>& data, size_t frames);
+
+private:
+    int channels_;
+    size_t capacity_;
+    int16_t* buffer_ = nullptr;
+    std::atomic<uint32_t> write_position_{0};
+    // Frames the producer may be overwriting ahead of write_position_
+    std::atomic<uint32_t> max_write_frames_{0};
+
+    bool CheckOverrun(Cursor& cursor, uint32_t read_position, uint32_t write_position);
+};
+
+#endif // AUDIO_CAPTURE_RING_H
@@ -18,6 +18,25 @@ void AudioCodec::OutputData(std::vector<int16_t>& data) {
     Write(data.data(), data.size());
 }
 
+bool AudioCodec::FlushOutput() {
+    if (tx_handle_ == nullptr) {
+        return false;
+    }
+    // 停止 TX 通道，用静音预加载整个 DMA 环覆盖尚未播放的数据后重新启动
+    if (i2s_channel_disable(tx_handle_) != ESP_OK) {
+        return false;
+    }
+    static const uint8_t silence[256] = {};
+    size_t loaded = sizeof(silence);
+    while (loaded == sizeof(silence)) {
+        if (i2s_channel_preload_data(tx_handle_, silence, sizeof(silence), &loaded) != ESP_OK) {
+            break;
+        }
+    }
+    ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
+    return true;
+}
+
 bool AudioCodec::InputData(std::vector<int16_t>& data) {
     int samples = Read(data.data(), data.size());
     if (samples > 0) {
@@ -68,5 +87,14 @@ void AudioCodec::EnableOutput(bool enable) {
         return;
     }
     output_enabled_ = enable;
+    output_standby_ = false;
     ESP_LOGI(TAG, "Set output enable to %s", enable ? "true" : "false");
 }
+
+void AudioCodec::SetOutputStandby(bool standby) {
+    if (standby == output_standby_) {
+        return;
+    }
+    output_standby_ = standby;
+    ESP_LOGI(TAG, "Set output standby to %s", standby ? "true" : "false");
+}
@@ -23,8 +23,13 @@ public:
     virtual void SetOutputVolume(int volume);
     virtual void EnableInput(bool enable);
     virtual void EnableOutput(bool enable);
+    // Warm standby: I2S clocks and codec stay on, the output is muted or powered down where the codec allows
+    virtual void SetOutputStandby(bool standby);
 
     virtual void OutputData(std::vector<int16_t>& data);
+    // Drop the audio still queued in the TX DMA ring and play silence instead, false if not supported.
+    // Called from the output task between two OutputData() calls
+    virtual bool FlushOutput();
     virtual bool InputData(std::vector<int16_t>& data);
     virtual void Start();
 
@@ -37,6 +42,7 @@ public:
     inline int output_volume() const { return output_volume_; }
     inline bool input_enabled() const { return input_enabled_; }
     inline bool output_enabled() const { return output_enabled_; }
+    inline bool output_standby() const { return output_standby_; }
 
 protected:
     i2s_chan_handle_t tx_handle_ = nullptr;
@@ -46,6 +52,7 @@ protected:
     bool input_reference_ = false;
     bool input_enabled_ = false;
     bool output_enabled_ = false;
+    bool output_standby_ = false;
     int input_sample_rate_ = 0;
     int output_sample_rate_ = 0;
     int input_channels_ = 1;
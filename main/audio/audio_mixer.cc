@@ -0,0 +1,215 @@
+#include "audio_mixer.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+
+#define TAG "AudioMixer"
+
+#define MIXER_UNITY_GAIN (1 << 15)
+#define MIXER_ATTACK_MS 20
+#define MIXER_RELEASE_MS 300
+
+struct AudioStreamRule {
+    const char* name;
+    // Gain applied to lower priority streams while this one has audio, Q15
+    int32_t duck_gain;
+};
+
+// Ordered by priority, lowest first
+static const AudioStreamRule kStreamRules[kAudioStreamCount] = {
+    { "voice", MIXER_UNITY_GAIN },
+    { "sound", MIXER_UNITY_GAIN / 4 },  // -12 dB
+    { "alert", MIXER_UNITY_GAIN / 8 },  // -18 dB
+};
+
+/*
+ * Add `samples` of `src` to the accumulator while the Q30 gain moves by `increment` per sample.
+ * Unrolled by four; a 16-bit sample times a Q15 gain of at most 1.0 fits in 32 bits.
+ */
+static void MixInto(int32_t* acc, const int16_t* src, size_t samples, int32_t& gain, int32_t increment) {
+    size_t i = 0;
+    if (increment == 0 && gain == (MIXER_UNITY_GAIN << 15)) {
+        for (; i + 4 <= samples; i += 4) {
+            acc[i] += src[i];
+            acc[i + 1] += src[i + 1];
+            acc[i + 2] += src[i + 2];
+            acc[i + 3] += src[i + 3];
+        }
+        for (; i < samples; i++) {
+            acc[i] += src[i];
+        }
+        return;
+    }
+    for (; i + 4 <= samples; i += 4) {
+        acc[i] += (src[i] * (gain >> 15)) >> 15;
+        acc[i + 1] += (src[i + 1] * ((gain + increment) >> 15)) >> 15;
+        acc[i + 2] += (src[i + 2] * ((gain + increment * 2) >> 15)) >> 15;
+        acc[i + 3] += (src[i + 3] * ((gain + increment * 3) >> 15)) >> 15;
+        gain += increment * 4;
+    }
+    for (; i < samples; i++) {
+        acc[i] += (src[i] * (gain >> 15)) >> 15;
+        gain += increment;
+    }
+}
+
+static void Saturate(const int32_t* acc, int16_t* dst, size_t samples) {
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        dst[i] = std::clamp<int32_t>(acc[i], INT16_MIN, INT16_MAX);
+        dst[i + 1] = std::clamp<int32_t>(acc[i + 1], INT16_MIN, INT16_MAX);
+        dst[i + 2] = std::clamp<int32_t>(acc[i + 2], INT16_MIN, INT16_MAX);
+        dst[i + 3] = std::clamp<int32_t>(acc[i + 3], INT16_MIN, INT16_MAX);
+    }
+    for (; i < samples; i++) {
+        dst[i] = std::clamp<int32_t>(acc[i], INT16_MIN, INT16_MAX);
+    }
+}
+
+void AudioMixer::Initialize(int sample_rate) {
+    attack_step_ = std::max(MIXER_UNITY_GAIN / (sample_rate * MIXER_ATTACK_MS / 1000), 1);
+    release_step_ = std::max(MIXER_UNITY_GAIN / (sample_rate * MIXER_RELEASE_MS / 1000), 1);
+    for (auto& stream : streams_) {
+        stream.gain = MIXER_UNITY_GAIN;
+    }
+}
+
+void AudioMixer::Push(AudioStreamType stream, std::vector<int16_t>&& pcm, uint32_t timestamp) {
+    if (pcm.empty()) {
+        return;
+    }
+    auto& s = streams_[stream];
+    if (s.buffered == 0) {
+        ESP_LOGD(TAG, "Stream %s started", kStreamRules[stream].name);
+    }
+    s.buffered += pcm.size();
+    s.chunks.push_back(Chunk{std::move(pcm), timestamp});
+}
+
+bool AudioMixer::empty() const {
+    for (auto& stream : streams_) {
+        if (stream.buffered > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AudioMixer::Clear(AudioStreamType stream) {
+    auto& s = streams_[stream];
+    s.chunks.clear();
+    s.offset = 0;
+    s.buffered = 0;
+    s.fade_remaining = 0;
+}
+
+void AudioMixer::FadeOut(AudioStreamType stream, size_t samples) {
+    auto& s = streams_[stream];
+    if (s.buffered == 0) {
+        return;
+    }
+
+    size_t keep = std::min(s.buffered, samples);
+    size_t total = 0;
+    for (auto it = s.chunks.begin(); it != s.chunks.end(); ++it) {
+        size_t start = (it == s.chunks.begin()) ? s.offset : 0;
+        size_t available = it->pcm.size() - start;
+        if (total + available >= keep) {
+            it->pcm.resize(start + keep - total);
+            s.chunks.erase(it + 1, s.chunks.end());
+            break;
+        }
+        total += available;
+    }
+    s.buffered = keep;
+    s.fade_remaining = keep;
+}
+
+int32_t AudioMixer::TargetGain(int stream) const {
+    int32_t gain = MIXER_UNITY_GAIN;
+    for (int i = stream + 1; i < kAudioStreamCount; i++) {
+        if (streams_[i].buffered > 0) {
+            gain = std::min(gain, kStreamRules[i].duck_gain);
+        }
+    }
+    return gain;
+}
+
+int32_t AudioMixer::RampGain(int32_t gain, int32_t target, size_t samples) const {
+    if (gain > target) {
+        return std::max<int32_t>(gain - attack_step_ * (int32_t)samples, target);
+    }
+    return std::min<int32_t>(gain + release_step_ * (int32_t)samples, target);
+}
+
+bool AudioMixer::Mix(std::vector<int16_t>& output, uint32_t& timestamp, size_t max_samples) {
+    mixed_streams_ = 0;
+    size_t samples = 0;
+    for (auto& stream : streams_) {
+        samples = std::max(samples, std::min(stream.buffered, max_samples));
+    }
+    if (samples == 0) {
+        return false;
+    }
+
+    // Targets are taken before consuming, so a stream ending in this chunk still ducks all of it
+    int32_t targets[kAudioStreamCount];
+    for (int i = 0; i < kAudioStreamCount; i++) {
+        targets[i] = TargetGain(i);
+    }
+
+    timestamp = 0;
+    accumulator_.assign(samples, 0);
+    for (int i = 0; i < kAudioStreamCount; i++) {
+        auto& stream = streams_[i];
+        size_t count = std::min(stream.buffered, samples);
+        if (count == 0) {
+            // Idle streams follow their target so they resume at the right level
+            stream.gain = RampGain(stream.gain, targets[i], samples);
+            continue;
+        }
+
+        mixed_streams_ |= 1 << i;
+        int32_t next_gain;
+        bool fading = stream.fade_remaining > 0;
+        if (fading) {
+            // Audio pushed after FadeOut() starts in the next mix
+            count = std::min(count, stream.fade_remaining);
+            next_gain = stream.gain * (int32_t)(stream.fade_remaining - count) / (int32_t)stream.fade_remaining;
+            stream.fade_remaining -= count;
+        } else {
+            next_gain = RampGain(stream.gain, targets[i], count);
+        }
+        int32_t gain = stream.gain << 15;
+        int32_t increment = ((next_gain - stream.gain) << 15) / (int32_t)count;
+        size_t mixed = 0;
+        while (mixed < count) {
+            auto& chunk = stream.chunks.front();
+            if (stream.offset == 0 && chunk.timestamp != 0 && timestamp == 0) {
+                timestamp = chunk.timestamp;
+            }
+            size_t n = std::min(chunk.pcm.size() - stream.offset, count - mixed);
+            MixInto(accumulator_.data() + mixed, chunk.pcm.data() + stream.offset, n, gain, increment);
+            mixed += n;
+            stream.offset += n;
+            if (stream.offset == chunk.pcm.size()) {
+                stream.chunks.pop_front();
+                stream.offset = 0;
+            }
+        }
+        stream.buffered -= count;
+        stream.gain = next_gain;
+        if (fading && stream.fade_remaining == 0) {
+            // Faded out, the next audio on this stream starts at its normal level
+            stream.gain = targets[i];
+        }
+        if (stream.buffered == 0) {
+            ESP_LOGD(TAG, "Stream %s drained", kStreamRules[i].name);
+        }
+    }
+
+    output.resize(samples);
+    Saturate(accumulator_.data(), output.data(), samples);
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+enum AudioStreamType {
+    kAudioStreamVoice,  // Server TTS and the audio testing loopback
+    kAudioStreamSound,  // UI prompts from PlaySound()
+    kAudioStreamAlert,  // Alert() sounds
+    kAudioStreamCount,
+};
+
+/*
+ * Mixes the decoded output streams into the single PCM stream sent to the codec.
+ *
+ * Each stream buffers its own decoded chunks, so a prompt no longer queues behind TTS. While a
+ * stream has audio, every lower priority stream is ducked to the gain in its rule; gains ramp
+ * quickly down and slowly back up so ducking doesn't click or pump. The mix is what the speaker
+ * plays, so it also serves as the echo reference, and it carries the timestamp of the voice chunk
+ * it starts for server AEC.
+ *
+ * Not thread-safe, AudioService calls it under audio_queue_mutex_.
+ */
+class AudioMixer {
+public:
+    void Initialize(int sample_rate);
+
+    void Push(AudioStreamType stream, std::vector<int16_t>&& pcm, uint32_t timestamp = 0);
+    size_t buffered_samples(AudioStreamType stream) const { return streams_[stream].buffered; }
+    bool empty() const;
+    void Clear(AudioStreamType stream);
+    // Keep at most `samples` of the stream and fade them out to silence
+    void FadeOut(AudioStreamType stream, size_t samples);
+
+    // Mix up to `max_samples` into `output`, returns false when no stream has audio
+    bool Mix(std::vector<int16_t>& output, uint32_t& timestamp, size_t max_samples);
+    // Bit n is set if stream n contributed to the last Mix()
+    uint32_t mixed_streams() const { return mixed_streams_; }
+
+private:
+    struct Chunk {
+        std::vector<int16_t> pcm;
+        uint32_t timestamp;
+    };
+
+    struct Stream {
+        std::deque<Chunk> chunks;
+        size_t offset = 0;      // Samples of the front chunk already mixed
+        size_t buffered = 0;
+        int32_t gain = 0;       // Q15
+        size_t fade_remaining = 0;
+    };
+
+    std::array<Stream, kAudioStreamCount> streams_;
+    std::vector<int32_t> accumulator_;
+    int32_t attack_step_ = 1;
+    int32_t release_step_ = 1;
+    uint32_t mixed_streams_ = 0;
+
+    int32_t TargetGain(int stream) const;
+    int32_t RampGain(int32_t gain, int32_t target, size_t samples) const;
+};
+
+#endif // AUDIO_MIXER_H
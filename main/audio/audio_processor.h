@@ -17,6 +17,8 @@ public:
     virtual void Stop() = 0;
     virtual bool IsRunning() = 0;
     virtual void OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) = 0;
+    // Return an output frame after it has been consumed, so the processor can reuse its buffer
+    virtual void RecycleOutput(std::vector<int16_t>&& data) = 0;
     virtual void OnVadStateChange(std::function<void(bool speaking)> callback) = 0;
     virtual size_t GetFeedSize() = 0;
     virtual void EnableDeviceAec(bool enable) = 0;
@@ -1,5 +1,6 @@
 #include "audio_service.h"
 #include <esp_log.h>
+#include <algorithm>
 #include <cstring>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
@@ -35,7 +36,7 @@ void AudioService::Initialize(AudioCodec* codec) {
     codec_->Start();
 
     /* Setup the audio codec */
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
+    output_streams_[kAudioStreamVoice].decoder = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
     opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
     opus_encoder_->SetComplexity(0);
 
@@ -43,6 +44,20 @@ void AudioService::Initialize(AudioCodec* codec) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
         reference_resampler_.Configure(codec->input_sample_rate(), 16000);
     }
+    output_frame_samples_ = codec->output_sample_rate() * OPUS_FRAME_DURATION_MS / 1000;
+    output_chunk_samples_ = codec->output_sample_rate() * AUDIO_OUTPUT_CHUNK_MS / 1000;
+    mixer_.Initialize(codec->output_sample_rate());
+    capture_ring_ = std::make_unique<AudioCaptureRing>(codec->input_channels(), AUDIO_CAPTURE_RING_MS * 16000 / 1000);
+
+#if CONFIG_USE_SOFTWARE_AEC
+    /* Without a hardware loopback channel, the echo reference comes from the playback path */
+    if (!codec->input_reference()) {
+        playback_reference_ = std::make_unique<PlaybackReference>(AUDIO_CAPTURE_RING_MS * 16000 / 1000);
+        if (codec->output_sample_rate() != 16000) {
+            playback_reference_resampler_.Configure(codec->output_sample_rate(), 16000);
+        }
+    }
+#endif
 
 #if CONFIG_USE_AUDIO_PROCESSOR
     audio_processor_ = std::make_unique<AfeAudioProcessor>();
@@ -145,45 +160,31 @@ void AudioService::Stop() {
 
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     audio_encode_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
     audio_testing_queue_.clear();
+    for (int i = 0; i < kAudioStreamCount; i++) {
+        output_streams_[i].decode_queue.clear();
+        mixer_.Clear((AudioStreamType)i);
+    }
     audio_queue_cv_.notify_all();
 }
 
 bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
-    if (!codec_->input_enabled()) {
-        esp_timer_stop(audio_power_timer_);
-        esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
-        codec_->EnableInput(true);
-    }
+    WakeInput();
 
     if (codec_->input_sample_rate() != sample_rate) {
-        data.resize(samples * codec_->input_sample_rate() / sample_rate * codec_->input_channels());
-        if (!codec_->InputData(data)) {
+        /* Read at the codec rate and resample each channel straight into the caller's buffer */
+        int channels = codec_->input_channels();
+        input_buffer_.resize(samples * codec_->input_sample_rate() / sample_rate * channels);
+        if (!codec_->InputData(input_buffer_)) {
             return false;
         }
-        if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
-        } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+        size_t frames = input_buffer_.size() / channels;
+        data.resize(input_resampler_.GetOutputSamples(frames) * channels);
+        size_t produced = input_resampler_.Process(input_buffer_.data(), frames, data.data(), channels);
+        if (channels == 2) {
+            reference_resampler_.Process(input_buffer_.data() + 1, frames, data.data() + 1, channels);
         }
+        data.resize(produced * channels);
     } else {
         data.resize(samples * codec_->input_channels());
         if (!codec_->InputData(data)) {
@@ -191,8 +192,10 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
         }
     }
 
-    /* Update the last input time */
-    last_input_time_ = std::chrono::steady_clock::now();
+    if (input_warmup_measuring_) {
+        MeasureInputWarmup(data);
+    }
+
     debug_statistics_.input_count++;
 
 #if CONFIG_USE_AUDIO_DEBUGGER
@@ -207,30 +210,50 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
 }
 
 void AudioService::AudioInputTask() {
+    std::vector<int16_t> capture_buffer;
+    std::vector<int16_t> data;
     while (true) {
         EventBits_t bits = xEventGroupWaitBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
-            AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING,
+            AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING | AS_EVENT_PREWARM,
             pdFALSE, pdFALSE, portMAX_DELAY);
 
         if (service_stopped_) {
             break;
         }
+        if (bits & AS_EVENT_PREWARM) {
+            xEventGroupClearBits(event_group_, AS_EVENT_PREWARM);
+            PrewarmCodec();
+            if (!(bits & (AS_EVENT_AUDIO_TESTING_RUNNING | AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING))) {
+                continue;
+            }
+        }
         if (audio_input_need_warmup_) {
             audio_input_need_warmup_ = false;
-            vTaskDelay(pdMS_TO_TICKS(120));
+            WakeInput();
+        }
+
+        /* Capture once, every running consumer reads the same samples from the ring */
+        if (!ReadAudioData(capture_buffer, 16000, AUDIO_CAPTURE_CHUNK_MS * 16000 / 1000)) {
+            ESP_LOGE(TAG, "Failed to read audio data, bits: %lx", bits);
+            break;
+        }
+        /* A cold codec is still settling, drop its samples for at most the measured warm-up time */
+        if (input_warmup_measuring_ &&
+            esp_timer_get_time() - input_enable_time_us_.load() < input_warmup_ms_ * 1000LL) {
             continue;
         }
+        capture_ring_->Write(capture_buffer.data(), capture_buffer.size() / capture_ring_->channels());
+        capture_time_us_.store(esp_timer_get_time(), std::memory_order_release);
 
         /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
         if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
-            if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
-                ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
-                EnableAudioTesting(false);
-                continue;
-            }
-            std::vector<int16_t> data;
             int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
-            if (ReadAudioData(data, 16000, samples)) {
+            while (capture_ring_->Read(testing_cursor_, data, samples)) {
+                if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
+                    ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
+                    EnableAudioTesting(false);
+                    break;
+                }
                 // If input channels is 2, we need to fetch the left channel data
                 if (codec_->input_channels() == 2) {
                     auto mono_data = std::vector<int16_t>(data.size() / 2);
@@ -240,36 +263,31 @@ void AudioService::AudioInputTask() {
                     data = std::move(mono_data);
                 }
                 PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data));
-                continue;
             }
         }
 
         /* Feed the wake word */
         if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
-            std::vector<int16_t> data;
             int samples = wake_word_->GetFeedSize();
-            if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    wake_word_->Feed(data);
-                    continue;
-                }
+            while (samples > 0 && capture_ring_->Read(wake_word_cursor_, data, samples)) {
+                wake_word_->Feed(data);
             }
         }
 
         /* Feed the audio processor */
         if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
-            std::vector<int16_t> data;
             int samples = audio_processor_->GetFeedSize();
-            if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    audio_processor_->Feed(std::move(data));
-                    continue;
+            while (samples > 0) {
+                uint32_t position = processor_cursor_.position.load(std::memory_order_acquire);
+                if (!capture_ring_->Read(processor_cursor_, data, samples)) {
+                    break;
                 }
+                if (playback_reference_) {
+                    AddPlaybackReference(data, position);
+                }
+                audio_processor_->Feed(std::move(data));
             }
         }
-
-        ESP_LOGE(TAG, "Should not be here, bits: %lx", bits);
-        break;
     }
 
     ESP_LOGW(TAG, "Audio input task stopped");
@@ -278,32 +296,62 @@ void AudioService::AudioInputTask() {
 void AudioService::AudioOutputTask() {
     while (true) {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
+        audio_queue_cv_.wait(lock, [this]() { return !mixer_.empty() || output_flush_pending_ || service_stopped_; });
         if (service_stopped_) {
             break;
         }
 
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
+        if (output_flush_pending_) {
+            output_flush_pending_ = false;
+            lock.unlock();
+            bool flushed = FlushOutput();
+            lock.lock();
+            /* The cut is immediate, the fade would only play behind the silent ring */
+            if (flushed) {
+                mixer_.Clear(kAudioStreamVoice);
+            }
+            if (mixer_.empty()) {
+                continue;
+            }
+        }
+
+        uint32_t timestamp = 0;
+        mixer_.Mix(output_buffer_, timestamp, output_chunk_samples_);
+
+        /* Start latency: from the first packet pushed to an idle stream to its first mixed chunk */
+        int64_t start_latency_us[kAudioStreamCount] = {};
+        size_t voice_backlog_samples = mixer_.buffered_samples(kAudioStreamVoice) +
+            output_streams_[kAudioStreamVoice].decode_queue.size() * output_frame_samples_;
+        for (int i = 0; i < kAudioStreamCount; i++) {
+            auto& stream = output_streams_[i];
+            if (stream.start_request_us != 0 && (mixer_.mixed_streams() & (1 << i))) {
+                start_latency_us[i] = esp_timer_get_time() - stream.start_request_us;
+                stream.start_request_us = 0;
+            }
+        }
         audio_queue_cv_.notify_all();
         lock.unlock();
 
-        if (!codec_->output_enabled()) {
-            esp_timer_stop(audio_power_timer_);
-            esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
-            codec_->EnableOutput(true);
+        for (int i = 0; i < kAudioStreamCount; i++) {
+            if (start_latency_us[i] > 0) {
+                ESP_LOGI(TAG, "Output stream %d mixed %lld ms after its first packet, voice backlog %u ms", i,
+                    start_latency_us[i] / 1000, (unsigned)(voice_backlog_samples * 1000 / codec_->output_sample_rate()));
+            }
+        }
+
+        WakeOutput();
+        codec_->OutputData(output_buffer_);
+        if (playback_reference_) {
+            WritePlaybackReference(output_buffer_);
         }
-        codec_->OutputData(task->pcm);
 
-        /* Update the last output time */
-        last_output_time_ = std::chrono::steady_clock::now();
         debug_statistics_.playback_count++;
 
 #if CONFIG_USE_SERVER_AEC
         /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
+        if (timestamp > 0) {
             lock.lock();
-            timestamp_queue_.push_back(task->timestamp);
+            timestamp_queue_.push_back(timestamp);
         }
 #endif
     }
@@ -311,46 +359,93 @@ void AudioService::AudioOutputTask() {
     ESP_LOGW(TAG, "Audio output task stopped");
 }
 
+void AudioService::WritePlaybackReference(std::vector<int16_t>& pcm) {
+    const int16_t* data = pcm.data();
+    size_t samples = pcm.size();
+    if (codec_->output_sample_rate() != 16000) {
+        playback_reference_buffer_.resize(playback_reference_resampler_.GetOutputSamples(samples));
+        samples = playback_reference_resampler_.Process(data, samples, playback_reference_buffer_.data());
+        data = playback_reference_buffer_.data();
+    }
+
+    /*
+     * OutputData() returns once the chunk is in the TX DMA ring. The ring keeps cycling while idle
+     * (with silence), so the chunk ends up behind a full ring of AUDIO_CODEC_DMA_DESC_NUM x
+     * AUDIO_CODEC_DMA_FRAME_NUM frames, 60-90 ms depending on the output rate. Line the start of
+     * the chunk up with the capture position at which it reaches the DAC, plus the codec delay.
+     */
+    int64_t elapsed_us = esp_timer_get_time() - capture_time_us_.load(std::memory_order_acquire);
+    uint32_t dma_samples = (uint32_t)((int64_t)AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM * 16000 /
+        codec_->output_sample_rate());
+    uint32_t position = capture_ring_->write_position() + (uint32_t)(elapsed_us * 16 / 1000) +
+        dma_samples - (uint32_t)samples + CONFIG_SOFTWARE_AEC_DELAY_MS * 16;
+    playback_reference_->Write(data, samples, position);
+}
+
+/* Append the played audio for the same capture positions as the last channel, like a hardware reference */
+void AudioService::AddPlaybackReference(std::vector<int16_t>& data, uint32_t position) {
+    int channels = capture_ring_->channels();
+    size_t samples = data.size() / channels;
+    processor_reference_buffer_.resize(samples);
+    playback_reference_->Read(position, processor_reference_buffer_.data(), samples);
+
+    data.resize(samples * (channels + 1));
+    for (size_t i = samples; i-- > 0;) {
+        for (int c = channels - 1; c >= 0; c--) {
+            data[i * (channels + 1) + c] = data[i * channels + c];
+        }
+        data[i * (channels + 1) + channels] = processor_reference_buffer_[i];
+    }
+}
+
 void AudioService::OpusCodecTask() {
     while (true) {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
         audio_queue_cv_.wait(lock, [this]() {
             return service_stopped_ ||
                 (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
+                NextStreamToDecode() >= 0;
         });
         if (service_stopped_) {
             break;
         }
 
-        /* Decode the audio from decode queue */
-        if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
-            auto packet = std::move(audio_decode_queue_.front());
-            audio_decode_queue_.pop_front();
+        /* Decode the audio from the highest priority stream that has room in the mixer */
+        int stream_index = NextStreamToDecode();
+        if (stream_index >= 0) {
+            auto& stream = output_streams_[stream_index];
+            auto packet = std::move(stream.decode_queue.front());
+            stream.decode_queue.pop_front();
+            uint32_t generation = stream.generation;
+            bool reset = stream.reset_pending;
+            stream.reset_pending = false;
+            stream.decoding = true;
             audio_queue_cv_.notify_all();
             lock.unlock();
 
-            auto task = std::make_unique<AudioTask>();
-            task->type = kAudioTaskTypeDecodeToPlaybackQueue;
-            task->timestamp = packet->timestamp;
-
-            SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
+            std::vector<int16_t> pcm;
+            SetDecodeSampleRate(stream, packet->sample_rate, packet->frame_duration);
+            if (reset) {
+                stream.decoder->ResetState();
+            }
+            if (stream.decoder->Decode(std::move(packet->payload), pcm)) {
                 // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
+                if (stream.decoder->sample_rate() != codec_->output_sample_rate()) {
+                    std::vector<int16_t> resampled(stream.resampler.GetOutputSamples(pcm.size()));
+                    resampled.resize(stream.resampler.Process(pcm.data(), pcm.size(), resampled.data()));
+                    pcm = std::move(resampled);
                 }
 
                 lock.lock();
-                audio_playback_queue_.push_back(std::move(task));
-                audio_queue_cv_.notify_all();
+                if (generation == stream.generation) {
+                    mixer_.Push((AudioStreamType)stream_index, std::move(pcm), packet->timestamp);
+                    audio_queue_cv_.notify_all();
+                }
             } else {
                 ESP_LOGE(TAG, "Failed to decode audio");
                 lock.lock();
             }
+            stream.decoding = false;
             debug_statistics_.decode_count++;
         }
         
@@ -365,7 +460,12 @@ void AudioService::OpusCodecTask() {
             packet->frame_duration = OPUS_FRAME_DURATION_MS;
             packet->sample_rate = 16000;
             packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
+            bool encoded = opus_encoder_->Encode(std::move(task->pcm), packet->payload);
+            // 编码器不会取走 pcm 的缓冲区，无论成功与否都还给处理器复用
+            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+                audio_processor_->RecycleOutput(std::move(task->pcm));
+            }
+            if (!encoded) {
                 ESP_LOGE(TAG, "Failed to encode audio");
                 continue;
             }
@@ -390,18 +490,40 @@ void AudioService::OpusCodecTask() {
     ESP_LOGW(TAG, "Opus codec task stopped");
 }
 
-void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
-    if (opus_decoder_->sample_rate() == sample_rate && opus_decoder_->duration_ms() == frame_duration) {
+int AudioService::NextStreamToDecode() {
+    for (int i = kAudioStreamCount - 1; i >= 0; i--) {
+        if (!output_streams_[i].decode_queue.empty() &&
+            mixer_.buffered_samples((AudioStreamType)i) < MAX_PLAYBACK_TASKS_IN_QUEUE * output_frame_samples_) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void AudioService::SetDecodeSampleRate(AudioOutputStream& stream, int sample_rate, int frame_duration) {
+    if (stream.decoder && stream.decoder->sample_rate() == sample_rate && stream.decoder->duration_ms() == frame_duration) {
         return;
     }
 
-    opus_decoder_.reset();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
+    stream.decoder.reset();
+    stream.decoder = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
 
     auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
-        output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
+    if (stream.decoder->sample_rate() != codec->output_sample_rate()) {
+        ESP_LOGI(TAG, "Resampling audio from %d to %d", stream.decoder->sample_rate(), codec->output_sample_rate());
+        stream.resampler.Configure(stream.decoder->sample_rate(), codec->output_sample_rate());
+    }
+}
+
+/* The sound and alert decoders are only needed for the odd prompt, give their memory back when idle */
+void AudioService::ReleaseIdleDecoders() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    for (int i = kAudioStreamSound; i < kAudioStreamCount; i++) {
+        auto& stream = output_streams_[i];
+        if (stream.decoder && !stream.decoding && stream.decode_queue.empty()) {
+            ESP_LOGI(TAG, "Releasing idle decoder of output stream %d", i);
+            stream.decoder.reset();
+        }
     }
 }
 
@@ -429,15 +551,29 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
 }
 
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
+    return PushPacketToStream(kAudioStreamVoice, std::move(packet), wait);
+}
+
+bool AudioService::PushPacketToStream(AudioStreamType stream, std::unique_ptr<AudioStreamPacket> packet, bool wait) {
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
+    if (stream == kAudioStreamVoice && !voice_accepted_) {
+        dropped_voice_packets_++;
+        return true;
+    }
+    auto& output_stream = output_streams_[stream];
+    auto& queue = output_stream.decode_queue;
+    if (queue.empty() && !output_stream.decoding && mixer_.buffered_samples(stream) == 0 &&
+        output_stream.start_request_us == 0) {
+        output_stream.start_request_us = esp_timer_get_time();
+    }
+    if (queue.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
         if (wait) {
-            audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
+            audio_queue_cv_.wait(lock, [&queue]() { return queue.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
         } else {
             return false;
         }
     }
-    audio_decode_queue_.push_back(std::move(packet));
+    queue.push_back(std::move(packet));
     audio_queue_cv_.notify_all();
     return true;
 }
@@ -486,6 +622,7 @@ void AudioService::EnableWakeWordDetection(bool enable) {
             wake_word_initialized_ = true;
         }
         wake_word_->Start();
+        capture_ring_->Attach(wake_word_cursor_);
         xEventGroupSetBits(event_group_, AS_EVENT_WAKE_WORD_RUNNING);
     } else {
         wake_word_->Stop();
@@ -505,6 +642,7 @@ void AudioService::EnableVoiceProcessing(bool enable) {
         ResetDecoder();
         audio_input_need_warmup_ = true;
         audio_processor_->Start();
+        capture_ring_->Attach(processor_cursor_);
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
         audio_processor_->Stop();
@@ -515,12 +653,13 @@ void AudioService::EnableVoiceProcessing(bool enable) {
 void AudioService::EnableAudioTesting(bool enable) {
     ESP_LOGI(TAG, "%s audio testing", enable ? "Enabling" : "Disabling");
     if (enable) {
+        capture_ring_->Attach(testing_cursor_);
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
     } else {
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
-        /* Copy audio_testing_queue_ to audio_decode_queue_ */
+        /* Play back the recording on the voice stream */
         std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        audio_decode_queue_ = std::move(audio_testing_queue_);
+        output_streams_[kAudioStreamVoice].decode_queue = std::move(audio_testing_queue_);
         audio_queue_cv_.notify_all();
     }
 }
@@ -539,12 +678,8 @@ void AudioService::SetCallbacks(AudioServiceCallbacks& callbacks) {
     callbacks_ = callbacks;
 }
 
-void AudioService::PlaySound(const std::string_view& ogg) {
-    if (!codec_->output_enabled()) {
-        esp_timer_stop(audio_power_timer_);
-        esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
-        codec_->EnableOutput(true);
-    }
+void AudioService::PlaySound(const std::string_view& ogg, AudioStreamType stream) {
+    WakeOutput();
 
     const uint8_t* buf = reinterpret_cast<const uint8_t*>(ogg.data());
     size_t size = ogg.size();
@@ -631,7 +766,7 @@ void AudioService::PlaySound(const std::string_view& ogg) {
             packet->frame_duration = 60;
             packet->payload.resize(pkt_len);
             std::memcpy(packet->payload.data(), pkt_ptr, pkt_len);
-            PushPacketToDecodeQueue(std::move(packet), true);
+            PushPacketToStream(stream, std::move(packet), true);
         }
 
         offset = body_off + body_size;
@@ -640,30 +775,169 @@ void AudioService::PlaySound(const std::string_view& ogg) {
 
 bool AudioService::IsIdle() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    for (auto& stream : output_streams_) {
+        if (!stream.decode_queue.empty()) {
+            return false;
+        }
+    }
+    return audio_encode_queue_.empty() && mixer_.empty() && audio_testing_queue_.empty();
 }
 
 void AudioService::ResetDecoder() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    opus_decoder_->ResetState();
+    /* Only the voice stream is reset, prompts and alerts keep playing */
+    auto& voice = output_streams_[kAudioStreamVoice];
+    voice.generation++;
+    voice.reset_pending = true;
     timestamp_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
+    voice.decode_queue.clear();
+    mixer_.Clear(kAudioStreamVoice);
     audio_testing_queue_.clear();
     audio_queue_cv_.notify_all();
 }
 
+void AudioService::AbortPlayback() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    auto& voice = output_streams_[kAudioStreamVoice];
+    size_t queued = voice.decode_queue.size();
+    voice.generation++;
+    voice.reset_pending = true;
+    voice.decode_queue.clear();
+    timestamp_queue_.clear();
+    voice_accepted_ = false;
+    output_flush_pending_ = true;
+    mixer_.FadeOut(kAudioStreamVoice, codec_->output_sample_rate() * AUDIO_ABORT_FADE_MS / 1000);
+    audio_queue_cv_.notify_all();
+    ESP_LOGI(TAG, "Playback aborted, %u packets flushed", (unsigned)queued);
+}
+
+void AudioService::ResumePlayback() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    if (!voice_accepted_) {
+        ESP_LOGI(TAG, "Playback resumed, %lu late packets dropped", dropped_voice_packets_);
+        voice_accepted_ = true;
+        dropped_voice_packets_ = 0;
+    }
+}
+
 void AudioService::CheckAndUpdateAudioPowerState() {
+    std::unique_lock<std::mutex> lock(power_mutex_);
     auto now = std::chrono::steady_clock::now();
     auto input_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_input_time_).count();
     auto output_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_output_time_).count();
-    if (input_elapsed > AUDIO_POWER_TIMEOUT_MS && codec_->input_enabled()) {
+    if (output_elapsed > AUDIO_STANDBY_TIMEOUT_MS && codec_->output_enabled() && !codec_->output_standby()) {
+        codec_->SetOutputStandby(true);
+    }
+    if (input_elapsed > power_off_timeout_ms_ && codec_->input_enabled()) {
         codec_->EnableInput(false);
+        power_off_time_ = now;
     }
-    if (output_elapsed > AUDIO_POWER_TIMEOUT_MS && codec_->output_enabled()) {
+    if (output_elapsed > power_off_timeout_ms_ && codec_->output_enabled()) {
         codec_->EnableOutput(false);
+        power_off_time_ = now;
     }
     if (!codec_->input_enabled() && !codec_->output_enabled()) {
         esp_timer_stop(audio_power_timer_);
     }
-}
\ No newline at end of file
+    lock.unlock();
+
+    if (output_elapsed > AUDIO_STANDBY_TIMEOUT_MS) {
+        ReleaseIdleDecoders();
+    }
+}
+
+/* Called with power_mutex_ held */
+void AudioService::OnPowerUp() {
+    esp_timer_stop(audio_power_timer_);
+    esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
+    if (power_off_time_ == std::chrono::steady_clock::time_point()) {
+        return;
+    }
+
+    /* Powered off too early, keep the codec on longer next time; a full idle period falls back towards the default */
+    auto off_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - power_off_time_).count();
+    if (off_ms < power_off_timeout_ms_ && power_off_timeout_ms_ < AUDIO_POWER_TIMEOUT_MAX_MS) {
+        power_off_timeout_ms_ = std::min(power_off_timeout_ms_ * 2, AUDIO_POWER_TIMEOUT_MAX_MS);
+        ESP_LOGI(TAG, "Audio was off for %lld ms, power off timeout raised to %d ms", off_ms, power_off_timeout_ms_);
+    } else if (off_ms >= power_off_timeout_ms_ && power_off_timeout_ms_ > AUDIO_POWER_TIMEOUT_MS) {
+        power_off_timeout_ms_ = std::max(power_off_timeout_ms_ / 2, AUDIO_POWER_TIMEOUT_MS);
+        ESP_LOGI(TAG, "Audio was off for %lld ms, power off timeout lowered to %d ms", off_ms, power_off_timeout_ms_);
+    }
+    power_off_time_ = std::chrono::steady_clock::time_point();
+}
+
+void AudioService::WakeInput() {
+    std::lock_guard<std::mutex> lock(power_mutex_);
+    last_input_time_ = std::chrono::steady_clock::now();
+    if (codec_->input_enabled()) {
+        return;
+    }
+    OnPowerUp();
+    input_warmup_energy_ = 0;
+    input_enable_time_us_ = esp_timer_get_time();
+    input_warmup_measuring_ = true;
+    codec_->EnableInput(true);
+}
+
+/* Marks output activity before leaving standby, so the power timer can't put the PA back to sleep under a chunk */
+void AudioService::WakeOutput() {
+    std::lock_guard<std::mutex> lock(power_mutex_);
+    last_output_time_ = std::chrono::steady_clock::now();
+    if (!codec_->output_enabled()) {
+        OnPowerUp();
+        codec_->EnableOutput(true);
+    } else if (codec_->output_standby()) {
+        codec_->SetOutputStandby(false);
+    }
+}
+
+/* Runs on the audio output task, between two chunks */
+bool AudioService::FlushOutput() {
+    std::lock_guard<std::mutex> lock(power_mutex_);
+    if (!codec_->output_enabled() || !codec_->FlushOutput()) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Output DMA ring flushed");
+    return true;
+}
+
+void AudioService::Prewarm() {
+    xEventGroupSetBits(event_group_, AS_EVENT_PREWARM);
+}
+
+/* Runs on the audio input task: input on, output powered but left in standby until the first chunk */
+void AudioService::PrewarmCodec() {
+    WakeInput();
+    std::lock_guard<std::mutex> lock(power_mutex_);
+    if (!codec_->output_enabled()) {
+        last_output_time_ = std::chrono::steady_clock::now();
+        OnPowerUp();
+        codec_->EnableOutput(true);
+        codec_->SetOutputStandby(true);
+    }
+}
+
+/* The input has settled once two consecutive chunks carry signal of similar energy (within 3 dB) */
+void AudioService::MeasureInputWarmup(const std::vector<int16_t>& data) {
+    int channels = codec_->input_channels();
+    size_t frames = data.size() / channels;
+    int64_t energy = 0;
+    for (size_t i = 0; i < frames; i++) {
+        int32_t sample = data[i * channels];
+        energy += sample * sample;
+    }
+    energy /= std::max<size_t>(frames, 1);
+
+    int elapsed_ms = (esp_timer_get_time() - input_enable_time_us_.load()) / 1000;
+    int64_t last = input_warmup_energy_;
+    input_warmup_energy_ = energy;
+    bool settled = energy > 0 && last > 0 && energy < last * 2 && last < energy * 2;
+    if (settled) {
+        input_warmup_ms_ = std::min((input_warmup_ms_ + elapsed_ms) / 2, AUDIO_INPUT_WARMUP_MAX_MS);
+        ESP_LOGI(TAG, "Input settled %d ms after power up, warm-up estimate %d ms", elapsed_ms, input_warmup_ms_);
+        input_warmup_measuring_ = false;
+    } else if (elapsed_ms >= AUDIO_INPUT_WARMUP_MAX_MS) {
+        ESP_LOGW(TAG, "Input did not settle within %d ms", elapsed_ms);
+        input_warmup_measuring_ = false;
+    }
+}
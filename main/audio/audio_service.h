@@ -2,10 +2,12 @@
 #define AUDIO_SERVICE_H
 
 #include <memory>
+#include <array>
 #include <deque>
 #include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -14,9 +16,12 @@
 
 #include <opus_encoder.h>
 #include <opus_decoder.h>
-#include <opus_resampler.h>
 
 #include "audio_codec.h"
+#include "audio_capture_ring.h"
+#include "playback_reference.h"
+#include "audio_mixer.h"
+#include "polyphase_resampler.h"
 #include "audio_processor.h"
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
@@ -26,9 +31,15 @@
 /*
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
- * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ * 2. (Server / Prompts) -> {Decode Queue} -> [Opus Decoder] -> [Mixer] -> (Speaker)
  *
  * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
+ *
+ * The MIC is read once into a capture ring; wake word, processors and testing each consume it
+ * through their own cursor and chunk size.
+ *
+ * TTS, UI sounds and alerts are separate output streams, each with its own decode queue and
+ * decoder. The mixer ducks lower priority streams while a higher one plays.
  * 
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
  * 
@@ -36,20 +47,42 @@
 
 #define OPUS_FRAME_DURATION_MS 60
 #define MAX_ENCODE_TASKS_IN_QUEUE 2
+// Decoded frames buffered in the mixer per stream
 #define MAX_PLAYBACK_TASKS_IN_QUEUE 2
 #define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
 
+#define AUDIO_CAPTURE_CHUNK_MS 32
+// Output is mixed in short chunks so an abort reaches the speaker quickly
+#define AUDIO_OUTPUT_CHUNK_MS 20
+#define AUDIO_ABORT_FADE_MS 10
+#if CONFIG_SPIRAM
+#define AUDIO_CAPTURE_RING_MS 1000
+#else
+#define AUDIO_CAPTURE_RING_MS 250
+#endif
+
+/*
+ * Codec power tiers: active -> warm standby (output muted, clocks on) -> off.
+ * The off timeout doubles, up to the max, whenever audio is needed again soon after powering off,
+ * and halves back towards the default when the codec stayed off for a full timeout.
+ */
+#define AUDIO_STANDBY_TIMEOUT_MS 3000
 #define AUDIO_POWER_TIMEOUT_MS 15000
+#define AUDIO_POWER_TIMEOUT_MAX_MS 120000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
+// Input warm-up after a cold enable, measured per codec; this is the estimate before the first measurement
+#define AUDIO_INPUT_WARMUP_MS 120
+#define AUDIO_INPUT_WARMUP_MAX_MS 300
 
 
 #define AS_EVENT_AUDIO_TESTING_RUNNING      (1 << 0)
 #define AS_EVENT_WAKE_WORD_RUNNING          (1 << 1)
 #define AS_EVENT_AUDIO_PROCESSOR_RUNNING    (1 << 2)
 #define AS_EVENT_PLAYBACK_NOT_EMPTY         (1 << 3)
+#define AS_EVENT_PREWARM                    (1 << 4)
 
 struct AudioServiceCallbacks {
     std::function<void(void)> on_send_queue_available;
@@ -62,7 +95,6 @@ struct AudioServiceCallbacks {
 enum AudioTaskType {
     kAudioTaskTypeEncodeToSendQueue,
     kAudioTaskTypeEncodeToTestingQueue,
-    kAudioTaskTypeDecodeToPlaybackQueue,
 };
 
 struct AudioTask {
@@ -103,9 +135,16 @@ public:
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
-    void PlaySound(const std::string_view& sound);
+    void PlaySound(const std::string_view& sound, AudioStreamType stream = kAudioStreamSound);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
+    // Bring the codec up ahead of use, e.g. while connecting, so the first samples aren't clipped.
+    // Only posts a request, the audio input task does the codec work.
+    void Prewarm();
+    // Fade out and flush the voice stream now, safe to call from any task
+    void AbortPlayback();
+    // Accept voice packets again, called when a new TTS response starts
+    void ResumePlayback();
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -114,11 +153,20 @@ private:
     std::unique_ptr<WakeWord> wake_word_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
-    std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
-    OpusResampler input_resampler_;
-    OpusResampler reference_resampler_;
-    OpusResampler output_resampler_;
+    PolyphaseResampler input_resampler_;
+    PolyphaseResampler reference_resampler_;
+    PolyphaseResampler playback_reference_resampler_;
     DebugStatistics debug_statistics_;
+    std::unique_ptr<AudioCaptureRing> capture_ring_;
+    AudioCaptureRing::Cursor wake_word_cursor_{"wake_word"};
+    AudioCaptureRing::Cursor processor_cursor_{"processor"};
+    AudioCaptureRing::Cursor testing_cursor_{"testing"};
+    // Echo reference for the software AEC on codecs without a loopback channel
+    std::unique_ptr<PlaybackReference> playback_reference_;
+    std::vector<int16_t> input_buffer_;
+    std::vector<int16_t> playback_reference_buffer_;
+    std::vector<int16_t> processor_reference_buffer_;
+    std::atomic<int64_t> capture_time_us_{0};
 
     EventGroupHandle_t event_group_;
 
@@ -128,11 +176,33 @@ private:
     TaskHandle_t opus_codec_task_handle_ = nullptr;
     std::mutex audio_queue_mutex_;
     std::condition_variable audio_queue_cv_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
+
+    // Audio output streams, mixed by the output task
+    struct AudioOutputStream {
+        std::deque<std::unique_ptr<AudioStreamPacket>> decode_queue;
+        std::unique_ptr<OpusDecoderWrapper> decoder;
+        PolyphaseResampler resampler;
+        // Bumped on flush, a packet decoded across it is dropped
+        uint32_t generation = 0;
+        bool reset_pending = false;
+        // The codec task is using the decoder outside the lock
+        bool decoding = false;
+        // First packet pushed to the idle stream, cleared once its audio is mixed
+        int64_t start_request_us = 0;
+    };
+    std::array<AudioOutputStream, kAudioStreamCount> output_streams_;
+    AudioMixer mixer_;
+    std::vector<int16_t> output_buffer_;
+    size_t output_frame_samples_ = 0;
+    size_t output_chunk_samples_ = 0;
+    // Closed by AbortPlayback() until the next response, late packets of the aborted one are dropped
+    bool voice_accepted_ = true;
+    uint32_t dropped_voice_packets_ = 0;
+    // Set by AbortPlayback(), the output task drops what the TX DMA ring still holds
+    bool output_flush_pending_ = false;
     // For server AEC
     std::deque<uint32_t> timestamp_queue_;
 
@@ -143,15 +213,34 @@ private:
     bool audio_input_need_warmup_ = false;
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
+    // Serializes codec power changes between the audio tasks and the power timer
+    std::mutex power_mutex_;
     std::chrono::steady_clock::time_point last_input_time_;
     std::chrono::steady_clock::time_point last_output_time_;
+    std::chrono::steady_clock::time_point power_off_time_;
+    int power_off_timeout_ms_ = AUDIO_POWER_TIMEOUT_MS;
+    std::atomic<int64_t> input_enable_time_us_{0};
+    std::atomic<bool> input_warmup_measuring_{false};
+    int64_t input_warmup_energy_ = 0;
+    int input_warmup_ms_ = AUDIO_INPUT_WARMUP_MS;
 
     void AudioInputTask();
     void AudioOutputTask();
     void OpusCodecTask();
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
-    void SetDecodeSampleRate(int sample_rate, int frame_duration);
+    void WritePlaybackReference(std::vector<int16_t>& pcm);
+    void AddPlaybackReference(std::vector<int16_t>& data, uint32_t position);
+    bool PushPacketToStream(AudioStreamType stream, std::unique_ptr<AudioStreamPacket> packet, bool wait);
+    int NextStreamToDecode();
+    void SetDecodeSampleRate(AudioOutputStream& stream, int sample_rate, int frame_duration);
+    void ReleaseIdleDecoders();
     void CheckAndUpdateAudioPowerState();
+    void WakeInput();
+    void WakeOutput();
+    bool FlushOutput();
+    void OnPowerUp();
+    void PrewarmCodec();
+    void MeasureInputWarmup(const std::vector<int16_t>& data);
 };
 
 #endif
\ No newline at end of file
@@ -88,7 +88,8 @@ void Es8311AudioCodec::UpdateDeviceState() {
         dev_ = nullptr;
     }
     if (pa_pin_ != GPIO_NUM_NC) {
-        int level = output_enabled_ ? 1 : 0;
+        // The PA draws the most current, it is off in standby while the codec keeps running
+        int level = (output_enabled_ && !output_standby_) ? 1 : 0;
         gpio_set_level(pa_pin_, pa_inverted_ ? !level : level);
     }
 }
@@ -172,6 +173,15 @@ void Es8311AudioCodec::EnableOutput(bool enable) {
     UpdateDeviceState();
 }
 
+void Es8311AudioCodec::SetOutputStandby(bool standby) {
+    std::lock_guard<std::mutex> lock(data_if_mutex_);
+    if (standby == output_standby_) {
+        return;
+    }
+    AudioCodec::SetOutputStandby(standby);
+    UpdateDeviceState();
+}
+
 int Es8311AudioCodec::Read(int16_t* dest, int samples) {
     if (input_enabled_) {
         ESP_ERROR_CHECK_WITHOUT_ABORT(esp_codec_dev_read(dev_, (void*)dest, samples * sizeof(int16_t)));
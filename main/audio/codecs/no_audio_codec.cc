@@ -1,11 +1,16 @@
 #include "no_audio_codec.h"
+#include "sample_format.h"
 
 #include <esp_log.h>
-#include <cmath>
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 
 #define TAG "NoAudioCodec"
 
+// 音量变化在 10ms 内平滑过渡，避免爆音
+#define OUTPUT_GAIN_RAMP_MS 10
+
 NoAudioCodec::~NoAudioCodec() {
     if (rx_handle_ != nullptr) {
         ESP_ERROR_CHECK(i2s_channel_disable(rx_handle_));
@@ -278,43 +283,63 @@ NoAudioCodecSimplexPdm::NoAudioCodecSimplexPdm(int input_sample_rate, int output
     ESP_LOGI(TAG, "Simplex channels created");
 }
 
-int NoAudioCodec::Write(const int16_t* data, int samples) {
+void NoAudioCodec::SetOutputVolume(int volume) {
+    AudioCodec::SetOutputVolume(volume);
     std::lock_guard<std::mutex> lock(data_if_mutex_);
-    std::vector<int32_t> buffer(samples);
+    UpdateOutputGain();
+}
 
+void NoAudioCodec::UpdateOutputGain() {
     // output_volume_: 0-100
-    // volume_factor_: 0-65536
-    int32_t volume_factor = pow(double(output_volume_) / 100.0, 2) * 65536;
-    for (int i = 0; i < samples; i++) {
-        int64_t temp = int64_t(data[i]) * volume_factor; // 使用 int64_t 进行乘法运算
-        if (temp > INT32_MAX) {
-            buffer[i] = INT32_MAX;
-        } else if (temp < INT32_MIN) {
-            buffer[i] = INT32_MIN;
+    // target_gain_: 0-65536
+    gain_volume_ = output_volume_;
+    int volume = std::clamp(output_volume_, 0, 100);
+    target_gain_ = volume * volume * 65536 / 10000;
+
+    int ramp_samples = std::max(output_sample_rate_ * OUTPUT_GAIN_RAMP_MS / 1000, 1);
+    gain_step_ = std::max<int32_t>(std::abs(target_gain_ - current_gain_) / ramp_samples, 1);
+}
+
+int NoAudioCodec::Write(const int16_t* data, int samples) {
+    std::lock_guard<std::mutex> lock(data_if_mutex_);
+    if (write_buffer_.size() < (size_t)samples) {
+        write_buffer_.resize(samples);
+    }
+    // The volume loaded from settings in Start() doesn't go through SetOutputVolume()
+    if (gain_volume_ != output_volume_) {
+        UpdateOutputGain();
+    }
+
+    int32_t* buffer = write_buffer_.data();
+    int i = 0;
+    for (; i < samples && current_gain_ != target_gain_; i++) {
+        if (current_gain_ < target_gain_) {
+            current_gain_ = std::min(current_gain_ + gain_step_, target_gain_);
         } else {
-            buffer[i] = static_cast<int32_t>(temp);
+            current_gain_ = std::max(current_gain_ - gain_step_, target_gain_);
         }
+        buffer[i] = data[i] * current_gain_;
     }
+    ScaleToInt32(data + i, buffer + i, samples - i, current_gain_);
 
     size_t bytes_written;
-    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer.data(), samples * sizeof(int32_t), &bytes_written, portMAX_DELAY));
+    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer, samples * sizeof(int32_t), &bytes_written, portMAX_DELAY));
     return bytes_written / sizeof(int32_t);
 }
 
 int NoAudioCodec::Read(int16_t* dest, int samples) {
     size_t bytes_read;
 
-    std::vector<int32_t> bit32_buffer(samples);
-    if (i2s_channel_read(rx_handle_, bit32_buffer.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
+    if (read_buffer_.size() < (size_t)samples) {
+        read_buffer_.resize(samples);
+    }
+    if (i2s_channel_read(rx_handle_, read_buffer_.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
         ESP_LOGE(TAG, "Read Failed!");
         return 0;
     }
 
     samples = bytes_read / sizeof(int32_t);
-    for (int i = 0; i < samples; i++) {
-        int32_t value = bit32_buffer[i] >> 12;
-        dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
-    }
+    Int32ToInt16(read_buffer_.data(), dest, samples);
     return samples;
 }
 
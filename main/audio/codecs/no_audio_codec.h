@@ -6,8 +6,20 @@
 #include <driver/gpio.h>
 #include <driver/i2s_pdm.h>
 #include <mutex>
+#include <vector>
 
 class NoAudioCodec : public AudioCodec {
+private:
+    // Output gain in Q16, ramped towards the target to avoid clicks on volume changes
+    int gain_volume_ = -1;
+    int32_t target_gain_ = 0;
+    int32_t current_gain_ = 0;
+    int32_t gain_step_ = 0;
+    std::vector<int32_t> write_buffer_;
+    std::vector<int32_t> read_buffer_;
+
+    void UpdateOutputGain();
+
 protected:
     std::mutex data_if_mutex_;
 
@@ -16,6 +28,7 @@ protected:
 
 public:
     virtual ~NoAudioCodec();
+    virtual void SetOutputVolume(int volume) override;
 };
 
 class NoAudioCodecDuplex : public NoAudioCodec {
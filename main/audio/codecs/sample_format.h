@@ -0,0 +1,39 @@
+#ifndef _SAMPLE_FORMAT_H
+#define _SAMPLE_FORMAT_H
+
+#include <algorithm>
+#include <cstdint>
+
+/*
+ * Sample format kernels for 32-bit I2S slots. The gain is at most 1.0 (65536 in Q16), so a 16-bit
+ * sample times the gain always fits in 32 bits and the output needs no saturation. Loops are
+ * unrolled by four with no branches in the body.
+ */
+inline void ScaleToInt32(const int16_t* src, int32_t* dst, int samples, int32_t gain) {
+    int i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        dst[i] = src[i] * gain;
+        dst[i + 1] = src[i + 1] * gain;
+        dst[i + 2] = src[i + 2] * gain;
+        dst[i + 3] = src[i + 3] * gain;
+    }
+    for (; i < samples; i++) {
+        dst[i] = src[i] * gain;
+    }
+}
+
+// 32-bit microphone slots to 16 bits: >> 12, saturated to +/-32767
+inline void Int32ToInt16(const int32_t* src, int16_t* dst, int samples) {
+    int i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        dst[i] = std::clamp<int32_t>(src[i] >> 12, -INT16_MAX, INT16_MAX);
+        dst[i + 1] = std::clamp<int32_t>(src[i + 1] >> 12, -INT16_MAX, INT16_MAX);
+        dst[i + 2] = std::clamp<int32_t>(src[i + 2] >> 12, -INT16_MAX, INT16_MAX);
+        dst[i + 3] = std::clamp<int32_t>(src[i + 3] >> 12, -INT16_MAX, INT16_MAX);
+    }
+    for (; i < samples; i++) {
+        dst[i] = std::clamp<int32_t>(src[i] >> 12, -INT16_MAX, INT16_MAX);
+    }
+}
+
+#endif // _SAMPLE_FORMAT_H
@@ -0,0 +1,68 @@
+#include "playback_reference.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#define TAG "PlaybackReference"
+
+// 播放块之间的调度抖动小于这个值时仍然视为连续播放
+#define PLAYBACK_REFERENCE_JITTER_SAMPLES (40 * 16)
+
+PlaybackReference::PlaybackReference(size_t capacity_samples) : capacity_(1) {
+    while (capacity_ < capacity_samples) {
+        capacity_ <<= 1;
+    }
+    size_t size = capacity_ * sizeof(int16_t);
+#if CONFIG_SPIRAM
+    buffer_ = (int16_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+#endif
+    if (buffer_ == nullptr) {
+        buffer_ = (int16_t*)heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    assert(buffer_ != nullptr);
+    ESP_LOGI(TAG, "Playback reference: %u samples, %u bytes", (unsigned)capacity_, (unsigned)size);
+}
+
+PlaybackReference::~PlaybackReference() {
+    heap_caps_free(buffer_);
+}
+
+void PlaybackReference::Write(const int16_t* data, size_t samples, uint32_t position) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int32_t gap = position - end_position_;
+    if (end_position_ == start_position_) {
+        start_position_ = position;
+    } else if (gap > PLAYBACK_REFERENCE_JITTER_SAMPLES) {
+        // 新的播放段，两段之间是静音
+        size_t silence = std::min((size_t)gap, capacity_);
+        for (size_t i = 0; i < silence; i++) {
+            buffer_[(position - silence + i) & (capacity_ - 1)] = 0;
+        }
+    } else {
+        position = end_position_;
+    }
+
+    for (size_t i = 0; i < samples; i++) {
+        buffer_[(position + i) & (capacity_ - 1)] = data[i];
+    }
+    end_position_ = position + samples;
+    if (end_position_ - start_position_ > capacity_) {
+        start_position_ = end_position_ - capacity_;
+    }
+}
+
+void PlaybackReference::Read(uint32_t position, int16_t* data, size_t samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < samples; i++) {
+        uint32_t p = position + i;
+        if ((int32_t)(p - start_position_) >= 0 && (int32_t)(p - end_position_) < 0) {
+            data[i] = buffer_[p & (capacity_ - 1)];
+        } else {
+            data[i] = 0;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef PLAYBACK_REFERENCE_H
+#define PLAYBACK_REFERENCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/*
+ * Played audio at 16 kHz, indexed by capture ring position.
+ *
+ * The output task writes every chunk it hands to the codec together with the capture position
+ * the chunk lines up with. Continuous playback is appended back to back so the reference never
+ * jumps inside a burst; a new burst is anchored at its own position. The input task reads the
+ * reference for the same positions as the microphone samples, with silence where nothing was
+ * played. Used as the echo reference on codecs without a hardware loopback channel.
+ */
+class PlaybackReference {
+public:
+    PlaybackReference(size_t capacity_samples);
+    ~PlaybackReference();
+
+    void Write(const int16_t* data, size_t samples, uint32_t position);
+    void Read(uint32_t position, int16_t* data, size_t samples);
+
+private:
+    std::mutex mutex_;
+    int16_t* buffer_ = nullptr;
+    size_t capacity_;
+    uint32_t start_position_ = 0;
+    uint32_t end_position_ = 0;
+};
+
+#endif // PLAYBACK_REFERENCE_H
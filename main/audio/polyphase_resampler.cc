@@ -0,0 +1,165 @@
+#include "polyphase_resampler.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+
+#define TAG "PolyphaseResampler"
+
+#define RESAMPLER_CUTOFF 0.9
+#define RESAMPLER_KAISER_BETA 6.0
+
+static double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        double t = x / (2.0 * k);
+        term *= t * t;
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+/*
+ * Q15 coefficients times Q0 samples, unrolled by four with two accumulators. Every phase is
+ * normalized to a DC gain of 1.0 and its absolute sum stays well below 2.0, so int32 can't overflow.
+ */
+static inline int32_t DotProduct(const int16_t* x, const int16_t* h, int taps) {
+    int32_t acc0 = 0;
+    int32_t acc1 = 0;
+    int i = 0;
+    for (; i + 4 <= taps; i += 4) {
+        acc0 += x[i] * h[i];
+        acc1 += x[i + 1] * h[i + 1];
+        acc0 += x[i + 2] * h[i + 2];
+        acc1 += x[i + 3] * h[i + 3];
+    }
+    for (; i < taps; i++) {
+        acc0 += x[i] * h[i];
+    }
+    return acc0 + acc1;
+}
+
+/* Kaiser windowed sinc prototype, evaluated per tap so the full-length filter never has to be held */
+static double Prototype(int i, int length, double cutoff, double window_scale) {
+    double x = i - (length - 1) / 2.0;
+    double sinc = (x == 0) ? 2.0 * cutoff : std::sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+    double r = x / (length / 2.0);
+    double window = (std::fabs(r) <= 1.0) ? BesselI0(RESAMPLER_KAISER_BETA * std::sqrt(1.0 - r * r)) * window_scale : 0.0;
+    return sinc * window;
+}
+
+std::shared_ptr<const PolyphaseResampler::Filter> PolyphaseResampler::CreateFilter(int interpolation, int decimation) {
+    auto filter = std::make_shared<Filter>();
+    filter->interpolation = interpolation;
+    filter->decimation = decimation;
+
+    // The filter spans 2 * RESAMPLER_HALF_TAPS periods of the lower rate
+    int L = interpolation;
+    int factor = std::max(L, decimation);
+    int taps = (2 * CONFIG_RESAMPLER_HALF_TAPS * factor + L - 1) / L;
+    int length = taps * L;
+    double cutoff = 0.5 * RESAMPLER_CUTOFF / factor;
+    double window_scale = 1.0 / BesselI0(RESAMPLER_KAISER_BETA);
+    filter->taps = taps;
+
+    // One phase at a time, normalized to unity DC gain
+    filter->coefficients.resize(length);
+    std::vector<double> phase(taps);
+    for (int p = 0; p < L; p++) {
+        double sum = 0;
+        for (int k = 0; k < taps; k++) {
+            phase[k] = Prototype(k * L + p, length, cutoff, window_scale);
+            sum += phase[k];
+        }
+        for (int k = 0; k < taps; k++) {
+            double value = std::round(phase[k] / sum * 32768.0);
+            filter->coefficients[p * taps + (taps - 1 - k)] = (int16_t)std::clamp(value, -32768.0, 32767.0);
+        }
+    }
+    ESP_LOGI(TAG, "Created filter %d/%d: %d phases x %d taps, %u bytes", interpolation, decimation, L, taps,
+        (unsigned)(length * sizeof(int16_t)));
+    return filter;
+}
+
+/* Input and reference channels, and every decoded stream at the same rate, run the same ratio */
+std::shared_ptr<const PolyphaseResampler::Filter> PolyphaseResampler::GetFilter(int interpolation, int decimation) {
+    static std::mutex mutex;
+    static std::vector<std::weak_ptr<const Filter>> filters;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    filters.erase(std::remove_if(filters.begin(), filters.end(), [](const std::weak_ptr<const Filter>& filter) {
+        return filter.expired();
+    }), filters.end());
+    for (auto& weak : filters) {
+        auto filter = weak.lock();
+        if (filter && filter->interpolation == interpolation && filter->decimation == decimation) {
+            return filter;
+        }
+    }
+    auto filter = CreateFilter(interpolation, decimation);
+    filters.push_back(filter);
+    return filter;
+}
+
+void PolyphaseResampler::Configure(int input_sample_rate, int output_sample_rate) {
+    if (input_sample_rate == input_sample_rate_ && output_sample_rate == output_sample_rate_) {
+        Reset();
+        return;
+    }
+
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+    int g = std::gcd(input_sample_rate, output_sample_rate);
+    interpolation_ = output_sample_rate / g;
+    decimation_ = input_sample_rate / g;
+    filter_.reset();  // Let an unshared old table go before the new one is built
+    filter_ = GetFilter(interpolation_, decimation_);
+    taps_ = filter_->taps;
+
+    ESP_LOGI(TAG, "Resampling %d -> %d Hz: %d/%d, %d phases x %d taps", input_sample_rate, output_sample_rate,
+        interpolation_, decimation_, interpolation_, taps_);
+    Reset();
+}
+
+void PolyphaseResampler::Reset() {
+    buffer_.assign(taps_ > 0 ? taps_ - 1 : 0, 0);
+    next_input_ = 0;
+    phase_ = 0;
+}
+
+size_t PolyphaseResampler::GetOutputSamples(size_t samples) const {
+    return (uint64_t)samples * interpolation_ / decimation_ + 1;
+}
+
+size_t PolyphaseResampler::Process(const int16_t* input, size_t samples, int16_t* output, int stride) {
+    size_t history = taps_ - 1;
+    buffer_.resize(history + samples);
+    int16_t* x = buffer_.data();
+    for (size_t i = 0; i < samples; i++) {
+        x[history + i] = input[i * stride];
+    }
+
+    const int16_t* coefficients = filter_->coefficients.data();
+    size_t produced = 0;
+    while (next_input_ < samples) {
+        int32_t acc = DotProduct(x + next_input_, coefficients + phase_ * taps_, taps_);
+        output[produced * stride] = (int16_t)std::clamp<int32_t>((acc + (1 << 14)) >> 15, INT16_MIN, INT16_MAX);
+        produced++;
+
+        phase_ += decimation_;
+        next_input_ += phase_ / interpolation_;
+        phase_ %= interpolation_;
+    }
+    next_input_ -= samples;
+
+    std::copy(x + samples, x + samples + history, x);
+    buffer_.resize(history);
+    return produced;
+}
@@ -0,0 +1,56 @@
+#ifndef POLYPHASE_RESAMPLER_H
+#define POLYPHASE_RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * Streaming polyphase FIR resampler for any pair of integer rates.
+ *
+ * The ratio is reduced to L/M (48k->16k is 1/3, 44.1k->16k is 160/441) and a Kaiser windowed
+ * sinc low-pass at 0.9 of the lower Nyquist frequency is split into L phases of Q15 coefficients
+ * when the rates are configured. Each output sample is one int16 dot product over `taps()` input
+ * samples. The history between calls is kept, so a stream can be fed in chunks of any size.
+ * The coefficient table is immutable and shared by every resampler running the same ratio; it is
+ * freed when the last of them is reconfigured or destroyed.
+ */
+class PolyphaseResampler {
+public:
+    void Configure(int input_sample_rate, int output_sample_rate);
+
+    // Upper bound of the output samples for `samples` input samples
+    size_t GetOutputSamples(size_t samples) const;
+    // Resample `samples` samples read every `stride` values from `input` into `output` with the same
+    // stride, so one channel of an interleaved buffer can be resampled in place. Returns the samples written.
+    size_t Process(const int16_t* input, size_t samples, int16_t* output, int stride = 1);
+    void Reset();
+
+    int input_sample_rate() const { return input_sample_rate_; }
+    int output_sample_rate() const { return output_sample_rate_; }
+    int taps() const { return taps_; }
+    const int16_t* coefficients() const { return filter_ ? filter_->coefficients.data() : nullptr; }
+
+private:
+    struct Filter {
+        int interpolation;
+        int decimation;
+        int taps;
+        std::vector<int16_t> coefficients;  // L phases of taps, reversed for a forward dot product
+    };
+    static std::shared_ptr<const Filter> GetFilter(int interpolation, int decimation);
+    static std::shared_ptr<const Filter> CreateFilter(int interpolation, int decimation);
+
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    int interpolation_ = 1;     // L
+    int decimation_ = 1;        // M
+    int taps_ = 0;
+    std::shared_ptr<const Filter> filter_;
+    std::vector<int16_t> buffer_;        // taps_ - 1 samples of history followed by the current input
+    size_t next_input_ = 0;
+    int phase_ = 0;
+};
+
+#endif // POLYPHASE_RESAMPLER_H
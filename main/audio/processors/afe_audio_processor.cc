@@ -14,8 +14,7 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms) {
     codec_ = codec;
     frame_samples_ = frame_duration_ms * 16000 / 1000;
 
-    // Pre-allocate output buffer capacity
-    output_buffer_.reserve(frame_samples_);
+    reframer_.Initialize(frame_samples_);
 
     int ref_num = codec_->input_reference() ? 1 : 0;
 
@@ -92,6 +91,8 @@ void AfeAudioProcessor::Feed(std::vector<int16_t>&& data) {
 }
 
 void AfeAudioProcessor::Start() {
+    // 上次会话残留的半帧不能拼到新会话的开头
+    reframer_.Reset();
     xEventGroupSetBits(event_group_, PROCESSOR_RUNNING);
 }
 
@@ -110,6 +111,10 @@ void AfeAudioProcessor::OnOutput(std::function<void(std::vector<int16_t>&& data)
     output_callback_ = callback;
 }
 
+void AfeAudioProcessor::RecycleOutput(std::vector<int16_t>&& data) {
+    reframer_.Recycle(std::move(data));
+}
+
 void AfeAudioProcessor::OnVadStateChange(std::function<void(bool speaking)> callback) {
     vad_state_change_callback_ = callback;
 }
@@ -146,24 +151,7 @@ void AfeAudioProcessor::AudioProcessorTask() {
         }
 
         if (output_callback_) {
-            size_t samples = res->data_size / sizeof(int16_t);
-            
-            // Add data to buffer
-            output_buffer_.insert(output_buffer_.end(), res->data, res->data + samples);
-            
-            // Output complete frames when buffer has enough data
-            while (output_buffer_.size() >= frame_samples_) {
-                if (output_buffer_.size() == frame_samples_) {
-                    // If buffer size equals frame size, move the entire buffer
-                    output_callback_(std::move(output_buffer_));
-                    output_buffer_.clear();
-                    output_buffer_.reserve(frame_samples_);
-                } else {
-                    // If buffer size exceeds frame size, copy one frame and remove it
-                    output_callback_(std::vector<int16_t>(output_buffer_.begin(), output_buffer_.begin() + frame_samples_));
-                    output_buffer_.erase(output_buffer_.begin(), output_buffer_.begin() + frame_samples_);
-                }
-            }
+            reframer_.Push(res->data, res->data_size / sizeof(int16_t), 1, output_callback_);
         }
     }
 }
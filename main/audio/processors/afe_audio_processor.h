@@ -12,6 +12,7 @@
 
 #include "audio_processor.h"
 #include "audio_codec.h"
+#include "audio_reframer.h"
 
 class AfeAudioProcessor : public AudioProcessor {
 public:
@@ -24,6 +25,7 @@ public:
     void Stop() override;
     bool IsRunning() override;
     void OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) override;
+    void RecycleOutput(std::vector<int16_t>&& data) override;
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
     size_t GetFeedSize() override;
     void EnableDeviceAec(bool enable) override;
@@ -37,7 +39,7 @@ private:
     AudioCodec* codec_ = nullptr;
     int frame_samples_ = 0;
     bool is_speaking_ = false;
-    std::vector<int16_t> output_buffer_;
+    AudioReframer reframer_;
 
     void AudioProcessorTask();
 };
@@ -0,0 +1,80 @@
+#include "audio_reframer.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "AudioReframer"
+
+// 编码队列最多 2 帧，加上正在编码和正在填充的帧
+#define AUDIO_REFRAMER_MAX_POOLED_FRAMES 4
+
+void AudioReframer::Initialize(size_t frame_samples) {
+    frame_samples_ = frame_samples;
+    filled_ = 0;
+    frame_ = Acquire();
+
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    pool_.reserve(AUDIO_REFRAMER_MAX_POOLED_FRAMES);
+}
+
+std::vector<int16_t> AudioReframer::Acquire() {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (!pool_.empty()) {
+            auto frame = std::move(pool_.back());
+            pool_.pop_back();
+            frame.resize(frame_samples_);
+            return frame;
+        }
+    }
+
+    allocations_++;
+    ESP_LOGD(TAG, "Allocated frame buffer %u", (unsigned)allocations_);
+    return std::vector<int16_t>(frame_samples_);
+}
+
+void AudioReframer::Push(const int16_t* data, size_t frames, int channels,
+    const std::function<void(std::vector<int16_t>&& frame)>& output) {
+    // 在写入方的任务里复位，避免与 Push() 竞争
+    if (reset_pending_.exchange(false)) {
+        filled_ = 0;
+    }
+    while (frames > 0) {
+        size_t samples = std::min(frames, frame_samples_ - filled_);
+        int16_t* dest = frame_.data() + filled_;
+        if (channels == 1) {
+            memcpy(dest, data, samples * sizeof(int16_t));
+        } else if (channels == 2) {
+            // 常量步长，编译器可以向量化
+            for (size_t i = 0; i < samples; i++) {
+                dest[i] = data[i * 2];
+            }
+        } else {
+            for (size_t i = 0; i < samples; i++) {
+                dest[i] = data[i * channels];
+            }
+        }
+        data += samples * channels;
+        frames -= samples;
+        filled_ += samples;
+
+        if (filled_ == frame_samples_) {
+            filled_ = 0;
+            output(std::move(frame_));
+            frame_ = Acquire();
+        }
+    }
+}
+
+void AudioReframer::Recycle(std::vector<int16_t>&& frame) {
+    // 被移走的缓冲区容量为 0，直接丢弃
+    if (frame.capacity() < frame_samples_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (pool_.size() < AUDIO_REFRAMER_MAX_POOLED_FRAMES) {
+        pool_.push_back(std::move(frame));
+    }
+}
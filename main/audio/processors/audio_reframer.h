@@ -0,0 +1,42 @@
+#ifndef AUDIO_REFRAMER_H
+#define AUDIO_REFRAMER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*
+ * Cuts the processor output into fixed size frames for the Opus encoder.
+ *
+ * Input of any chunk size is copied straight into the frame being filled, so nothing is moved
+ * around when the chunk size does not divide the frame. Complete frames are handed out by move
+ * and come back through Recycle() once encoded, so the buffers are reused instead of allocated
+ * on every frame.
+ */
+class AudioReframer {
+public:
+    void Initialize(size_t frame_samples);
+    // Append `frames` samples taken from the first channel of `channels` interleaved channels
+    void Push(const int16_t* data, size_t frames, int channels,
+        const std::function<void(std::vector<int16_t>&& frame)>& output);
+    // Give back a frame handed out by Push() so its buffer can be reused
+    void Recycle(std::vector<int16_t>&& frame);
+    // Drop the partially filled frame before the next Push(), safe to call from any task
+    void Reset() { reset_pending_ = true; }
+
+private:
+    size_t frame_samples_ = 0;
+    std::vector<int16_t> frame_;
+    size_t filled_ = 0;
+    std::atomic<bool> reset_pending_{false};
+
+    std::mutex pool_mutex_;
+    std::vector<std::vector<int16_t>> pool_;
+    uint32_t allocations_ = 0;
+
+    std::vector<int16_t> Acquire();
+};
+
+#endif // AUDIO_REFRAMER_H
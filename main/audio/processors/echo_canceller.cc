@@ -0,0 +1,312 @@
+#include "echo_canceller.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+#define TAG "EchoCanceller"
+
+#define AEC_BLOCK 64
+#define AEC_FFT_SIZE 128
+#define AEC_FFT_BITS 7
+#define AEC_BINS (AEC_FFT_SIZE / 2 + 1)
+#define AEC_STEP_Q15 16384                              // NLMS step size 0.5
+#define AEC_WEIGHT_LIMIT (1 << 28)                      // |W| <= 16 in Q24
+#define AEC_MIN_REFERENCE_ENERGY (AEC_BLOCK * 16 * 16)  // Reference below about -66 dBFS does not adapt
+#define AEC_REGULARIZATION ((int64_t)AEC_FFT_SIZE * 32 * 32)
+
+static int16_t cos_table[AEC_FFT_SIZE / 2];
+static int16_t sin_table[AEC_FFT_SIZE / 2];
+static uint8_t bit_reverse[AEC_FFT_SIZE];
+static std::once_flag tables_once;
+
+static void InitTables() {
+    for (int i = 0; i < AEC_FFT_SIZE / 2; i++) {
+        double angle = 2 * M_PI * i / AEC_FFT_SIZE;
+        cos_table[i] = (int16_t)lround(cos(angle) * 32767);
+        sin_table[i] = (int16_t)lround(sin(angle) * 32767);
+    }
+    for (int i = 0; i < AEC_FFT_SIZE; i++) {
+        int reversed = 0;
+        for (int bit = 0; bit < AEC_FFT_BITS; bit++) {
+            if (i & (1 << bit)) {
+                reversed |= 1 << (AEC_FFT_BITS - 1 - bit);
+            }
+        }
+        bit_reverse[i] = reversed;
+    }
+}
+
+static inline int32_t Saturate(int64_t value, int32_t limit) {
+    return (int32_t)std::clamp<int64_t>(value, -limit, limit);
+}
+
+static inline int16_t Saturate16(int32_t value) {
+    return (int16_t)std::clamp<int32_t>(value, INT16_MIN, INT16_MAX);
+}
+
+// log2 in Q8, 256 is about 3 dB
+static int Log2Q8(uint64_t x) {
+    if (x == 0) {
+        return 0;
+    }
+    int msb = 63 - __builtin_clzll(x);
+    uint32_t frac = msb >= 8 ? (x >> (msb - 8)) & 0xff : (x << (8 - msb)) & 0xff;
+    return msb * 256 + frac;
+}
+
+template <typename T>
+static T* AllocateZeroed(size_t count) {
+    // 滤波器每个块都要完整遍历，优先放在内部 RAM
+    T* data = (T*)heap_caps_calloc(count, sizeof(T), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#if CONFIG_SPIRAM
+    if (data == nullptr) {
+        data = (T*)heap_caps_calloc(count, sizeof(T), MALLOC_CAP_SPIRAM);
+    }
+#endif
+    assert(data != nullptr);
+    return data;
+}
+
+// In-place radix-2 FFT. The forward transform is unscaled, the inverse one divides by the size.
+template <typename Complex>
+static void Fft(Complex* data, bool inverse) {
+    for (int i = 0; i < AEC_FFT_SIZE; i++) {
+        int j = bit_reverse[i];
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    for (int length = 2; length <= AEC_FFT_SIZE; length <<= 1) {
+        int half = length >> 1;
+        int step = AEC_FFT_SIZE / length;
+        for (int i = 0; i < AEC_FFT_SIZE; i += length) {
+            for (int k = 0; k < half; k++) {
+                int32_t wr = cos_table[k * step];
+                int32_t wi = inverse ? sin_table[k * step] : -sin_table[k * step];
+                Complex& u = data[i + k];
+                Complex& v = data[i + k + half];
+                int64_t tr = ((int64_t)v.re * wr - (int64_t)v.im * wi) >> 15;
+                int64_t ti = ((int64_t)v.re * wi + (int64_t)v.im * wr) >> 15;
+                if (inverse) {
+                    v.re = (int32_t)((u.re - tr) >> 1);
+                    v.im = (int32_t)((u.im - ti) >> 1);
+                    u.re = (int32_t)((u.re + tr) >> 1);
+                    u.im = (int32_t)((u.im + ti) >> 1);
+                } else {
+                    v.re = (int32_t)(u.re - tr);
+                    v.im = (int32_t)(u.im - ti);
+                    u.re = (int32_t)(u.re + tr);
+                    u.im = (int32_t)(u.im + ti);
+                }
+            }
+        }
+    }
+}
+
+EchoCanceller::EchoCanceller(int tail_ms) {
+    std::call_once(tables_once, InitTables);
+
+    partitions_ = std::max(1, (tail_ms * 16 + AEC_BLOCK - 1) / AEC_BLOCK);
+    history_ = AllocateZeroed<Complex>(partitions_ * AEC_BINS);
+    foreground_ = AllocateZeroed<Complex>(partitions_ * AEC_BINS);
+    background_ = AllocateZeroed<Complex>(partitions_ * AEC_BINS);
+    delayed_ = AllocateZeroed<const Complex*>(partitions_);
+    power_ = AllocateZeroed<int64_t>(AEC_BINS);
+    ESP_LOGI(TAG, "Echo canceller: %d partitions of %d samples, %u bytes", partitions_, AEC_BLOCK,
+        (unsigned)(partitions_ * AEC_BINS * sizeof(Complex) * 3));
+}
+
+EchoCanceller::~EchoCanceller() {
+    heap_caps_free(history_);
+    heap_caps_free(foreground_);
+    heap_caps_free(background_);
+    heap_caps_free(delayed_);
+    heap_caps_free(power_);
+}
+
+void EchoCanceller::Reset() {
+    size_t size = partitions_ * AEC_BINS * sizeof(Complex);
+    memset(history_, 0, size);
+    memset(foreground_, 0, size);
+    memset(background_, 0, size);
+    memset(power_, 0, AEC_BINS * sizeof(int64_t));
+    memset(last_reference_, 0, sizeof(last_reference_));
+    history_index_ = 0;
+    constraint_index_ = 0;
+    foreground_error_ = 0;
+    background_error_ = 0;
+    statistics_ = Statistics();
+}
+
+void EchoCanceller::Process(const int16_t* input, int channels, int reference_channel, size_t samples,
+    int16_t* output) {
+    int16_t mic[AEC_BLOCK];
+    int16_t reference[AEC_BLOCK];
+    for (size_t offset = 0; offset + AEC_BLOCK <= samples; offset += AEC_BLOCK) {
+        const int16_t* frame = input + offset * channels;
+        for (int i = 0; i < AEC_BLOCK; i++) {
+            mic[i] = frame[i * channels];
+            reference[i] = frame[i * channels + reference_channel];
+        }
+        ProcessBlock(mic, reference, output + offset);
+    }
+}
+
+void EchoCanceller::ProcessBlock(const int16_t* mic, const int16_t* reference, int16_t* output) {
+    // Overlap-save: the reference spectrum covers the previous and the current block
+    history_index_ = (history_index_ + 1) % partitions_;
+    for (int p = 0; p < partitions_; p++) {
+        delayed_[p] = history_ + ((history_index_ - p + partitions_) % partitions_) * AEC_BINS;
+    }
+    int64_t reference_energy = 0;
+    for (int i = 0; i < AEC_BLOCK; i++) {
+        fft_[i] = { last_reference_[i], 0 };
+        fft_[AEC_BLOCK + i] = { reference[i], 0 };
+        reference_energy += reference[i] * reference[i];
+    }
+    memcpy(last_reference_, reference, sizeof(last_reference_));
+    Fft(fft_, false);
+
+    Complex* spectrum = history_ + history_index_ * AEC_BINS;
+    for (int f = 0; f < AEC_BINS; f++) {
+        spectrum[f] = fft_[f];
+        int64_t power = (int64_t)fft_[f].re * fft_[f].re + (int64_t)fft_[f].im * fft_[f].im;
+        power_[f] += (power - power_[f]) >> 2;
+    }
+
+    Filter(foreground_, mic, output);
+    Filter(background_, mic, background_output_);
+
+    uint64_t mic_energy = 0;
+    uint64_t foreground_energy = 0;
+    uint64_t background_energy = 0;
+    for (int i = 0; i < AEC_BLOCK; i++) {
+        mic_energy += mic[i] * mic[i];
+        foreground_energy += output[i] * output[i];
+        background_energy += background_output_[i] * background_output_[i];
+    }
+    foreground_error_ += ((int64_t)foreground_energy - foreground_error_) >> 3;
+    background_error_ += ((int64_t)background_energy - background_error_) >> 3;
+
+    statistics_.blocks++;
+    if (reference_energy < AEC_MIN_REFERENCE_ENERGY) {
+        return;
+    }
+
+    statistics_.far_end_blocks++;
+    statistics_.far_end_mic_energy += mic_energy;
+    statistics_.far_end_output_energy += foreground_energy;
+
+    Adapt(background_output_);
+    Constrain(background_ + constraint_index_ * AEC_BINS);
+    constraint_index_ = (constraint_index_ + 1) % partitions_;
+
+    size_t size = partitions_ * AEC_BINS * sizeof(Complex);
+    if (background_error_ * 8 < foreground_error_ * 7) {
+        // 后台滤波器消除得更多，输出改用它的系数
+        memcpy(foreground_, background_, size);
+        foreground_error_ = background_error_;
+        statistics_.foreground_updates++;
+    } else if (background_error_ > foreground_error_ * 4) {
+        // 双讲时后台滤波器发散，从前台恢复
+        memcpy(background_, foreground_, size);
+        background_error_ = foreground_error_;
+        statistics_.background_resets++;
+    }
+}
+
+void EchoCanceller::Filter(const Complex* weights, const int16_t* mic, int16_t* output) {
+    for (int f = 0; f < AEC_BINS; f++) {
+        int64_t re = 0;
+        int64_t im = 0;
+        for (int p = 0; p < partitions_; p++) {
+            const Complex& x = delayed_[p][f];
+            const Complex& w = weights[p * AEC_BINS + f];
+            re += (int64_t)w.re * x.re - (int64_t)w.im * x.im;
+            im += (int64_t)w.re * x.im + (int64_t)w.im * x.re;
+        }
+        fft_[f] = { Saturate(re >> 24, INT32_MAX), Saturate(im >> 24, INT32_MAX) };
+    }
+    fft_[0].im = 0;
+    fft_[AEC_BINS - 1].im = 0;
+    for (int f = 1; f < AEC_BINS - 1; f++) {
+        fft_[AEC_FFT_SIZE - f] = { fft_[f].re, -fft_[f].im };
+    }
+    Fft(fft_, true);
+
+    for (int i = 0; i < AEC_BLOCK; i++) {
+        output[i] = Saturate16(mic[i] - fft_[AEC_BLOCK + i].re);
+    }
+}
+
+void EchoCanceller::Adapt(const int16_t* error) {
+    for (int i = 0; i < AEC_BLOCK; i++) {
+        fft_[i] = { 0, 0 };
+        fft_[AEC_BLOCK + i] = { error[i], 0 };
+    }
+    Fft(fft_, false);
+
+    for (int f = 0; f < AEC_BINS; f++) {
+        // mu / P with P = m * 2^(s - 7), 1/m from a Q22 reciprocal of the top 8 bits
+        int64_t power = power_[f] * partitions_ + AEC_REGULARIZATION;
+        int s = 63 - __builtin_clzll(power);
+        uint32_t m = (uint32_t)(power >> (s - 7));
+        int64_t factor = ((int64_t)AEC_STEP_Q15 * ((1 << 22) / m)) >> 18;
+        // The regularization keeps s >= 17, so the shift is never negative
+        int shift = s - 12;
+
+        const Complex& e = fft_[f];
+        for (int p = 0; p < partitions_; p++) {
+            const Complex& x = delayed_[p][f];
+            Complex& w = background_[p * AEC_BINS + f];
+            int64_t re = (int64_t)x.re * e.re + (int64_t)x.im * e.im;
+            int64_t im = (int64_t)x.re * e.im - (int64_t)x.im * e.re;
+            w.re = Saturate(w.re + ((re * factor) >> shift), AEC_WEIGHT_LIMIT);
+            w.im = Saturate(w.im + ((im * factor) >> shift), AEC_WEIGHT_LIMIT);
+        }
+    }
+}
+
+// Keep one partition a causal 64-tap filter, one partition per block in turn
+void EchoCanceller::Constrain(Complex* weights) {
+    for (int f = 0; f < AEC_BINS; f++) {
+        fft_[f] = weights[f];
+    }
+    fft_[0].im = 0;
+    fft_[AEC_BINS - 1].im = 0;
+    for (int f = 1; f < AEC_BINS - 1; f++) {
+        fft_[AEC_FFT_SIZE - f] = { fft_[f].re, -fft_[f].im };
+    }
+    Fft(fft_, true);
+
+    for (int i = 0; i < AEC_FFT_SIZE; i++) {
+        fft_[i].im = 0;
+        if (i >= AEC_BLOCK) {
+            fft_[i].re = 0;
+        }
+    }
+    Fft(fft_, false);
+
+    for (int f = 0; f < AEC_BINS; f++) {
+        weights[f].re = Saturate(fft_[f].re, AEC_WEIGHT_LIMIT);
+        weights[f].im = Saturate(fft_[f].im, AEC_WEIGHT_LIMIT);
+    }
+}
+
+int EchoCanceller::TakeErleDb(Statistics& statistics) {
+    statistics = statistics_;
+    statistics_ = Statistics();
+    if (statistics.far_end_output_energy == 0) {
+        return 0;
+    }
+    // 256 in log2 Q8 is 3.0103 dB
+    int difference = Log2Q8(statistics.far_end_mic_energy) - Log2Q8(statistics.far_end_output_energy);
+    return difference * 301 / 25600;
+}
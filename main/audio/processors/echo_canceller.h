@@ -0,0 +1,66 @@
+#ifndef ECHO_CANCELLER_H
+#define ECHO_CANCELLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Fixed-point partitioned-block frequency-domain NLMS echo canceller for boards without the AFE.
+ *
+ * 16 kHz audio is processed in 64-sample blocks with 128-point FFTs (overlap-save). The echo
+ * path is modelled by `tail_ms / 4` partitions. Two filters run side by side: the background
+ * filter adapts on every block with a per-bin normalized step, the foreground filter produces
+ * the output and only takes the background coefficients when they cancel more echo. A background
+ * filter that diverges during double talk is restored from the foreground one.
+ */
+class EchoCanceller {
+public:
+    struct Statistics {
+        uint32_t blocks = 0;
+        uint32_t far_end_blocks = 0;
+        uint32_t foreground_updates = 0;
+        uint32_t background_resets = 0;
+        uint64_t far_end_mic_energy = 0;
+        uint64_t far_end_output_energy = 0;
+    };
+
+    EchoCanceller(int tail_ms);
+    ~EchoCanceller();
+
+    // Mic is the first channel, the playback reference is `reference_channel` of `channels`
+    // interleaved channels. `samples` must be a multiple of the 64-sample block.
+    void Process(const int16_t* input, int channels, int reference_channel, size_t samples, int16_t* output);
+    void Reset();
+
+    // Echo return loss enhancement over the far-end blocks since the last call, in dB
+    int TakeErleDb(Statistics& statistics);
+
+private:
+    struct Complex {
+        int32_t re;
+        int32_t im;
+    };
+
+    int partitions_;
+    Complex* history_ = nullptr;        // partitions_ reference spectra, newest at history_index_
+    Complex* foreground_ = nullptr;     // partitions_ x bins, Q24
+    Complex* background_ = nullptr;
+    const Complex** delayed_ = nullptr; // Reference spectrum of each partition for the current block
+    int64_t* power_ = nullptr;          // Smoothed reference power per bin
+    int history_index_ = 0;
+    int constraint_index_ = 0;
+
+    int16_t last_reference_[64] = {};
+    int64_t foreground_error_ = 0;
+    int64_t background_error_ = 0;
+    Complex fft_[128];
+    int16_t background_output_[64];
+    Statistics statistics_;
+
+    void ProcessBlock(const int16_t* mic, const int16_t* reference, int16_t* output);
+    void Filter(const Complex* weights, const int16_t* mic, int16_t* output);
+    void Adapt(const int16_t* error);
+    void Constrain(Complex* weights);
+};
+
+#endif // ECHO_CANCELLER_H
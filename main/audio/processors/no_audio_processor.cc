@@ -1,11 +1,36 @@
 #include "no_audio_processor.h"
 #include <esp_log.h>
+#include <esp_timer.h>
+
+#include <cstring>
 
 #define TAG "NoAudioProcessor"
 
+#define VAD_STATS_INTERVAL_US (10 * 1000 * 1000)
+#define AEC_STATS_INTERVAL_US (10 * 1000 * 1000)
+
 void NoAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms) {
     codec_ = codec;
     frame_samples_ = frame_duration_ms * 16000 / 1000;
+    reframer_.Initialize(frame_samples_);
+
+    // The hardware reference is the last input channel
+    input_channels_ = codec_->input_channels();
+    if (codec_->input_reference()) {
+        reference_channel_ = input_channels_ - 1;
+    }
+#if CONFIG_USE_SOFTWARE_AEC
+    if (!codec_->input_reference()) {
+        // AudioService appends the playback reference as an extra channel
+        reference_channel_ = input_channels_;
+        input_channels_++;
+    }
+    echo_canceller_ = std::make_unique<EchoCanceller>(CONFIG_SOFTWARE_AEC_TAIL_MS);
+    aec_output_.reserve(frame_samples_);
+#endif
+    frame_callback_ = [this](std::vector<int16_t>&& frame) {
+        OutputFrame(std::move(frame));
+    };
 }
 
 void NoAudioProcessor::Feed(std::vector<int16_t>&& data) {
@@ -13,24 +38,107 @@ void NoAudioProcessor::Feed(std::vector<int16_t>&& data) {
         return;
     }
 
-    if (codec_->input_channels() == 2) {
-        // If input channels is 2, we need to fetch the left channel data
-        auto mono_data = std::vector<int16_t>(data.size() / 2);
-        for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-            mono_data[i] = data[j];
+#if CONFIG_USE_SOFTWARE_AEC
+    if (aec_enabled_ && reference_channel_ >= 0) {
+        CancelEcho(data);
+        reframer_.Push(aec_output_.data(), aec_output_.size(), 1, frame_callback_);
+        return;
+    }
+#endif
+
+    // If input channels is 2, the reframer takes the left channel data
+    reframer_.Push(data.data(), data.size() / input_channels_, input_channels_, frame_callback_);
+}
+
+#if CONFIG_USE_SOFTWARE_AEC
+void NoAudioProcessor::CancelEcho(std::vector<int16_t>& data) {
+    // Reset on the input task so it never races with Process()
+    if (aec_reset_pending_.exchange(false)) {
+        echo_canceller_->Reset();
+    }
+
+    auto start_time = esp_timer_get_time();
+    size_t samples = data.size() / input_channels_;
+    aec_output_.resize(samples);
+    echo_canceller_->Process(data.data(), input_channels_, reference_channel_, samples, aec_output_.data());
+
+    auto now = esp_timer_get_time();
+    aec_process_time_us_ += now - start_time;
+    aec_frames_++;
+    if (now - aec_log_time_ >= AEC_STATS_INTERVAL_US) {
+        aec_log_time_ = now;
+        EchoCanceller::Statistics stats;
+        int erle_db = echo_canceller_->TakeErleDb(stats);
+        uint32_t us_per_frame = aec_process_time_us_ / aec_frames_;
+        ESP_LOGI(TAG, "AEC: %lu us per frame, ERLE %d dB, far end %lu/%lu blocks, %lu fg updates, %lu bg resets",
+            us_per_frame, erle_db, stats.far_end_blocks, stats.blocks, stats.foreground_updates, stats.background_resets);
+        // 处理时间超过帧长的四分之一时，音频输入任务可能来不及读取采集数据
+        uint32_t frame_us = samples * 1000 / 16;
+        if (us_per_frame > frame_us / 4) {
+            ESP_LOGW(TAG, "AEC takes %lu us of a %lu us frame, consider a shorter tail", us_per_frame, frame_us);
+        }
+        aec_process_time_us_ = 0;
+        aec_frames_ = 0;
+    }
+}
+#endif
+
+void NoAudioProcessor::OutputFrame(std::vector<int16_t>&& frame) {
+#if CONFIG_USE_SOFTWARE_VAD
+    auto start_time = esp_timer_get_time();
+    bool speech = vad_.Process(frame.data(), frame.size());
+    if (vad_.speaking() != is_speaking_) {
+        is_speaking_ = vad_.speaking();
+        if (vad_state_change_callback_) {
+            vad_state_change_callback_(is_speaking_);
         }
-        output_callback_(std::move(mono_data));
+    }
+
+    auto& stats = vad_statistics_;
+    stats.frames++;
+    if (speech) {
+        stats.speech_frames++;
     } else {
-        output_callback_(std::move(data));
+#if CONFIG_SOFTWARE_VAD_MUTE_SILENCE
+        // 全零帧编码后只有几个字节，服务器仍能收到连续的时间线
+        memset(frame.data(), 0, frame.size() * sizeof(int16_t));
+        stats.muted_frames++;
+#endif
+    }
+    auto now = esp_timer_get_time();
+    stats.process_time_us += now - start_time;
+    if (now - vad_log_time_ >= VAD_STATS_INTERVAL_US) {
+        vad_log_time_ = now;
+        ESP_LOGI(TAG, "VAD: %lu frames, %lu speech, %lu muted, %lu us per frame", stats.frames,
+            stats.speech_frames, stats.muted_frames, (uint32_t)(stats.process_time_us / stats.frames));
+        stats = VadStatistics();
     }
+#endif
+    output_callback_(std::move(frame));
 }
 
 void NoAudioProcessor::Start() {
+#if CONFIG_USE_SOFTWARE_AEC
+    aec_reset_pending_ = true;
+#endif
+#if CONFIG_USE_SOFTWARE_VAD
+    vad_.Reset();
+#endif
+    // 上次会话残留的半帧不能拼到新会话的开头
+    reframer_.Reset();
     is_running_ = true;
 }
 
 void NoAudioProcessor::Stop() {
     is_running_ = false;
+#if CONFIG_USE_SOFTWARE_VAD
+    if (is_speaking_) {
+        is_speaking_ = false;
+        if (vad_state_change_callback_) {
+            vad_state_change_callback_(false);
+        }
+    }
+#endif
 }
 
 bool NoAudioProcessor::IsRunning() {
@@ -41,6 +149,10 @@ void NoAudioProcessor::OnOutput(std::function<void(std::vector<int16_t>&& data)>
     output_callback_ = callback;
 }
 
+void NoAudioProcessor::RecycleOutput(std::vector<int16_t>&& data) {
+    reframer_.Recycle(std::move(data));
+}
+
 void NoAudioProcessor::OnVadStateChange(std::function<void(bool speaking)> callback) {
     vad_state_change_callback_ = callback;
 }
@@ -53,7 +165,13 @@ size_t NoAudioProcessor::GetFeedSize() {
 }
 
 void NoAudioProcessor::EnableDeviceAec(bool enable) {
+#if CONFIG_USE_SOFTWARE_AEC
+    ESP_LOGI(TAG, "Software AEC %s", enable ? "enabled" : "disabled");
+    aec_enabled_ = enable;
+    aec_reset_pending_ = true;
+#else
     if (enable) {
         ESP_LOGE(TAG, "Device AEC is not supported");
     }
+#endif
 }
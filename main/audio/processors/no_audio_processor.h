@@ -3,9 +3,18 @@
 
 #include <vector>
 #include <functional>
+#include <memory>
+#include <atomic>
 
 #include "audio_processor.h"
 #include "audio_codec.h"
+#include "audio_reframer.h"
+#if CONFIG_USE_SOFTWARE_VAD
+#include "software_vad.h"
+#endif
+#if CONFIG_USE_SOFTWARE_AEC
+#include "echo_canceller.h"
+#endif
 
 class NoAudioProcessor : public AudioProcessor {
 public:
@@ -18,6 +27,7 @@ public:
     void Stop() override;
     bool IsRunning() override;
     void OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) override;
+    void RecycleOutput(std::vector<int16_t>&& data) override;
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
     size_t GetFeedSize() override;
     void EnableDeviceAec(bool enable) override;
@@ -25,9 +35,41 @@ public:
 private:
     AudioCodec* codec_ = nullptr;
     int frame_samples_ = 0;
+    int input_channels_ = 1;
+    int reference_channel_ = -1;
     std::function<void(std::vector<int16_t>&& data)> output_callback_;
     std::function<void(bool speaking)> vad_state_change_callback_;
     bool is_running_ = false;
+    AudioReframer reframer_;
+    std::function<void(std::vector<int16_t>&& data)> frame_callback_;
+
+#if CONFIG_USE_SOFTWARE_VAD
+    struct VadStatistics {
+        uint32_t frames = 0;
+        uint32_t speech_frames = 0;
+        uint32_t muted_frames = 0;
+        int64_t process_time_us = 0;
+    };
+
+    SoftwareVad vad_{CONFIG_SOFTWARE_VAD_THRESHOLD_DB, CONFIG_SOFTWARE_VAD_HANGOVER_MS};
+    bool is_speaking_ = false;
+    VadStatistics vad_statistics_;
+    int64_t vad_log_time_ = 0;
+#endif
+
+#if CONFIG_USE_SOFTWARE_AEC
+    std::unique_ptr<EchoCanceller> echo_canceller_;
+    std::vector<int16_t> aec_output_;
+    std::atomic<bool> aec_enabled_{true};
+    std::atomic<bool> aec_reset_pending_{false};
+    int64_t aec_process_time_us_ = 0;
+    uint32_t aec_frames_ = 0;
+    int64_t aec_log_time_ = 0;
+
+    void CancelEcho(std::vector<int16_t>& data);
+#endif
+
+    void OutputFrame(std::vector<int16_t>&& frame);
 };
 
 #endif 
\ No newline at end of file
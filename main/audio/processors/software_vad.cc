@@ -0,0 +1,111 @@
+#include "software_vad.h"
+
+#include <algorithm>
+
+#define VAD_SUBFRAME_SAMPLES 320    // 20ms at 16kHz
+#define VAD_ONSET_SUBFRAMES 2
+#define VAD_MIN_POWER 64            // Mean power below this (about -66 dBFS) is never speech
+#define VAD_HISS_ZCR_PERCENT 40
+#define VAD_HISS_HIGH_BAND_Q8 192   // 75% of the energy above 4 kHz
+#define VAD_MIN_BLOCK_SUBFRAMES 40  // 0.8s, longer than any pause-free stretch of speech
+
+// 以 log2 表示的功率，Q8 定点，256 约等于 3 dB
+static int Log2Q8(uint32_t x) {
+    if (x == 0) {
+        return 0;
+    }
+    int msb = 31 - __builtin_clz(x);
+    uint32_t frac = msb >= 8 ? (x >> (msb - 8)) & 0xff : (x << (8 - msb)) & 0xff;
+    return msb * 256 + frac;
+}
+
+SoftwareVad::SoftwareVad(int threshold_db, int hangover_ms) {
+    // 1 dB = 256 / 3.0103 in log2 Q8
+    threshold_ = threshold_db * 85;
+    hangover_subframes_ = std::max(1, hangover_ms / 20);
+}
+
+void SoftwareVad::Reset() {
+    last_sample_ = 0;
+    speaking_ = false;
+    onset_count_ = 0;
+    hangover_left_ = 0;
+}
+
+bool SoftwareVad::Process(const int16_t* data, size_t samples) {
+    bool speech = false;
+    while (samples > 0) {
+        size_t count = std::min(samples, (size_t)VAD_SUBFRAME_SAMPLES);
+        ProcessSubframe(data, count);
+        speech |= speaking_;
+        data += count;
+        samples -= count;
+    }
+    return speech;
+}
+
+void SoftwareVad::ProcessSubframe(const int16_t* data, size_t samples) {
+    // 一阶和/差滤波把频谱分成 4 kHz 以下和以上两个子带
+    uint64_t energy = 0;
+    uint64_t low_band = 0;
+    uint64_t high_band = 0;
+    int zero_crossings = 0;
+    int32_t prev = last_sample_;
+    for (size_t i = 0; i < samples; i++) {
+        int32_t x = data[i];
+        int32_t sum = (x + prev) >> 1;
+        int32_t diff = (x - prev) >> 1;
+        energy += (uint32_t)(x * x);
+        low_band += (uint32_t)(sum * sum);
+        high_band += (uint32_t)(diff * diff);
+        zero_crossings += (x ^ prev) < 0;
+        prev = x;
+    }
+    last_sample_ = prev;
+
+    uint32_t power = (uint32_t)(energy / samples);
+    int level = Log2Q8(power);
+    if (!noise_floor_valid_) {
+        noise_floor_ = level;
+        noise_floor_valid_ = true;
+    }
+
+    bool active = power >= VAD_MIN_POWER && level > noise_floor_ + threshold_;
+    if (active && !speaking_) {
+        uint32_t high_share = (uint32_t)((high_band << 8) / (low_band + high_band + 1));
+        if (zero_crossings * 100 > (int)samples * VAD_HISS_ZCR_PERCENT && high_share > VAD_HISS_HIGH_BAND_Q8) {
+            active = false;
+        }
+    }
+
+    // 噪声底快降慢升，说话期间几乎不升，避免被长句抬高
+    if (level < noise_floor_) {
+        noise_floor_ -= std::max(1, (noise_floor_ - level) >> 2);
+    } else if (level > noise_floor_) {
+        noise_floor_ += std::max(1, (level - noise_floor_) >> (speaking_ ? 9 : 6));
+    }
+
+    // 语音中总有接近噪声底的停顿，若 0.8-1.6 秒内的最低电平都高于噪声底，说明背景噪声变大了
+    block_min_ = std::min(block_min_, level);
+    if (++block_count_ == VAD_MIN_BLOCK_SUBFRAMES) {
+        previous_block_min_ = block_min_;
+        block_min_ = INT_MAX;
+        block_count_ = 0;
+    }
+    noise_floor_ = std::max(noise_floor_, std::min(block_min_, previous_block_min_));
+
+    if (active) {
+        onset_count_++;
+        if (!speaking_ && onset_count_ >= VAD_ONSET_SUBFRAMES) {
+            speaking_ = true;
+        }
+        if (speaking_) {
+            hangover_left_ = hangover_subframes_;
+        }
+    } else {
+        onset_count_ = 0;
+        if (speaking_ && --hangover_left_ <= 0) {
+            speaking_ = false;
+        }
+    }
+}
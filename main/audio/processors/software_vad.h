@@ -0,0 +1,45 @@
+#ifndef SOFTWARE_VAD_H
+#define SOFTWARE_VAD_H
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Fixed-point voice activity detector for boards without the AFE.
+ *
+ * Works on 20 ms sub-frames of 16 kHz mono audio. A sub-frame is active when its energy is
+ * above a tracked noise floor; hiss-like sub-frames (high zero-crossing rate with most energy
+ * in the upper band) are ignored until speech has started. Two active sub-frames start speech,
+ * and speech is held for the hangover time after the last active sub-frame. The floor is also
+ * kept at or above the minimum level of the last 0.8-1.6 s, so a sudden rise of the background
+ * noise ends a false speech segment instead of holding it.
+ */
+class SoftwareVad {
+public:
+    SoftwareVad(int threshold_db, int hangover_ms);
+
+    // Returns true if any part of the frame is speech, including the hangover
+    bool Process(const int16_t* data, size_t samples);
+    void Reset();
+    bool speaking() const { return speaking_; }
+
+private:
+    int threshold_;
+    int hangover_subframes_;
+
+    int32_t last_sample_ = 0;
+    bool noise_floor_valid_ = false;
+    int noise_floor_ = 0;
+    bool speaking_ = false;
+    int onset_count_ = 0;
+    int hangover_left_ = 0;
+    // Minimum level of the current and the previous block, the floor never stays below both
+    int block_min_ = INT_MAX;
+    int previous_block_min_ = INT_MAX;
+    int block_count_ = 0;
+
+    void ProcessSubframe(const int16_t* data, size_t samples);
+};
+
+#endif // SOFTWARE_VAD_H
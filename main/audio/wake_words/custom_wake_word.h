@@ -6,16 +6,14 @@
 #include <esp_mn_models.h>
 #include <model_path.h>
 
-#include <deque>
 #include <string>
 #include <vector>
 #include <functional>
-#include <mutex>
-#include <condition_variable>
 #include <atomic>
 
 #include "audio_codec.h"
 #include "wake_word.h"
+#include "wake_word_encoder.h"
 
 class CustomWakeWord : public WakeWord {
 public:
@@ -44,15 +42,7 @@ private:
     std::string last_detected_wake_word_;
     std::atomic<bool> running_ = false;
 
-    TaskHandle_t wake_word_encode_task_ = nullptr;
-    StaticTask_t* wake_word_encode_task_buffer_ = nullptr;
-    StackType_t* wake_word_encode_task_stack_ = nullptr;
-    std::deque<std::vector<int16_t>> wake_word_pcm_;
-    std::deque<std::vector<uint8_t>> wake_word_opus_;
-    std::mutex wake_word_mutex_;
-    std::condition_variable wake_word_cv_;
-
-    void StoreWakeWordData(const std::vector<int16_t>& data);
+    WakeWordEncoder wake_word_encoder_;
 };
 
 #endif
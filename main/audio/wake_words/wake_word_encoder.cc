@@ -0,0 +1,225 @@
+#include "wake_word_encoder.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <opus_encoder.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+
+#define TAG "WakeWordEncoder"
+
+// PCM 环只需要吸收编码任务的延迟，唤醒词窗口本身以 Opus 包的形式保存
+#define WAKE_WORD_PCM_RING_SAMPLES 16384
+#define WAKE_WORD_ENCODE_TASK_STACK_SIZE (4096 * 7)
+
+WakeWordEncoder::WakeWordEncoder(int duration_ms, int frame_duration_ms) {
+    frame_duration_ms_ = frame_duration_ms;
+    frame_samples_ = frame_duration_ms * 16000 / 1000;
+    max_packets_ = duration_ms / frame_duration_ms;
+    capacity_ = WAKE_WORD_PCM_RING_SAMPLES;
+}
+
+WakeWordEncoder::~WakeWordEncoder() {
+    if (encode_task_ != nullptr) {
+        vTaskDelete(encode_task_);
+    }
+    if (encode_task_stack_ != nullptr) {
+        heap_caps_free(encode_task_stack_);
+    }
+    if (encode_task_buffer_ != nullptr) {
+        heap_caps_free(encode_task_buffer_);
+    }
+    if (pcm_buffer_ != nullptr) {
+        heap_caps_free(pcm_buffer_);
+    }
+}
+
+void WakeWordEncoder::StartEncodeTask() {
+    size_t size = capacity_ * sizeof(int16_t);
+#if CONFIG_SPIRAM
+    pcm_buffer_ = (int16_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+#endif
+    if (pcm_buffer_ == nullptr) {
+        pcm_buffer_ = (int16_t*)heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    assert(pcm_buffer_ != nullptr);
+
+    encode_task_stack_ = (StackType_t*)heap_caps_malloc(WAKE_WORD_ENCODE_TASK_STACK_SIZE, MALLOC_CAP_SPIRAM);
+    assert(encode_task_stack_ != nullptr);
+    encode_task_buffer_ = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+    assert(encode_task_buffer_ != nullptr);
+
+    encode_task_ = xTaskCreateStatic([](void* arg) {
+        auto this_ = (WakeWordEncoder*)arg;
+        this_->EncodeTask();
+        vTaskDelete(NULL);
+    }, "encode_wake_word", WAKE_WORD_ENCODE_TASK_STACK_SIZE, this, 1, encode_task_stack_, encode_task_buffer_);
+    ESP_LOGI(TAG, "Wake word encoder started, PCM ring %u bytes, window %u packets", (unsigned)size,
+        (unsigned)max_packets_);
+}
+
+void WakeWordEncoder::Store(const int16_t* data, size_t samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ != kStateCollecting || pcm_buffer_ == nullptr) {
+        return;
+    }
+    if (samples > capacity_) {
+        data += samples - capacity_;
+        samples = capacity_;
+    }
+
+    size_t offset = write_position_ % capacity_;
+    size_t first = std::min(samples, capacity_ - offset);
+    memcpy(pcm_buffer_ + offset, data, first * sizeof(int16_t));
+    if (first < samples) {
+        memcpy(pcm_buffer_, data + first, (samples - first) * sizeof(int16_t));
+    }
+    write_position_ += samples;
+
+    // 编码任务跟不上时丢弃最旧的数据
+    if (write_position_ - read_position_ > capacity_) {
+        read_position_ = write_position_ - capacity_;
+        overruns_++;
+    }
+    if (write_position_ - read_position_ >= (uint32_t)frame_samples_) {
+        cv_.notify_all();
+    }
+}
+
+void WakeWordEncoder::CopyFrame(int16_t* pcm, size_t samples) {
+    size_t offset = read_position_ % capacity_;
+    size_t first = std::min(samples, capacity_ - offset);
+    memcpy(pcm, pcm_buffer_ + offset, first * sizeof(int16_t));
+    if (first < samples) {
+        memcpy(pcm + first, pcm_buffer_, (samples - first) * sizeof(int16_t));
+    }
+    read_position_ += samples;
+}
+
+void WakeWordEncoder::Reset() {
+    if (encode_task_ == nullptr) {
+        StartEncodeTask();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    state_ = kStateCollecting;
+    read_position_ = write_position_;
+    packets_.clear();
+    reset_encoder_ = true;
+    cv_.notify_all();
+}
+
+void WakeWordEncoder::Seal() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ != kStateCollecting) {
+        return;
+    }
+    state_ = encode_task_ != nullptr ? kStateSealing : kStateSealed;
+    seal_time_ = esp_timer_get_time();
+    popped_packets_ = 0;
+    ESP_LOGI(TAG, "Wake word window sealed: %u packets ready, %u samples pending, %u overruns",
+        (unsigned)packets_.size(), (unsigned)(write_position_ - read_position_), (unsigned)overruns_);
+    if (encoded_frames_ > 0) {
+        ESP_LOGI(TAG, "Idle encoding: %u us per %d ms frame", (unsigned)(encode_time_us_ / encoded_frames_),
+            frame_duration_ms_);
+    }
+    cv_.notify_all();
+}
+
+bool WakeWordEncoder::Pop(std::vector<uint8_t>& opus) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (state_ == kStateCollecting) {
+        return false;
+    }
+    cv_.wait(lock, [this]() {
+        return !packets_.empty() || state_ == kStateSealed;
+    });
+    if (packets_.empty()) {
+        ESP_LOGI(TAG, "Popped %d wake word packets, drained %ld ms after detection", popped_packets_,
+            (long)((esp_timer_get_time() - seal_time_) / 1000));
+        return false;
+    }
+
+    if (popped_packets_++ == 0) {
+        ESP_LOGI(TAG, "First wake word packet popped %ld ms after detection",
+            (long)((esp_timer_get_time() - seal_time_) / 1000));
+    }
+    opus.swap(packets_.front());
+    packets_.pop_front();
+    return true;
+}
+
+void WakeWordEncoder::EncodeTask() {
+    auto encoder = std::make_unique<OpusEncoderWrapper>(16000, 1, frame_duration_ms_);
+    encoder->SetComplexity(0); // 0 is the fastest
+
+    std::vector<int16_t> pcm(frame_samples_);
+    std::vector<uint8_t> opus;
+    while (true) {
+        uint32_t generation;
+        bool encode = true;
+        bool last = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() {
+                return reset_encoder_ || state_ == kStateSealing ||
+                    (state_ == kStateCollecting && write_position_ - read_position_ >= (uint32_t)frame_samples_);
+            });
+            if (reset_encoder_) {
+                reset_encoder_ = false;
+                encoder->ResetState();
+                continue;
+            }
+
+            size_t pending = write_position_ - read_position_;
+            if (pending >= (size_t)frame_samples_) {
+                CopyFrame(pcm.data(), frame_samples_);
+            } else {
+                // 唤醒后不足一帧的尾部补零编码
+                CopyFrame(pcm.data(), pending);
+                std::fill(pcm.begin() + pending, pcm.end(), 0);
+                encode = pending > 0;
+                last = true;
+            }
+            generation = generation_;
+        }
+
+        int64_t start_time = esp_timer_get_time();
+        if (encode && !encoder->Encode(std::move(pcm), opus)) {
+            ESP_LOGE(TAG, "Failed to encode wake word audio");
+            encode = false;
+        }
+        pcm.resize(frame_samples_);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (encode) {
+            encode_time_us_ += esp_timer_get_time() - start_time;
+            encoded_frames_++;
+        }
+        // Reset() was called while encoding, the packet belongs to the old window
+        if (generation != generation_) {
+            continue;
+        }
+        if (encode) {
+            if (state_ == kStateCollecting && packets_.size() >= max_packets_) {
+                // 复用最旧包的缓冲区，滚动窗口在稳定状态下不再分配内存
+                auto recycled = std::move(packets_.front());
+                packets_.pop_front();
+                packets_.push_back(std::move(opus));
+                opus = std::move(recycled);
+            } else {
+                packets_.push_back(std::move(opus));
+                opus = std::vector<uint8_t>();
+            }
+        }
+        if (last) {
+            state_ = kStateSealed;
+        }
+        cv_.notify_all();
+    }
+}
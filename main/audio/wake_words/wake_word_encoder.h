@@ -0,0 +1,73 @@
+#ifndef WAKE_WORD_ENCODER_H
+#define WAKE_WORD_ENCODER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * Keeps the audio around a wake word ready for upload.
+ *
+ * The detector stores mono 16 kHz PCM into a fixed ring, and a low priority task encodes every
+ * complete Opus frame as soon as it arrives, keeping a rolling window of the latest packets.
+ * When a wake word is detected, Seal() freezes the window and only the unfinished tail is left
+ * to encode, so Pop() hands out packets right away instead of waiting for the whole buffer.
+ * The price is encoding every frame while idle, about one encode per `frame_duration_ms` on a
+ * priority 1 task; Seal() logs the measured average.
+ */
+class WakeWordEncoder {
+public:
+    WakeWordEncoder(int duration_ms, int frame_duration_ms);
+    ~WakeWordEncoder();
+
+    // Called from the detection task
+    void Store(const int16_t* data, size_t samples);
+    // Drop the stored audio and start collecting a new window
+    void Reset();
+    // Stop collecting, encode the remaining samples and make the window available to Pop()
+    void Seal();
+    // Returns false when the sealed window has been drained
+    bool Pop(std::vector<uint8_t>& opus);
+
+private:
+    enum State {
+        kStateCollecting,
+        kStateSealing,
+        kStateSealed,
+    };
+
+    int frame_duration_ms_;
+    int frame_samples_;
+    size_t max_packets_;
+    size_t capacity_;
+    int16_t* pcm_buffer_ = nullptr;
+    uint32_t write_position_ = 0;
+    uint32_t read_position_ = 0;
+    uint32_t overruns_ = 0;
+
+    State state_ = kStateCollecting;
+    uint32_t generation_ = 0;
+    bool reset_encoder_ = false;
+    std::deque<std::vector<uint8_t>> packets_;
+    int64_t seal_time_ = 0;
+    int popped_packets_ = 0;
+    int64_t encode_time_us_ = 0;
+    uint32_t encoded_frames_ = 0;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    TaskHandle_t encode_task_ = nullptr;
+    StaticTask_t* encode_task_buffer_ = nullptr;
+    StackType_t* encode_task_stack_ = nullptr;
+
+    void StartEncodeTask();
+    void EncodeTask();
+    void CopyFrame(int16_t* pcm, size_t samples);
+};
+
+#endif // WAKE_WORD_ENCODER_H
@@ -99,6 +99,8 @@ void PowerSaveTimer::PowerSaveCheck() {
         }
     }
     if (seconds_to_shutdown_ != -1 && ticks_ >= seconds_to_shutdown_ && on_shutdown_request_) {
+        // 板级关机通常直接断电，先提交设置
+        Settings::Flush();
         on_shutdown_request_();
     }
 }
@@ -86,6 +86,8 @@ void SleepTimer::CheckTimer() {
             }
         
             app.Schedule([this, &app]() {
+                // 休眠期间提交定时器不会运行，先写入未提交的设置
+                Settings::Flush();
                 while (in_light_sleep_mode_) {
                     auto& board = Board::GetInstance();
                     board.GetDisplay()->UpdateStatusBar(true);
@@ -118,6 +120,7 @@ void SleepTimer::CheckTimer() {
             on_enter_deep_sleep_mode_();
         }
 
+        Settings::Flush();
         esp_deep_sleep_start();
     }
 }
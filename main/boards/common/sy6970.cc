@@ -1,6 +1,7 @@
 #include "sy6970.h"
 #include "board.h"
 #include "display.h"
+#include "settings.h"
 
 #include <esp_log.h>
 
@@ -61,5 +62,7 @@ int Sy6970::GetBatteryLevel() {
 }
 
 void Sy6970::PowerOff() {
+    // 断电不经过 esp_restart 的关机回调，先提交设置
+    Settings::Flush();
     WriteReg(0x09, 0B01100100);
 }
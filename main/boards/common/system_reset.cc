@@ -1,4 +1,5 @@
 #include "system_reset.h"
+#include "settings.h"
 
 #include <esp_log.h>
 #include <nvs_flash.h>
@@ -42,6 +43,8 @@ void SystemReset::ResetNvsFlash() {
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to erase NVS flash");
     }
+    // 丢弃设置缓存，否则重启前的提交会把旧值写回
+    Settings::Discard();
     ret = nvs_flash_init();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize NVS flash");
@@ -1,8 +1,10 @@
 #include <esp_log.h>
 #include <esp_err.h>
+#include <esp_heap_caps.h>
 #include <string>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <font_awesome.h>
 
 #include "display.h"
@@ -14,6 +16,8 @@
 
 #define TAG "Display"
 
+#define DISPLAY_UPDATE_RETRY_US 5000
+
 Display::Display() {
     // Notification timer
     esp_timer_create_args_t notification_timer_args = {
@@ -30,6 +34,27 @@ Display::Display() {
     };
     ESP_ERROR_CHECK(esp_timer_create(&notification_timer_args, &notification_timer_));
 
+    // Update timer, applies queued intents when LVGL has nothing to refresh.
+    // LVGL pauses its refresh timer while nothing is invalidated, so the
+    // refresh start hook alone would leave them pending on an idle screen.
+    esp_timer_create_args_t update_timer_args = {
+        .callback = [](void *arg) {
+            Display *display = static_cast<Display*>(arg);
+            // 显示锁被占用（通常正在渲染）时稍后重试，不阻塞 esp_timer 任务
+            if (!display->Lock(1)) {
+                esp_timer_start_once(display->update_timer_, DISPLAY_UPDATE_RETRY_US);
+                return;
+            }
+            display->ApplyPendingUpdates();
+            display->Unlock();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "display_update",
+        .skip_unhandled_events = false,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&update_timer_args, &update_timer_));
+
     // Create a power management lock
     auto ret = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "display_update", &pm_lock_);
     if (ret == ESP_ERR_NOT_SUPPORTED) {
@@ -44,6 +69,10 @@ Display::~Display() {
         esp_timer_stop(notification_timer_);
         esp_timer_delete(notification_timer_);
     }
+    if (update_timer_ != nullptr) {
+        esp_timer_stop(update_timer_);
+        esp_timer_delete(update_timer_);
+    }
 
     if (network_label_ != nullptr) {
         lv_obj_del(network_label_);
@@ -61,7 +90,96 @@ Display::~Display() {
     }
 }
 
+void Display::AttachUpdateQueue() {
+    DisplayLockGuard lock(this);
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto display = static_cast<Display*>(lv_event_get_user_data(e));
+        display->ApplyPendingUpdates();
+    }, LV_EVENT_REFR_START, this);
+    update_queue_.SetCallbacks([this]() {
+        // Already armed (ESP_ERR_INVALID_STATE) means the pending intents will be picked up anyway
+        esp_timer_start_once(update_timer_, 0);
+    }, [this]() {
+        DisplayLockGuard lock(this);
+        ApplyPendingUpdates();
+    });
+    stat_update_start_time_ = esp_timer_get_time();
+    update_queue_attached_ = true;
+}
+
+void Display::ApplyPendingUpdates() {
+    auto updates = update_queue_.Take();
+    if (updates.since_us == 0) {
+        return;
+    }
+
+    // 状态和通知共用状态栏位置，按提交顺序应用
+    bool status_first = updates.status_sequence < updates.notification_sequence;
+    if (status_first && updates.status_sequence != 0) {
+        ApplyStatus(updates.status.c_str());
+    }
+    if (updates.notification_sequence != 0) {
+        ApplyNotification(updates.notification.c_str(), updates.notification_duration_ms);
+    }
+    if (!status_first && updates.status_sequence != 0) {
+        ApplyStatus(updates.status.c_str());
+    }
+    // 表情（或图标）与聊天区的图片共用控件，按提交顺序穿插应用
+    bool emotion_applied = updates.emotion_sequence == 0;
+    for (auto& update : updates.chat_messages) {
+        if (!emotion_applied && updates.emotion_sequence < update.sequence) {
+            ApplyEmotionUpdate(updates);
+            emotion_applied = true;
+        }
+        switch (update.type) {
+            case DisplayUpdateQueue::kChatUpdateMessage:
+                ApplyChatMessage(update.role.c_str(), update.content.c_str());
+                break;
+            case DisplayUpdateQueue::kChatUpdateImage:
+                ApplyPreviewImage(update.image);
+                break;
+            case DisplayUpdateQueue::kChatUpdateClear:
+                ApplyClearChat();
+                break;
+        }
+    }
+    if (!emotion_applied) {
+        ApplyEmotionUpdate(updates);
+    }
+    if (updates.status_bar_pending) {
+        ApplyStatusBar(updates);
+    }
+
+    int64_t now = esp_timer_get_time();
+    stat_updates_++;
+    stat_update_latency_max_ = std::max(stat_update_latency_max_, now - updates.since_us);
+    if (now - stat_update_start_time_ >= 10 * 1000 * 1000) {
+        ESP_LOGI(TAG, "Updates: %lu batches, max latency %lu ms", stat_updates_,
+            (uint32_t)(stat_update_latency_max_ / 1000));
+        stat_updates_ = 0;
+        stat_update_latency_max_ = 0;
+        stat_update_start_time_ = now;
+    }
+}
+
+void Display::ApplyEmotionUpdate(const DisplayUpdateQueue::Updates& updates) {
+    if (updates.emotion_is_icon) {
+        ApplyIcon(updates.emotion.c_str());
+    } else {
+        ApplyEmotion(updates.emotion.c_str());
+    }
+}
+
 void Display::SetStatus(const char* status) {
+    last_status_update_time_ = std::chrono::system_clock::now();
+    if (!update_queue_attached_) {
+        ApplyStatus(status);
+        return;
+    }
+    update_queue_.SetStatus(status);
+}
+
+void Display::ApplyStatus(const char* status) {
     DisplayLockGuard lock(this);
     if (status_label_ == nullptr) {
         return;
@@ -69,8 +187,6 @@ void Display::SetStatus(const char* status) {
     lv_label_set_text(status_label_, status);
     lv_obj_remove_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
-
-    last_status_update_time_ = std::chrono::system_clock::now();
 }
 
 void Display::ShowNotification(const std::string &notification, int duration_ms) {
@@ -78,6 +194,14 @@ void Display::ShowNotification(const std::string &notification, int duration_ms)
 }
 
 void Display::ShowNotification(const char* notification, int duration_ms) {
+    if (!update_queue_attached_) {
+        ApplyNotification(notification, duration_ms);
+        return;
+    }
+    update_queue_.ShowNotification(notification, duration_ms);
+}
+
+void Display::ApplyNotification(const char* notification, int duration_ms) {
     DisplayLockGuard lock(this);
     if (notification_label_ == nullptr) {
         return;
@@ -95,21 +219,8 @@ void Display::UpdateStatusBar(bool update_all) {
     auto& board = Board::GetInstance();
     auto codec = board.GetAudioCodec();
 
-    // Update mute icon
-    {
-        DisplayLockGuard lock(this);
-        if (mute_label_ == nullptr) {
-            return;
-        }
-
-        // 如果静音状态改变，则更新图标
-        if (codec->output_volume() == 0 && !muted_) {
-            muted_ = true;
-            lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_XMARK);
-        } else if (codec->output_volume() > 0 && muted_) {
-            muted_ = false;
-            lv_label_set_text(mute_label_, "");
-        }
+    if (mute_label_ == nullptr) {
+        return;
     }
 
     // Update time
@@ -130,13 +241,15 @@ void Display::UpdateStatusBar(bool update_all) {
     }
 
     esp_pm_lock_acquire(pm_lock_);
+    DisplayUpdateQueue::Updates updates;
+    updates.muted = codec->output_volume() == 0;
+
     // 更新电池图标
     int battery_level;
     bool charging, discharging;
-    const char* icon = nullptr;
     if (board.GetBatteryLevel(battery_level, charging, discharging)) {
         if (charging) {
-            icon = FONT_AWESOME_BATTERY_BOLT;
+            updates.battery_icon = FONT_AWESOME_BATTERY_BOLT;
         } else {
             const char* levels[] = {
                 FONT_AWESOME_BATTERY_EMPTY, // 0-19%
@@ -146,26 +259,16 @@ void Display::UpdateStatusBar(bool update_all) {
                 FONT_AWESOME_BATTERY_FULL, // 80-99%
                 FONT_AWESOME_BATTERY_FULL, // 100%
             };
-            icon = levels[battery_level / 20];
-        }
-        DisplayLockGuard lock(this);
-        if (battery_label_ != nullptr && battery_icon_ != icon) {
-            battery_icon_ = icon;
-            lv_label_set_text(battery_label_, battery_icon_);
+            updates.battery_icon = levels[battery_level / 20];
         }
 
         if (low_battery_popup_ != nullptr) {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
-                if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框隐藏，则显示
-                    lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                    app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
-                }
-            } else {
-                // Hide the low battery popup when the battery is not empty
-                if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框显示，则隐藏
-                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                }
+            updates.low_battery = strcmp(updates.battery_icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging;
+            // 低电量提示框从隐藏变为显示时播放提示音
+            if (updates.low_battery && !low_battery_shown_) {
+                app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
             }
+            low_battery_shown_ = updates.low_battery;
         }
     }
 
@@ -182,29 +285,78 @@ void Display::UpdateStatusBar(bool update_all) {
             kDeviceStateActivating,
         };
         if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
-            icon = board.GetNetworkStateIcon();
-            if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
-                DisplayLockGuard lock(this);
-                network_icon_ = icon;
-                lv_label_set_text(network_label_, network_icon_);
-            }
+            updates.network_icon = board.GetNetworkStateIcon();
         }
     }
 
     esp_pm_lock_release(pm_lock_);
+
+    if (!update_queue_attached_) {
+        ApplyStatusBar(updates);
+        return;
+    }
+    update_queue_.SetStatusBar(updates);
+}
+
+void Display::ApplyStatusBar(const DisplayUpdateQueue::Updates& updates) {
+    DisplayLockGuard lock(this);
+    if (mute_label_ == nullptr) {
+        return;
+    }
+
+    // 如果静音状态改变，则更新图标
+    if (updates.muted != muted_) {
+        muted_ = updates.muted;
+        lv_label_set_text(mute_label_, muted_ ? FONT_AWESOME_VOLUME_XMARK : "");
+    }
+
+    if (updates.battery_icon != nullptr) {
+        if (battery_label_ != nullptr && battery_icon_ != updates.battery_icon) {
+            battery_icon_ = updates.battery_icon;
+            lv_label_set_text(battery_label_, battery_icon_);
+        }
+        if (low_battery_popup_ != nullptr) {
+            if (updates.low_battery) {
+                lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+            } else {
+                lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+            }
+        }
+    }
+
+    if (network_label_ != nullptr && updates.network_icon != nullptr && network_icon_ != updates.network_icon) {
+        network_icon_ = updates.network_icon;
+        lv_label_set_text(network_label_, network_icon_);
+    }
 }
 
 
 void Display::SetEmotion(const char* emotion) {
+    if (!update_queue_attached_) {
+        ApplyEmotion(emotion);
+        return;
+    }
+    update_queue_.SetEmotion(emotion, false);
+}
+
+void Display::ApplyEmotion(const char* emotion) {
     const char* utf8 = font_awesome_get_utf8(emotion);
     if (utf8 != nullptr) {
-        SetIcon(utf8);
+        ApplyIcon(utf8);
     } else {
-        SetIcon(FONT_AWESOME_NEUTRAL);
+        ApplyIcon(FONT_AWESOME_NEUTRAL);
     }
 }
 
 void Display::SetIcon(const char* icon) {
+    if (!update_queue_attached_) {
+        ApplyIcon(icon);
+        return;
+    }
+    update_queue_.SetEmotion(icon, true);
+}
+
+void Display::ApplyIcon(const char* icon) {
     DisplayLockGuard lock(this);
     if (emotion_label_ == nullptr) {
         return;
@@ -212,11 +364,73 @@ void Display::SetIcon(const char* icon) {
     lv_label_set_text(emotion_label_, icon);
 }
 
+// Heap copy of the descriptor and pixels, freed when the last reference is dropped
+static std::shared_ptr<const lv_img_dsc_t> CopyImage(const lv_img_dsc_t* image) {
+    auto copy = (lv_img_dsc_t*)heap_caps_malloc(sizeof(lv_img_dsc_t), MALLOC_CAP_8BIT);
+    if (copy == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for image descriptor");
+        return nullptr;
+    }
+    *copy = *image;
+    auto data = (uint8_t*)heap_caps_malloc(image->data_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (data == nullptr) {
+        // Fallback to internal RAM if SPIRAM allocation fails
+        data = (uint8_t*)heap_caps_malloc(image->data_size, MALLOC_CAP_8BIT);
+    }
+    if (data == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for image data (size: %lu bytes)", image->data_size);
+        heap_caps_free(copy);
+        return nullptr;
+    }
+    memcpy(data, image->data, image->data_size);
+    copy->data = data;
+    return std::shared_ptr<const lv_img_dsc_t>(copy, [](const lv_img_dsc_t* image) {
+        heap_caps_free((void*)image->data);
+        heap_caps_free((void*)image);
+    });
+}
+
+// 图片在调用方线程上立即复制，摄像头每次拍照都会复用同一块预览缓冲区
 void Display::SetPreviewImage(const lv_img_dsc_t* image) {
-    // Do nothing
+    std::shared_ptr<const lv_img_dsc_t> copy;
+    if (image != nullptr) {
+        copy = CopyImage(image);
+        if (copy == nullptr) {
+            return;
+        }
+    }
+    if (!update_queue_attached_) {
+        ApplyPreviewImage(copy);
+        return;
+    }
+    update_queue_.PushChat(DisplayUpdateQueue::kChatUpdateImage, "", "", copy);
 }
 
 void Display::SetChatMessage(const char* role, const char* content) {
+    if (!update_queue_attached_) {
+        ApplyChatMessage(role, content);
+        return;
+    }
+    update_queue_.PushChat(DisplayUpdateQueue::kChatUpdateMessage, role, content);
+}
+
+void Display::ClearChatMessages() {
+    if (!update_queue_attached_) {
+        ApplyClearChat();
+        return;
+    }
+    update_queue_.PushChat(DisplayUpdateQueue::kChatUpdateClear, "", "");
+}
+
+void Display::ApplyClearChat() {
+    DisplayLockGuard lock(this);
+    if (chat_message_label_ == nullptr) {
+        return;
+    }
+    lv_label_set_text(chat_message_label_, "");
+}
+
+void Display::ApplyChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (chat_message_label_ == nullptr) {
         return;
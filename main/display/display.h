@@ -8,6 +8,9 @@
 
 #include <string>
 #include <chrono>
+#include <memory>
+
+#include "display_update_queue.h"
 
 struct DisplayFonts {
     const lv_font_t* text_font = nullptr;
@@ -20,11 +23,15 @@ public:
     Display();
     virtual ~Display();
 
+    // 状态、通知、表情、图标、图片、聊天消息和状态栏的更新只记录意图并立即返回，
+    // 在下一帧刷新开始时或由唤醒定时器统一应用，调用方不会阻塞在显示锁上
     virtual void SetStatus(const char* status);
     virtual void ShowNotification(const char* notification, int duration_ms = 3000);
     virtual void ShowNotification(const std::string &notification, int duration_ms = 3000);
     virtual void SetEmotion(const char* emotion);
     virtual void SetChatMessage(const char* role, const char* content);
+    // Remove every chat message, the next message starts a new bubble
+    virtual void ClearChatMessages();
     virtual void SetIcon(const char* icon);
     virtual void SetPreviewImage(const lv_img_dsc_t* image);
     virtual void SetTheme(const std::string& theme_name);
@@ -60,9 +67,37 @@ protected:
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
 
+    // Called with the display lock held (or directly when there is no LVGL display)
+    virtual void ApplyStatus(const char* status);
+    virtual void ApplyNotification(const char* notification, int duration_ms);
+    virtual void ApplyEmotion(const char* emotion);
+    virtual void ApplyIcon(const char* icon);
+    // `image` is a private copy of the caller's image, keep a reference for as long as it is shown
+    virtual void ApplyPreviewImage(std::shared_ptr<const lv_img_dsc_t> image) {}
+    virtual void ApplyChatMessage(const char* role, const char* content);
+    virtual void ApplyClearChat();
+    // Subclasses call this once display_ has been created
+    void AttachUpdateQueue();
+
     friend class DisplayLockGuard;
+    friend class DisplayBenchmark;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
+
+private:
+    DisplayUpdateQueue update_queue_;
+    bool update_queue_attached_ = false;
+    esp_timer_handle_t update_timer_ = nullptr;
+
+    // Queue latency statistics, logged periodically
+    uint32_t stat_updates_ = 0;
+    int64_t stat_update_latency_max_ = 0;
+    int64_t stat_update_start_time_ = 0;
+    bool low_battery_shown_ = false;
+
+    void ApplyPendingUpdates();
+    void ApplyEmotionUpdate(const DisplayUpdateQueue::Updates& updates);
+    void ApplyStatusBar(const DisplayUpdateQueue::Updates& updates);
 };
 
 
@@ -0,0 +1,263 @@
+#include "display_benchmark.h"
+#include "glyph_cache.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <string>
+#include <mutex>
+#include <algorithm>
+
+#define TAG "DisplayBenchmark"
+
+DisplayBenchmark::DisplayBenchmark(Display* display) : display_(display) {
+#if CONFIG_USE_DISPLAY_BENCHMARK
+    if (display_->display_ == nullptr) {
+        return;
+    }
+    DisplayLockGuard lock(display_);
+    lv_display_add_event_cb(display_->display_, OnRenderStart, LV_EVENT_RENDER_START, this);
+    lv_display_add_event_cb(display_->display_, OnRenderReady, LV_EVENT_RENDER_READY, this);
+    lv_display_add_event_cb(display_->display_, OnInvalidateArea, LV_EVENT_INVALIDATE_AREA, this);
+#endif
+}
+
+DisplayBenchmark::~DisplayBenchmark() {
+#if CONFIG_USE_DISPLAY_BENCHMARK
+    if (display_->display_ == nullptr) {
+        return;
+    }
+    DisplayLockGuard lock(display_);
+    lv_display_remove_event_cb_with_user_data(display_->display_, OnRenderStart, this);
+    lv_display_remove_event_cb_with_user_data(display_->display_, OnRenderReady, this);
+    lv_display_remove_event_cb_with_user_data(display_->display_, OnInvalidateArea, this);
+#endif
+}
+
+void DisplayBenchmark::OnRenderStart(lv_event_t* e) {
+    auto self = static_cast<DisplayBenchmark*>(lv_event_get_user_data(e));
+    self->stats_.render_start_us = esp_timer_get_time();
+}
+
+void DisplayBenchmark::OnRenderReady(lv_event_t* e) {
+    auto self = static_cast<DisplayBenchmark*>(lv_event_get_user_data(e));
+    int64_t render_time = esp_timer_get_time() - self->stats_.render_start_us;
+    self->stats_.frames++;
+    self->stats_.render_time_us += render_time;
+    if (render_time > self->stats_.max_render_time_us) {
+        self->stats_.max_render_time_us = render_time;
+    }
+    self->stats_.min_free_heap = std::min(self->stats_.min_free_heap, heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+}
+
+void DisplayBenchmark::OnInvalidateArea(lv_event_t* e) {
+    auto self = static_cast<DisplayBenchmark*>(lv_event_get_user_data(e));
+    auto area = static_cast<const lv_area_t*>(lv_event_get_param(e));
+    self->stats_.invalidated_pixels += lv_area_get_size(area);
+}
+
+void DisplayBenchmark::Run() {
+#if CONFIG_USE_DISPLAY_BENCHMARK
+    if (display_->display_ == nullptr) {
+        ESP_LOGW(TAG, "No LVGL display, skipping benchmark");
+        return;
+    }
+    ESP_LOGI(TAG, "Running UI benchmark on %dx%d display", display_->width(), display_->height());
+    std::string theme = display_->GetTheme();
+
+    RunChatScroll();
+    RunLongSentence();
+    RunThemeSwitch();
+    RunEmotionLoop();
+    RunNotifications();
+    RunQueueLatency();
+
+    display_->SetTheme(theme);
+    display_->ClearChatMessages();
+    display_->SetEmotion("neutral");
+#endif
+}
+
+// Wait until queued updates are applied, animations have finished and the last frame is on the panel
+void DisplayBenchmark::Settle() {
+    WaitForPendingUpdates();
+    for (int i = 0; i < 200; i++) {
+        {
+            DisplayLockGuard lock(display_);
+            if (lv_anim_count_running() == 0) {
+                break;
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    DisplayLockGuard lock(display_);
+    lv_refr_now(display_->display_);
+}
+
+void DisplayBenchmark::ResetStats() {
+    Settle();
+    DisplayLockGuard lock(display_);
+    stats_ = FrameStats();
+    stats_.start_free_heap = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+void DisplayBenchmark::Report(const char* scenario) {
+    Settle();
+    FrameStats stats;
+    {
+        DisplayLockGuard lock(display_);
+        stats = stats_;
+    }
+    uint32_t frames = stats.frames > 0 ? stats.frames : 1;
+    ESP_LOGI(TAG, "%s: %lu frames, avg %lu us, max %lu us, %lu px invalidated/frame",
+        scenario, stats.frames, (uint32_t)(stats.render_time_us / frames), (uint32_t)stats.max_render_time_us,
+        (uint32_t)(stats.invalidated_pixels / frames));
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_BUILTIN
+    lv_mem_monitor_t monitor;
+    lv_mem_monitor(&monitor);
+    ESP_LOGI(TAG, "%s: LVGL heap peak %lu bytes", scenario, (uint32_t)monitor.max_used);
+#else
+    // LVGL allocates from the system heap (CONFIG_LV_USE_CLIB_MALLOC), so this is the growth of the
+    // whole heap sampled at each rendered frame. Other tasks contribute to it as well.
+    size_t min_free = std::min(stats.min_free_heap, stats.start_free_heap);
+    ESP_LOGI(TAG, "%s: system heap growth while rendering %lu bytes (not LVGL only)", scenario,
+        (uint32_t)(stats.start_free_heap - min_free));
+#endif
+}
+
+void DisplayBenchmark::RunChatScroll() {
+    display_->ClearChatMessages();
+    ResetStats();
+    for (int i = 0; i < 40; i++) {
+        std::string message = "Benchmark message " + std::to_string(i) + ", long enough to wrap onto a second line.";
+        display_->SetChatMessage(i % 2 == 0 ? "user" : "assistant", message.c_str());
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    Report("chat scroll");
+}
+
+// 200 字的中文长句，先清空字形缓存测冷启动，再在新气泡中重复一次测缓存命中后的渲染时间
+// Device only for now: the host harness has no LVGL build to render into, GlyphCache needs
+// one before this scenario can run in tests/host
+void DisplayBenchmark::RunLongSentence() {
+    std::string sentence;
+    while (sentence.size() < 200 * 3) {
+        sentence += "今天的天气很好，我们一起去公园散步吧。你想听什么故事？我可以给你讲一个关于小猫和月亮的故事。";
+    }
+    sentence.resize(200 * 3);
+
+    auto& glyph_cache = GlyphCache::GetInstance();
+    const char* const scenarios[] = { "long sentence (cold)", "long sentence (warm)" };
+    for (int i = 0; i < 2; i++) {
+        // 每轮都从空白聊天区新建气泡，否则助手消息会合并进上一轮的气泡；
+        // 等清屏刷新完成后再计时，避免把删除气泡的重绘算进本轮
+        display_->ClearChatMessages();
+        Settle();
+        if (i == 0) {
+            glyph_cache.Clear();
+        }
+        ResetStats();
+        auto before = glyph_cache.GetStats();
+        display_->SetChatMessage("assistant", sentence.c_str());
+        Report(scenarios[i]);
+        auto after = glyph_cache.GetStats();
+        ESP_LOGI(TAG, "%s: glyph cache %lu hits, %lu misses", scenarios[i],
+            after.hits - before.hits, after.misses - before.misses);
+    }
+}
+
+void DisplayBenchmark::RunThemeSwitch() {
+    // Same ten bubbles on screen every run, so the restyle cost is comparable
+    display_->ClearChatMessages();
+    for (int i = 0; i < 10; i++) {
+        display_->SetChatMessage(i % 2 == 0 ? "user" : "assistant", "Benchmark theme message");
+    }
+    ResetStats();
+    for (int i = 0; i < 10; i++) {
+        display_->SetTheme(i % 2 == 0 ? "dark" : "light");
+        vTaskDelay(pdMS_TO_TICKS(200));
+    }
+    Report("theme switch");
+}
+
+void DisplayBenchmark::RunEmotionLoop() {
+    static const char* const emotions[] = {
+        "neutral", "happy", "laughing", "sad", "angry", "surprised", "thinking", "sleepy",
+    };
+    display_->ClearChatMessages();
+    ResetStats();
+    for (int i = 0; i < 40; i++) {
+        display_->SetEmotion(emotions[i % (sizeof(emotions) / sizeof(emotions[0]))]);
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    Report("emotion loop");
+}
+
+void DisplayBenchmark::RunNotifications() {
+    display_->ClearChatMessages();
+    ResetStats();
+    for (int i = 0; i < 10; i++) {
+        display_->ShowNotification("Benchmark notification " + std::to_string(i), 250);
+        vTaskDelay(pdMS_TO_TICKS(300));
+    }
+    Report("notifications");
+}
+
+// Time until the display update queue is empty, in microseconds
+int64_t DisplayBenchmark::WaitForPendingUpdates() {
+    int64_t start = esp_timer_get_time();
+    while (true) {
+        if (display_->update_queue_.empty()) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+    return esp_timer_get_time() - start;
+}
+
+// 调用方延迟：用一个任务持有显示锁 300ms 模拟慢渲染，期间从本任务调用各个更新接口，
+// 记录调用耗时；再测空闲界面上单次更新到被应用的时间
+void DisplayBenchmark::RunQueueLatency() {
+    constexpr int kRenderMs = 300;
+    static volatile bool holding;
+    holding = true;
+    xTaskCreate([](void* arg) {
+        auto display = static_cast<Display*>(arg);
+        {
+            DisplayLockGuard lock(display);
+            vTaskDelay(pdMS_TO_TICKS(kRenderMs));
+        }
+        holding = false;
+        vTaskDelete(NULL);
+    }, "slow_render", 2048, display_, 4, nullptr);
+    vTaskDelay(pdMS_TO_TICKS(10));
+
+    int64_t max_call_us = 0;
+    int calls = 0;
+    while (holding) {
+        int64_t start = esp_timer_get_time();
+        display_->SetStatus(calls % 2 == 0 ? "Benchmark A" : "Benchmark B");
+        display_->SetEmotion(calls % 2 == 0 ? "happy" : "sad");
+        display_->SetChatMessage("assistant", "Benchmark latency message");
+        display_->UpdateStatusBar();
+        max_call_us = std::max(max_call_us, esp_timer_get_time() - start);
+        calls++;
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    int64_t drain_us = WaitForPendingUpdates();
+    ESP_LOGI(TAG, "queue latency: %d call rounds during a %d ms render, max %lu us per round, drained %lu us after the render",
+        calls, kRenderMs, (uint32_t)max_call_us, (uint32_t)drain_us);
+
+    // Idle screen: LVGL has nothing invalidated, the update must still be applied promptly
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    int64_t max_idle_us = 0;
+    for (int i = 0; i < 10; i++) {
+        display_->SetStatus(i % 2 == 0 ? "Benchmark idle A" : "Benchmark idle B");
+        max_idle_us = std::max(max_idle_us, WaitForPendingUpdates());
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+    ESP_LOGI(TAG, "queue latency: idle screen, max %lu us from SetStatus to applied", (uint32_t)max_idle_us);
+}
@@ -0,0 +1,51 @@
+#ifndef DISPLAY_BENCHMARK_H
+#define DISPLAY_BENCHMARK_H
+
+#include "display.h"
+
+#include <cstdint>
+#include <cstddef>
+
+// Replays scripted UI sessions on the real panel and logs per-scenario render
+// time, invalidated area and memory usage. Enabled by CONFIG_USE_DISPLAY_BENCHMARK.
+// Runs on the device only. The offscreen host backend (128x64 mono, 240x240 and
+// 320x240 RGB565), the host run of these scenarios and the golden-image check are
+// not implemented yet: tests/host has no LVGL build, LVGL only comes in through the
+// ESP-IDF component manager.
+class DisplayBenchmark {
+public:
+    DisplayBenchmark(Display* display);
+    ~DisplayBenchmark();
+
+    void Run();
+
+private:
+    struct FrameStats {
+        uint32_t frames = 0;
+        int64_t render_time_us = 0;
+        int64_t max_render_time_us = 0;
+        uint64_t invalidated_pixels = 0;
+        int64_t render_start_us = 0;
+        size_t start_free_heap = 0;
+        size_t min_free_heap = SIZE_MAX;
+    };
+
+    Display* display_;
+    FrameStats stats_;
+
+    static void OnRenderStart(lv_event_t* e);
+    static void OnRenderReady(lv_event_t* e);
+    static void OnInvalidateArea(lv_event_t* e);
+    void Settle();
+    void ResetStats();
+    void Report(const char* scenario);
+    void RunChatScroll();
+    void RunLongSentence();
+    void RunThemeSwitch();
+    void RunEmotionLoop();
+    void RunNotifications();
+    void RunQueueLatency();
+    int64_t WaitForPendingUpdates();
+};
+
+#endif // DISPLAY_BENCHMARK_H
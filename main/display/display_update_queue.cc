@@ -0,0 +1,91 @@
+#include "display_update_queue.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "DisplayUpdateQueue"
+
+void DisplayUpdateQueue::SetCallbacks(std::function<void()> wake, std::function<void()> apply_backlog) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_ = wake;
+    apply_backlog_ = apply_backlog;
+}
+
+void DisplayUpdateQueue::Queued() {
+    if (pending_.since_us == 0) {
+        pending_.since_us = esp_timer_get_time();
+    }
+    if (wake_) {
+        wake_();
+    }
+}
+
+void DisplayUpdateQueue::SetStatus(const char* status) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.status = status;
+    pending_.status_sequence = ++sequence_;
+    Queued();
+}
+
+void DisplayUpdateQueue::ShowNotification(const char* notification, int duration_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.notification = notification;
+    pending_.notification_duration_ms = duration_ms;
+    pending_.notification_sequence = ++sequence_;
+    Queued();
+}
+
+void DisplayUpdateQueue::SetEmotion(const char* emotion, bool is_icon) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.emotion = emotion;
+    pending_.emotion_is_icon = is_icon;
+    pending_.emotion_sequence = ++sequence_;
+    Queued();
+}
+
+void DisplayUpdateQueue::PushChat(ChatUpdateType type, const char* role, const char* content,
+    std::shared_ptr<const lv_img_dsc_t> image) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (type == kChatUpdateClear) {
+        // Nothing queued before a clear would stay visible
+        pending_.chat_messages.clear();
+    }
+    // The renderer is behind: apply the backlog here instead of dropping transcript entries.
+    // The display lock must be taken without mutex_, the LVGL task takes them the other way round.
+    while (pending_.chat_messages.size() >= max_chat_updates_ && apply_backlog_) {
+        size_t backlog = pending_.chat_messages.size();
+        backlog_applies_++;
+        lock.unlock();
+        ESP_LOGW(TAG, "%u chat updates pending, applying them on the caller", (unsigned)backlog);
+        apply_backlog_();
+        lock.lock();
+    }
+    pending_.chat_messages.push_back(ChatUpdate{++sequence_, type, role, content, std::move(image)});
+    Queued();
+}
+
+void DisplayUpdateQueue::SetStatusBar(const Updates& status_bar) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.status_bar_pending = true;
+    pending_.muted = status_bar.muted;
+    if (status_bar.battery_icon != nullptr) {
+        pending_.battery_icon = status_bar.battery_icon;
+        pending_.low_battery = status_bar.low_battery;
+    }
+    if (status_bar.network_icon != nullptr) {
+        pending_.network_icon = status_bar.network_icon;
+    }
+    Queued();
+}
+
+DisplayUpdateQueue::Updates DisplayUpdateQueue::Take() {
+    Updates updates;
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(updates, pending_);
+    return updates;
+}
+
+bool DisplayUpdateQueue::empty() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.since_us == 0;
+}
@@ -0,0 +1,85 @@
+#ifndef DISPLAY_UPDATE_QUEUE_H
+#define DISPLAY_UPDATE_QUEUE_H
+
+#include <lvgl.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#define DISPLAY_MAX_PENDING_CHAT_UPDATES 8
+
+// 显示意图队列：调用方只记录意图并立即返回，由 LVGL 任务在刷新时统一取出应用。
+// 状态、通知、表情（或图标）和状态栏只保留最新值；聊天消息、图片和清屏按顺序保留，
+// 聊天记录样式会显示全部历史，所以积压满时不丢弃，而是由调用方先应用积压再入队
+class DisplayUpdateQueue {
+public:
+    enum ChatUpdateType {
+        kChatUpdateMessage,
+        kChatUpdateImage,
+        kChatUpdateClear,
+    };
+    struct ChatUpdate {
+        uint32_t sequence;
+        ChatUpdateType type;
+        std::string role;
+        std::string content;
+        std::shared_ptr<const lv_img_dsc_t> image;  // Owned copy, the caller's buffer may be reused
+    };
+
+    // Sequence numbers keep the submission order between slots that touch the same widgets
+    struct Updates {
+        uint32_t status_sequence = 0;  // 0 = nothing pending
+        std::string status;
+        uint32_t notification_sequence = 0;
+        std::string notification;
+        int notification_duration_ms = 0;
+        uint32_t emotion_sequence = 0;
+        std::string emotion;
+        bool emotion_is_icon = false;
+        std::deque<ChatUpdate> chat_messages;
+        int64_t since_us = 0;  // When the oldest pending intent was queued, 0 = empty
+        bool status_bar_pending = false;
+        bool muted = false;
+        const char* battery_icon = nullptr;
+        bool low_battery = false;
+        const char* network_icon = nullptr;
+    };
+
+    explicit DisplayUpdateQueue(size_t max_chat_updates = DISPLAY_MAX_PENDING_CHAT_UPDATES)
+        : max_chat_updates_(max_chat_updates) {}
+
+    // `wake` arms a pass that calls Take(); `apply_backlog` applies everything pending right away
+    // (holding the display lock) and is called on the caller's thread when the chat backlog is full
+    void SetCallbacks(std::function<void()> wake, std::function<void()> apply_backlog);
+
+    void SetStatus(const char* status);
+    void ShowNotification(const char* notification, int duration_ms);
+    void SetEmotion(const char* emotion, bool is_icon);
+    void PushChat(ChatUpdateType type, const char* role, const char* content,
+        std::shared_ptr<const lv_img_dsc_t> image = nullptr);
+    // Muted, battery and network fields of `status_bar`; null icons leave the pending ones alone
+    void SetStatusBar(const Updates& status_bar);
+
+    // Everything pending, in one batch
+    Updates Take();
+    bool empty();
+    uint32_t backlog_applies() const { return backlog_applies_; }
+
+private:
+    std::mutex mutex_;
+    Updates pending_;
+    uint32_t sequence_ = 0;
+    size_t max_chat_updates_;
+    uint32_t backlog_applies_ = 0;
+    std::function<void()> wake_;
+    std::function<void()> apply_backlog_;
+
+    // Called with mutex_ held after an intent is queued
+    void Queued();
+};
+
+#endif // DISPLAY_UPDATE_QUEUE_H
@@ -0,0 +1,201 @@
+#include "glyph_cache.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "GlyphCache"
+
+#define GLYPH_CACHE_ENTRY_OVERHEAD 48   // List node and index slot, counted against the capacity
+#define GLYPH_CACHE_STATS_INTERVAL_US (10 * 1000 * 1000)
+
+// 预热用的高频字符：ASCII 可见字符和最常用的汉字
+static const char kPrewarmText[] =
+    " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~"
+    "，。！？、：；“”‘’（）…"
+    "的一是不了人我在有他这中大来上个国到说们为子和你地出道也时年得就那要下以生会自着去之过家学对可她里后小么心多"
+    "天而能好都然没日于起还发成事只作当想看文无开手十用主行方又如前所本见经头面公同三已老从动两长知民样现分将外但"
+    "身些与高意进把法此实回二理美点月明其种声全工己话儿者向情部正名定女问力机给等几很业最间新什打便位因重被走电四"
+    "第门相次东政海口使教西再平真听世气信北少关并内加化由却代军产入先山五太水万市眼体别处总才场师书比住员九笑性通"
+    "目华报立马命张活难神数件安表原车白应路期叫死常提感金何更反合放做系计或司利受光王果亲界及今京务制解各任至清物"
+    "吗吧呢啊哦嗯谢请帮";
+
+GlyphCache::GlyphCache() {
+    capacity_ = (size_t)CONFIG_GLYPH_CACHE_SIZE_KB * 1024;
+}
+
+GlyphCache::~GlyphCache() {
+    Clear();
+}
+
+const lv_font_t* GlyphCache::Wrap(const lv_font_t* font) {
+    // 只缓存 lv_font_conv 生成的内置字体，其他字体（如 TinyTTF）自带缓存
+    if (capacity_ == 0 || font == nullptr || font->get_glyph_bitmap != lv_font_get_bitmap_fmt_txt) {
+        return font;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& wrapped : fonts_) {
+        if (wrapped->original == font || &wrapped->font == font) {
+            return &wrapped->font;
+        }
+    }
+
+    auto wrapped = std::make_unique<WrappedFont>();
+    wrapped->original = font;
+    wrapped->font = *font;
+    wrapped->font.get_glyph_bitmap = GetGlyphBitmap;
+    wrapped->font.user_data = wrapped.get();
+    wrapped->id = fonts_.size();
+    fonts_.push_back(std::move(wrapped));
+    ESP_LOGI(TAG, "Caching glyphs of font %p, line height %d, capacity %u KB", font, font->line_height,
+        (unsigned)(capacity_ / 1024));
+    return &fonts_.back()->font;
+}
+
+// 原字体的 get_glyph_dsc 会将 resolved_font 设为包装字体，因此位图请求会先到这里
+const void* GlyphCache::GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    auto wrapped = static_cast<const WrappedFont*>(dsc->resolved_font->user_data);
+    auto& cache = GetInstance();
+    if (draw_buf == nullptr) {
+        return wrapped->original->get_glyph_bitmap(dsc, draw_buf);
+    }
+
+    uint64_t key = ((uint64_t)wrapped->id << 32) | dsc->gid.index;
+    if (cache.Lookup(key, draw_buf)) {
+        return draw_buf;
+    }
+
+    auto bitmap = wrapped->original->get_glyph_bitmap(dsc, draw_buf);
+    if (bitmap == draw_buf) {
+        cache.Insert(key, draw_buf, dsc->box_h);
+    }
+    return bitmap;
+}
+
+bool GlyphCache::Lookup(uint64_t key, lv_draw_buf_t* draw_buf) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            stats_.misses++;
+            return false;
+        }
+        stats_.hits++;
+        lru_.splice(lru_.begin(), lru_, it->second);
+
+        auto& entry = *it->second;
+        uint32_t stride = draw_buf->header.stride;
+        if (stride == entry.stride) {
+            memcpy(draw_buf->data, entry.data, entry.stride * entry.height);
+        } else {
+            uint32_t row_size = std::min(stride, entry.stride);
+            for (uint32_t y = 0; y < entry.height; y++) {
+                memcpy(draw_buf->data + y * stride, entry.data + y * entry.stride, row_size);
+            }
+        }
+    }
+    lv_draw_buf_flush_cache(draw_buf, nullptr);
+    return true;
+}
+
+void GlyphCache::Insert(uint64_t key, const lv_draw_buf_t* draw_buf, uint32_t height) {
+    uint32_t stride = draw_buf->header.stride;
+    size_t size = (size_t)stride * height;
+    // 超大字形会挤掉大量常用字形，不缓存
+    if (size == 0 || size > capacity_ / 8) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index_.find(key) != index_.end()) {
+        return;
+    }
+    Evict(size + GLYPH_CACHE_ENTRY_OVERHEAD);
+
+    auto data = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (data == nullptr) {
+        data = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+        if (data == nullptr) {
+            return;
+        }
+    }
+    memcpy(data, draw_buf->data, size);
+    lru_.push_front(Entry{key, stride, height, data});
+    index_[key] = lru_.begin();
+    stats_.entries++;
+    stats_.bytes += size + GLYPH_CACHE_ENTRY_OVERHEAD;
+
+    auto now = esp_timer_get_time();
+    if (now - last_log_time_ >= GLYPH_CACHE_STATS_INTERVAL_US) {
+        last_log_time_ = now;
+        uint32_t total = stats_.hits + stats_.misses;
+        ESP_LOGI(TAG, "Glyph cache: %lu hits, %lu misses (%lu%% hit), %lu evictions, %lu glyphs, %u bytes",
+            stats_.hits, stats_.misses, total > 0 ? stats_.hits * 100 / total : 0,
+            stats_.evictions, stats_.entries, (unsigned)stats_.bytes);
+    }
+}
+
+void GlyphCache::Evict(size_t bytes) {
+    while (!lru_.empty() && stats_.bytes + bytes > capacity_) {
+        auto& entry = lru_.back();
+        stats_.bytes -= (size_t)entry.stride * entry.height + GLYPH_CACHE_ENTRY_OVERHEAD;
+        stats_.entries--;
+        stats_.evictions++;
+        index_.erase(entry.key);
+        heap_caps_free(entry.data);
+        lru_.pop_back();
+    }
+}
+
+void GlyphCache::Prewarm(const lv_font_t* font) {
+    if (font == nullptr || font->get_glyph_bitmap != GetGlyphBitmap) {
+        return;
+    }
+
+    auto start_time = esp_timer_get_time();
+    int glyphs = 0;
+    uint32_t i = 0;
+    while (kPrewarmText[i] != '\0') {
+        uint32_t letter = lv_text_encoded_next(kPrewarmText, &i);
+        lv_font_glyph_dsc_t dsc;
+        if (!lv_font_get_glyph_dsc(font, &dsc, letter, 0) || dsc.resolved_font != font) {
+            continue;
+        }
+        if (dsc.format < LV_FONT_GLYPH_FORMAT_A1 || dsc.format > LV_FONT_GLYPH_FORMAT_A8 ||
+            dsc.box_w == 0 || dsc.box_h == 0) {
+            continue;
+        }
+        // 与标签绘制使用相同的 A8 缓冲布局，缓存的数据可以直接复用
+        lv_draw_buf_t* draw_buf = lv_draw_buf_create(dsc.box_w, dsc.box_h, LV_COLOR_FORMAT_A8, LV_STRIDE_AUTO);
+        if (draw_buf == nullptr) {
+            break;
+        }
+        lv_font_get_glyph_bitmap(&dsc, draw_buf);
+        lv_draw_buf_destroy(draw_buf);
+        glyphs++;
+    }
+
+    auto stats = GetStats();
+    ESP_LOGI(TAG, "Prewarmed %d glyphs in %lld ms, cache holds %lu glyphs, %u bytes", glyphs,
+        (esp_timer_get_time() - start_time) / 1000, stats.entries, (unsigned)stats.bytes);
+}
+
+void GlyphCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : lru_) {
+        heap_caps_free(entry.data);
+    }
+    lru_.clear();
+    index_.clear();
+    stats_.entries = 0;
+    stats_.bytes = 0;
+}
+
+GlyphCache::Stats GlyphCache::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
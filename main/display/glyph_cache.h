@@ -0,0 +1,69 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include <lvgl.h>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// 解码后的字形位图 LRU 缓存，数据存放在 PSRAM 中。
+// Wrap() 返回原字体的包装副本，渲染时先查缓存，未命中才调用原字体解压，
+// 长句在气泡重排时不再重复解码相同的字形。大小由 CONFIG_GLYPH_CACHE_SIZE_KB 按板配置
+class GlyphCache {
+public:
+    struct Stats {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        uint32_t evictions = 0;
+        uint32_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    static GlyphCache& GetInstance() {
+        static GlyphCache instance;
+        return instance;
+    }
+
+    // Returns a font that renders through the cache, or the font itself if it cannot be cached
+    const lv_font_t* Wrap(const lv_font_t* font);
+    // Decode the most frequent glyphs of a wrapped font ahead of time, must hold the LVGL lock
+    void Prewarm(const lv_font_t* font);
+    void Clear();
+    Stats GetStats();
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t stride;
+        uint32_t height;
+        uint8_t* data;
+    };
+
+    struct WrappedFont {
+        const lv_font_t* original;
+        lv_font_t font;
+        uint32_t id;
+    };
+
+    std::mutex mutex_;
+    size_t capacity_ = 0;
+    std::vector<std::unique_ptr<WrappedFont>> fonts_;
+    std::list<Entry> lru_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+    Stats stats_;
+    int64_t last_log_time_ = 0;
+
+    GlyphCache();
+    ~GlyphCache();
+
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+    bool Lookup(uint64_t key, lv_draw_buf_t* draw_buf);
+    void Insert(uint64_t key, const lv_draw_buf_t* draw_buf, uint32_t height);
+    void Evict(size_t bytes);
+};
+
+#endif // GLYPH_CACHE_H
@@ -1,4 +1,5 @@
 #include "lcd_display.h"
+#include "glyph_cache.h"
 
 #include <vector>
 #include <algorithm>
@@ -71,6 +72,7 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
     : panel_io_(panel_io), panel_(panel), fonts_(fonts) {
     width_ = width;
     height_ = height;
+    fonts_.text_font = GlyphCache::GetInstance().Wrap(fonts.text_font);
 
     // Load theme from settings
     Settings settings("display", false);
@@ -86,7 +88,25 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
 
 SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                            int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
-                           DisplayFonts fonts)
+                           DisplayFonts fonts, LcdBufferConfig buffer_config)
+    : LcdDisplay(panel_io, panel, fonts, width, height) {
+
+    // draw white
+    std::vector<uint16_t> buffer(width_, 0xFFFF);
+    for (int y = 0; y < height_; y++) {
+        esp_lcd_panel_draw_bitmap(panel_, 0, y, width_, y + 1, buffer.data());
+    }
+
+    // Set the display to on
+    ESP_LOGI(TAG, "Turning display on");
+    ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(panel_, true));
+
+    AddPanelDisplay(offset_x, offset_y, mirror_x, mirror_y, swap_xy, buffer_config);
+}
+
+QspiLcdDisplay::QspiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
+                           int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
+                           DisplayFonts fonts, LcdBufferConfig buffer_config)
     : LcdDisplay(panel_io, panel, fonts, width, height) {
 
     // draw white
@@ -99,6 +119,12 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     ESP_LOGI(TAG, "Turning display on");
     ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(panel_, true));
 
+    AddPanelDisplay(offset_x, offset_y, mirror_x, mirror_y, swap_xy, buffer_config);
+}
+
+// SPI/QSPI面板共用的LVGL初始化，按板级配置选择绘制缓冲策略
+void LcdDisplay::AddPanelDisplay(int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
+                                 LcdBufferConfig buffer_config) {
     ESP_LOGI(TAG, "Initialize LVGL library");
     lv_init();
 
@@ -109,13 +135,21 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     port_cfg.timer_period_ms = 50;  // 增加刷新间隔，减少刷新压力
     lvgl_port_init(&port_cfg);
 
-    ESP_LOGI(TAG, "Adding LCD display");
-    const lvgl_port_display_cfg_t display_cfg = {
+#if !CONFIG_SPIRAM
+    if (buffer_config.mode == kLcdBufferPsram) {
+        ESP_LOGW(TAG, "PSRAM not available, falling back to double strip buffers");
+        buffer_config.mode = kLcdBufferDouble;
+    }
+#endif
+
+    uint32_t strip_size = static_cast<uint32_t>(width_ * buffer_config.lines);
+    uint32_t screen_size = static_cast<uint32_t>(width_ * height_);
+    lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
+        .buffer_size = strip_size,
+        .double_buffer = buffer_config.mode != kLcdBufferSingle,
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -136,7 +170,36 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         },
     };
 
+    switch (buffer_config.mode) {
+        case kLcdBufferPsram:
+            // LVGL renders into PSRAM, the port copies each chunk into an internal DMA buffer
+            display_cfg.buffer_size = screen_size;
+            display_cfg.trans_size = strip_size;
+            display_cfg.flags.buff_dma = 0;
+            display_cfg.flags.buff_spiram = 1;
+            break;
+        case kLcdBufferFullRefresh:
+            display_cfg.buffer_size = screen_size;
+            display_cfg.flags.full_refresh = 1;
+            break;
+        default:
+            break;
+    }
+
+    ESP_LOGI(TAG, "Adding LCD display, buffer mode %d, %lu pixels", buffer_config.mode, display_cfg.buffer_size);
     display_ = lvgl_port_add_disp(&display_cfg);
+    if (display_ == nullptr && buffer_config.mode != kLcdBufferSingle) {
+        // Larger buffers may not fit in DMA capable memory, the single strip always did
+        ESP_LOGW(TAG, "Buffer mode %d failed to allocate (%u bytes DMA free), falling back to a single strip",
+            buffer_config.mode, heap_caps_get_largest_free_block(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL));
+        display_cfg.buffer_size = strip_size;
+        display_cfg.double_buffer = false;
+        display_cfg.trans_size = 0;
+        display_cfg.flags.buff_dma = 1;
+        display_cfg.flags.buff_spiram = 0;
+        display_cfg.flags.full_refresh = 0;
+        display_ = lvgl_port_add_disp(&display_cfg);
+    }
     if (display_ == nullptr) {
         ESP_LOGE(TAG, "Failed to add display");
         return;
@@ -146,9 +209,45 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    AttachUpdateQueue();
+    EnableRenderStats();
     SetupUI();
 }
 
+// 统计帧率和渲染耗时（渲染时间占比近似LVGL任务的CPU占用）
+void LcdDisplay::EnableRenderStats() {
+    DisplayLockGuard lock(this);
+    stat_start_time_ = esp_timer_get_time();
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        self->stat_render_start_ = esp_timer_get_time();
+    }, LV_EVENT_RENDER_START, this);
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        int64_t now = esp_timer_get_time();
+        self->stat_render_time_ += now - self->stat_render_start_;
+        self->stat_frames_++;
+        if (now - self->stat_start_time_ >= 10 * 1000 * 1000) {
+            int64_t elapsed = now - self->stat_start_time_;
+            ESP_LOGI(TAG, "Render: %lu fps, %lu%% busy", (uint32_t)(self->stat_frames_ * 1000000LL / elapsed),
+                (uint32_t)(self->stat_render_time_ * 100 / elapsed));
+            self->stat_frames_ = 0;
+            self->stat_render_time_ = 0;
+            self->stat_start_time_ = now;
+        }
+    }, LV_EVENT_RENDER_READY, this);
+}
+
+// 界面创建完成后，在LVGL任务中预热常用字形，不占用启动时间
+void LcdDisplay::ScheduleGlyphPrewarm() {
+#if CONFIG_GLYPH_CACHE_PREWARM
+    lv_timer_t* timer = lv_timer_create([](lv_timer_t* timer) {
+        GlyphCache::GetInstance().Prewarm(static_cast<const lv_font_t*>(lv_timer_get_user_data(timer)));
+    }, 2000, (void*)fonts_.text_font);
+    lv_timer_set_repeat_count(timer, 1);
+#endif
+}
+
 // RGB LCD实现
 RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                            int width, int height, int offset_x, int offset_y,
@@ -210,6 +309,7 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    AttachUpdateQueue();
     SetupUI();
 }
 
@@ -271,6 +371,7 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    AttachUpdateQueue();
     SetupUI();
 }
 
@@ -352,8 +453,9 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
     lv_obj_set_style_pad_row(content_, 10, 0); // Space between messages
 
-    // We'll create chat messages dynamically in SetChatMessage
+    // Chat messages are placed into a recycled ring of bubbles in ApplyChatMessage
     chat_message_label_ = nullptr;
+    InitializeChatStyles();
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
@@ -417,13 +519,121 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(low_battery_label_, lv_color_white(), 0);
     lv_obj_center(low_battery_label_);
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+
+    ScheduleGlyphPrewarm();
 }
 #if CONFIG_IDF_TARGET_ESP32P4
 #define  MAX_MESSAGES 40
 #else
 #define  MAX_MESSAGES 20
 #endif
-void LcdDisplay::SetChatMessage(const char* role, const char* content) {
+
+enum ChatRole {
+    kChatRoleUser,
+    kChatRoleAssistant,
+    kChatRoleSystem,
+};
+
+static int GetChatRole(const char* role) {
+    if (strcmp(role, "user") == 0) {
+        return kChatRoleUser;
+    } else if (strcmp(role, "system") == 0) {
+        return kChatRoleSystem;
+    }
+    return kChatRoleAssistant;
+}
+
+// 气泡样式按角色共享，切换主题时只需更新样式对象
+void LcdDisplay::InitializeChatStyles() {
+    lv_style_init(&row_style_);
+    lv_style_set_width(&row_style_, LV_HOR_RES);
+    lv_style_set_height(&row_style_, LV_SIZE_CONTENT);
+    lv_style_set_bg_opa(&row_style_, LV_OPA_TRANSP);
+    lv_style_set_border_width(&row_style_, 0);
+    lv_style_set_pad_all(&row_style_, 0);
+
+    lv_style_init(&bubble_style_);
+    lv_style_set_radius(&bubble_style_, 8);
+    lv_style_set_border_width(&bubble_style_, 1);
+    lv_style_set_pad_all(&bubble_style_, 8);
+    lv_style_set_width(&bubble_style_, LV_SIZE_CONTENT);
+    lv_style_set_height(&bubble_style_, LV_SIZE_CONTENT);
+
+    for (int i = 0; i < 3; i++) {
+        lv_style_init(&role_bubble_styles_[i]);
+        lv_style_init(&role_text_styles_[i]);
+    }
+    UpdateChatStyles();
+}
+
+void LcdDisplay::UpdateChatStyles() {
+    lv_style_set_border_color(&bubble_style_, current_theme_.border);
+    lv_style_set_bg_color(&role_bubble_styles_[kChatRoleUser], current_theme_.user_bubble);
+    lv_style_set_bg_color(&role_bubble_styles_[kChatRoleAssistant], current_theme_.assistant_bubble);
+    lv_style_set_bg_color(&role_bubble_styles_[kChatRoleSystem], current_theme_.system_bubble);
+    lv_style_set_text_color(&role_text_styles_[kChatRoleUser], current_theme_.text);
+    lv_style_set_text_color(&role_text_styles_[kChatRoleAssistant], current_theme_.text);
+    lv_style_set_text_color(&role_text_styles_[kChatRoleSystem], current_theme_.system_text);
+    // nullptr refreshes every object using any style
+    lv_obj_report_style_change(nullptr);
+}
+
+LcdDisplay::ChatSlot& LcdDisplay::AcquireChatSlot() {
+    // 图片气泡不在对象池中，超过上限时仍按原方式删除最早的一个
+    uint32_t child_count = lv_obj_get_child_cnt(content_);
+    lv_obj_t* first_child = lv_obj_get_child(content_, 0);
+    if (child_count >= MAX_MESSAGES && first_child != nullptr &&
+        lv_obj_get_user_data(first_child) != nullptr && strcmp((const char*)lv_obj_get_user_data(first_child), "image") == 0) {
+        lv_obj_del(first_child);
+    }
+
+    if (chat_slots_.size() < MAX_MESSAGES) {
+        ChatSlot slot;
+        slot.row = lv_obj_create(content_);
+        lv_obj_add_style(slot.row, &row_style_, 0);
+        lv_obj_set_scrollbar_mode(slot.row, LV_SCROLLBAR_MODE_OFF);
+
+        slot.bubble = lv_obj_create(slot.row);
+        lv_obj_add_style(slot.bubble, &bubble_style_, 0);
+        lv_obj_set_scrollbar_mode(slot.bubble, LV_SCROLLBAR_MODE_OFF);
+
+        slot.label = lv_label_create(slot.bubble);
+        lv_label_set_long_mode(slot.label, LV_LABEL_LONG_WRAP);
+        lv_obj_set_style_text_font(slot.label, fonts_.text_font, 0);
+
+        chat_slots_.push_back(slot);
+        chat_slot_last_ = chat_slots_.size() - 1;
+        stat_bubbles_created_++;
+        return chat_slots_.back();
+    }
+
+    // 环已满：复用最早的气泡，并移动到列表末尾
+    chat_slot_last_ = chat_slot_next_;
+    chat_slot_next_ = (chat_slot_next_ + 1) % chat_slots_.size();
+    ChatSlot& slot = chat_slots_[chat_slot_last_];
+    lv_obj_move_to_index(slot.row, -1);
+    stat_bubbles_recycled_++;
+    return slot;
+}
+
+void LcdDisplay::LayoutChatSlot(ChatSlot& slot) {
+    // 计算气泡宽度：屏幕宽度的85%以内，不小于最小宽度
+    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;
+    lv_coord_t min_width = 20;
+    lv_coord_t bubble_width = std::min(std::max(slot.text_width, min_width), max_width);
+    lv_obj_set_width(slot.label, bubble_width);
+
+    if (slot.role == kChatRoleUser) {
+        lv_obj_align(slot.bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+    } else if (slot.role == kChatRoleSystem) {
+        lv_obj_align(slot.bubble, LV_ALIGN_CENTER, 0, 0);
+    } else {
+        lv_obj_align(slot.bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    }
+    lv_obj_scroll_to_view_recursive(slot.row, LV_ANIM_ON);
+}
+
+void LcdDisplay::ApplyChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (content_ == nullptr) {
         return;
@@ -431,188 +641,80 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     
     //避免出现空的消息框
     if(strlen(content) == 0) return;
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
-        }
+
+    int chat_role = GetChatRole(role);
+    if (++stat_messages_ % 50 == 0) {
+        ESP_LOGI(TAG, "Chat: %lu messages, %lu bubbles created, %lu recycled, %lu coalesced",
+            stat_messages_, stat_bubbles_created_, stat_bubbles_recycled_, stat_messages_coalesced_);
     }
-    
-    // 折叠系统消息（如果是系统消息，检查最后一个消息是否也是系统消息）
-    if (strcmp(role, "system") == 0 && child_count > 0) {
-        // 获取最后一个消息容器
-        lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-        if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-            // 获取容器内的气泡
-            lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-            if (last_bubble != nullptr) {
-                // 检查气泡类型是否为系统消息
-                void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                    // 如果最后一个消息也是系统消息，则删除它
-                    lv_obj_del(last_container);
+
+    // 助手逐句下发的回复合并到最后一个气泡中，系统消息直接替换；用户的每句话保持独立气泡
+    if (chat_slot_last_ >= 0 && chat_role != kChatRoleUser) {
+        ChatSlot& last = chat_slots_[chat_slot_last_];
+        uint32_t child_count = lv_obj_get_child_cnt(content_);
+        if (last.role == chat_role && lv_obj_get_child(content_, child_count - 1) == last.row) {
+            lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;
+            if (chat_role == kChatRoleSystem) {
+                lv_label_set_text(last.label, content);
+                last.text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
+            } else {
+                // 英文句子之间补一个空格
+                const char* text = lv_label_get_text(last.label);
+                size_t length = strlen(text);
+                if (length > 0 && (unsigned char)text[length - 1] < 0x80 && text[length - 1] != ' ' &&
+                    (unsigned char)content[0] < 0x80 && content[0] != ' ') {
+                    lv_label_ins_text(last.label, LV_LABEL_POS_LAST, " ");
+                }
+                lv_label_ins_text(last.label, LV_LABEL_POS_LAST, content);
+                // 已达到最大宽度后无需再测量
+                if (last.text_width < max_width) {
+                    last.text_width += lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
                 }
             }
+            stat_messages_coalesced_++;
+            LayoutChatSlot(last);
+            return;
         }
     }
-    
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 1, 0);
-    lv_obj_set_style_border_color(msg_bubble, current_theme_.border, 0);
-    lv_obj_set_style_pad_all(msg_bubble, 8, 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
 
-    // 计算气泡宽度
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // 确保文本宽度不小于最小宽度
-    if (text_width < min_width) {
-        text_width = min_width;
-    }
-
-    // 如果文本宽度小于最大宽度，使用文本宽度
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
+    ChatSlot& slot = AcquireChatSlot();
+    if (slot.role != chat_role) {
+        if (slot.role >= 0) {
+            lv_obj_remove_style(slot.bubble, &role_bubble_styles_[slot.role], 0);
+            lv_obj_remove_style(slot.label, &role_text_styles_[slot.role], 0);
+        }
+        lv_obj_add_style(slot.bubble, &role_bubble_styles_[chat_role], 0);
+        lv_obj_add_style(slot.label, &role_text_styles_[chat_role], 0);
+        slot.role = chat_role;
     }
-    
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-    lv_obj_set_style_text_font(msg_text, fonts_.text_font, 0);
-
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+    lv_label_set_text(slot.label, content);
+    slot.text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
+    LayoutChatSlot(slot);
 
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.user_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.assistant_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.system_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.system_text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    // Store reference to the latest message label
+    chat_message_label_ = slot.label;
+}
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+void LcdDisplay::ApplyClearChat() {
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr) {
+        return;
     }
-    
-    // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    // 删除全部气泡（含图片气泡），对象池从空环重新开始
+    lv_obj_clean(content_);
+    chat_slots_.clear();
+    chat_slot_next_ = 0;
+    chat_slot_last_ = -1;
+    chat_message_label_ = nullptr;
 }
 
-void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
+void LcdDisplay::ApplyPreviewImage(std::shared_ptr<const lv_img_dsc_t> image) {
     DisplayLockGuard lock(this);
     if (content_ == nullptr) {
         return;
     }
     
-    if (img_dsc != nullptr) {
+    if (image != nullptr) {
         // Create a message bubble for image preview
         lv_obj_t* img_bubble = lv_obj_create(content_);
         lv_obj_set_style_radius(img_bubble, 8, 0);
@@ -630,41 +732,16 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
         // Create the image object inside the bubble
         lv_obj_t* preview_image = lv_image_create(img_bubble);
         
-        // Copy the image descriptor and data to avoid source data changes
-        lv_img_dsc_t* copied_img_dsc = (lv_img_dsc_t*)heap_caps_malloc(sizeof(lv_img_dsc_t), MALLOC_CAP_8BIT);
-        if (copied_img_dsc == nullptr) {
-            ESP_LOGE(TAG, "Failed to allocate memory for image descriptor");
-            lv_obj_del(img_bubble);
-            return;
-        }
-        
-        // Copy the header
-        copied_img_dsc->header = img_dsc->header;
-        copied_img_dsc->data_size = img_dsc->data_size;
-        
-        // Copy the image data
-        uint8_t* copied_data = (uint8_t*)heap_caps_malloc(img_dsc->data_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (copied_data == nullptr) {
-            // Fallback to internal RAM if SPIRAM allocation fails
-            copied_data = (uint8_t*)heap_caps_malloc(img_dsc->data_size, MALLOC_CAP_8BIT);
-        }
-        if (copied_data == nullptr) {
-            ESP_LOGE(TAG, "Failed to allocate memory for image data (size: %lu bytes)", img_dsc->data_size);
-            heap_caps_free(copied_img_dsc);
-            lv_obj_del(img_bubble);
-            return;
-        }
-        
-        memcpy(copied_data, img_dsc->data, img_dsc->data_size);
-        copied_img_dsc->data = copied_data;
-        
+        // The image is already a private copy, the bubble keeps a reference until it is deleted
+        const lv_img_dsc_t* img_dsc = image.get();
+
         // Calculate appropriate size for the image
         lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
         lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
         
         // Calculate zoom factor to fit within maximum dimensions
-        lv_coord_t img_width = copied_img_dsc->header.w;
-        lv_coord_t img_height = copied_img_dsc->header.h;
+        lv_coord_t img_width = img_dsc->header.w;
+        lv_coord_t img_height = img_dsc->header.h;
         
         lv_coord_t zoom_w = (max_width * 256) / img_width;
         lv_coord_t zoom_h = (max_height * 256) / img_height;
@@ -674,17 +751,13 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
         if (zoom > 256) zoom = 256;
         
         // Set image properties
-        lv_image_set_src(preview_image, copied_img_dsc);
+        lv_image_set_src(preview_image, img_dsc);
         lv_image_set_scale(preview_image, zoom);
         
-        // Add event handler to clean up copied data when image is deleted
+        // Drop the reference when the image is deleted
         lv_obj_add_event_cb(preview_image, [](lv_event_t* e) {
-            lv_img_dsc_t* copied_img_dsc = (lv_img_dsc_t*)lv_event_get_user_data(e);
-            if (copied_img_dsc != nullptr) {
-                heap_caps_free((void*)copied_img_dsc->data);
-                heap_caps_free(copied_img_dsc);
-            }
-        }, LV_EVENT_DELETE, (void*)copied_img_dsc);
+            delete static_cast<std::shared_ptr<const lv_img_dsc_t>*>(lv_event_get_user_data(e));
+        }, LV_EVENT_DELETE, new std::shared_ptr<const lv_img_dsc_t>(image));
         
         // Calculate actual scaled image dimensions
         lv_coord_t scaled_width = (img_width * zoom) / 256;
@@ -810,19 +883,22 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(low_battery_label_, lv_color_white(), 0);
     lv_obj_center(low_battery_label_);
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+
+    ScheduleGlyphPrewarm();
 }
 
-void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
+void LcdDisplay::ApplyPreviewImage(std::shared_ptr<const lv_img_dsc_t> image) {
     DisplayLockGuard lock(this);
     if (preview_image_ == nullptr) {
         return;
     }
     
-    if (img_dsc != nullptr) {
-        // 设置图片源并显示预览图片
-        lv_image_set_src(preview_image_, img_dsc);
+    if (image != nullptr) {
+        // 设置图片源并显示预览图片，保留副本直到下一张图片替换它
+        lv_image_set_src(preview_image_, image.get());
+        preview_image_data_ = image;
         // zoom factor 0.5
-        lv_image_set_scale(preview_image_, 128 * width_ / img_dsc->header.w);
+        lv_image_set_scale(preview_image_, 128 * width_ / image->header.w);
         lv_obj_remove_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
         // 隐藏emotion_label_
         if (emotion_label_ != nullptr) {
@@ -838,7 +914,7 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
 }
 #endif
 
-void LcdDisplay::SetEmotion(const char* emotion) {
+void LcdDisplay::ApplyEmotion(const char* emotion) {
     struct Emotion {
         const char* icon;
         const char* text;
@@ -875,7 +951,7 @@ void LcdDisplay::SetEmotion(const char* emotion) {
     if (fonts_.emoji_font == nullptr || it == emotions.end()) {
         const char* utf8 = font_awesome_get_utf8(emotion);
         if (utf8 != nullptr) {
-            SetIcon(utf8);
+            ApplyIcon(utf8);
         }
         return;
     }
@@ -902,7 +978,7 @@ void LcdDisplay::SetEmotion(const char* emotion) {
 #endif
 }
 
-void LcdDisplay::SetIcon(const char* icon) {
+void LcdDisplay::ApplyIcon(const char* icon) {
     DisplayLockGuard lock(this);
     if (emotion_label_ == nullptr) {
         return;
@@ -978,119 +1054,17 @@ void LcdDisplay::SetTheme(const std::string& theme_name) {
         
         // If we have the chat message style, update all message bubbles
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
-        // Iterate through all children of content (message containers or bubbles)
+        // 文本气泡使用共享的角色样式，只需更新样式对象
+        UpdateChatStyles();
+
+        // 图片气泡是单独创建的，逐个更新
         uint32_t child_count = lv_obj_get_child_cnt(content_);
         for (uint32_t i = 0; i < child_count; i++) {
             lv_obj_t* obj = lv_obj_get_child(content_, i);
-            if (obj == nullptr) continue;
-            
-            lv_obj_t* bubble = nullptr;
-            
-            // 检查这个对象是容器还是气泡
-            // 如果是容器（用户或系统消息），则获取其子对象作为气泡
-            // 如果是气泡（助手消息），则直接使用
-            if (lv_obj_get_child_cnt(obj) > 0) {
-                // 可能是容器，检查它是否为用户或系统消息容器
-                // 用户和系统消息容器是透明的
-                lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
-                if (bg_opa == LV_OPA_TRANSP) {
-                    // 这是用户或系统消息的容器
-                    bubble = lv_obj_get_child(obj, 0);
-                } else {
-                    // 这可能是助手消息的气泡自身
-                    bubble = obj;
-                }
-            } else {
-                // 没有子元素，可能是其他UI元素，跳过
-                continue;
-            }
-            
-            if (bubble == nullptr) continue;
-            
-            // 使用保存的用户数据来识别气泡类型
-            void* bubble_type_ptr = lv_obj_get_user_data(bubble);
-            if (bubble_type_ptr != nullptr) {
-                const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
-                
-                // 根据气泡类型应用正确的颜色
-                if (strcmp(bubble_type, "user") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
-                } else if (strcmp(bubble_type, "assistant") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0); 
-                } else if (strcmp(bubble_type, "system") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                } else if (strcmp(bubble_type, "image") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 根据气泡类型设置文本颜色
-                        if (strcmp(bubble_type, "system") == 0) {
-                            lv_obj_set_style_text_color(text, current_theme_.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme_.text, 0);
-                        }
-                    }
-                }
-            } else {
-                // 如果没有标记，回退到之前的逻辑（颜色比较）
-                // ...保留原有的回退逻辑...
-                lv_color_t bg_color = lv_obj_get_style_bg_color(bubble, 0);
-            
-                // 改进bubble类型检测逻辑，不仅使用颜色比较
-                bool is_user_bubble = false;
-                bool is_assistant_bubble = false;
-                bool is_system_bubble = false;
-            
-                // 检查用户bubble
-                if (lv_color_eq(bg_color, DARK_USER_BUBBLE_COLOR) || 
-                    lv_color_eq(bg_color, LIGHT_USER_BUBBLE_COLOR) ||
-                    lv_color_eq(bg_color, current_theme_.user_bubble)) {
-                    is_user_bubble = true;
-                }
-                // 检查系统bubble
-                else if (lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                         lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR) ||
-                         lv_color_eq(bg_color, current_theme_.system_bubble)) {
-                    is_system_bubble = true;
-                }
-                // 剩余的都当作助手bubble处理
-                else {
-                    is_assistant_bubble = true;
-                }
-            
-                // 根据bubble类型应用正确的颜色
-                if (is_user_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
-                } else if (is_assistant_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0);
-                } else if (is_system_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 回退到颜色检测逻辑
-                        if (lv_color_eq(bg_color, current_theme_.system_bubble) ||
-                            lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                            lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR)) {
-                            lv_obj_set_style_text_color(text, current_theme_.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme_.text, 0);
-                        }
-                    }
-                }
+            void* bubble_type_ptr = lv_obj_get_user_data(obj);
+            if (bubble_type_ptr != nullptr && strcmp(static_cast<const char*>(bubble_type_ptr), "image") == 0) {
+                lv_obj_set_style_bg_color(obj, current_theme_.system_bubble, 0);
+                lv_obj_set_style_border_color(obj, current_theme_.border, 0);
             }
         }
 #else
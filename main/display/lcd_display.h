@@ -8,6 +8,7 @@
 #include <font_emoji.h>
 
 #include <atomic>
+#include <vector>
 
 // Theme color structure
 struct ThemeColors {
@@ -22,6 +23,20 @@ struct ThemeColors {
     lv_color_t low_battery;
 };
 
+// LVGL draw buffer strategy, selected per board. Internal DMA memory needed at 240x240 RGB565
+// with 20-line strips: single 9.6 KB, double 19.2 KB, PSRAM 9.6 KB bounce (plus 230 KB PSRAM),
+// full refresh 230 KB. Modes that don't allocate fall back to a single strip.
+enum LcdBufferMode {
+    kLcdBufferSingle,       // One DMA strip, rendering and transfer run serially
+    kLcdBufferDouble,       // Two DMA strips, rendering overlaps the transfer
+    kLcdBufferPsram,        // Two full-screen PSRAM buffers sent through a DMA bounce buffer
+    kLcdBufferFullRefresh,  // Two full-screen DMA buffers redrawn every frame, for small panels
+};
+
+struct LcdBufferConfig {
+    LcdBufferMode mode = kLcdBufferSingle;
+    int lines = 20;  // Strip height, also the bounce buffer height in PSRAM mode
+};
 
 class LcdDisplay : public Display {
 protected:
@@ -34,11 +49,51 @@ protected:
     lv_obj_t* container_ = nullptr;
     lv_obj_t* side_bar_ = nullptr;
     lv_obj_t* preview_image_ = nullptr;
+    std::shared_ptr<const lv_img_dsc_t> preview_image_data_;  // Source of preview_image_
 
     DisplayFonts fonts_;
     ThemeColors current_theme_;
 
+    // Render statistics, logged periodically
+    uint32_t stat_frames_ = 0;
+    int64_t stat_render_time_ = 0;
+    int64_t stat_render_start_ = 0;
+    int64_t stat_start_time_ = 0;
+
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // 聊天气泡对象池：行容器、气泡和文本标签在固定大小的环中循环复用
+    struct ChatSlot {
+        lv_obj_t* row = nullptr;
+        lv_obj_t* bubble = nullptr;
+        lv_obj_t* label = nullptr;
+        int role = -1;
+        lv_coord_t text_width = 0;  // Unwrapped width of the text, extended on append
+    };
+    std::vector<ChatSlot> chat_slots_;
+    int chat_slot_next_ = 0;   // Oldest slot, reused once the ring is full
+    int chat_slot_last_ = -1;  // Slot holding the latest message
+    lv_style_t row_style_;
+    lv_style_t bubble_style_;
+    lv_style_t role_bubble_styles_[3];
+    lv_style_t role_text_styles_[3];
+
+    // Chat statistics, logged periodically
+    uint32_t stat_messages_ = 0;
+    uint32_t stat_bubbles_created_ = 0;
+    uint32_t stat_bubbles_recycled_ = 0;
+    uint32_t stat_messages_coalesced_ = 0;
+
+    void InitializeChatStyles();
+    void UpdateChatStyles();
+    ChatSlot& AcquireChatSlot();
+    void LayoutChatSlot(ChatSlot& slot);
+#endif
+
     void SetupUI();
+    void AddPanelDisplay(int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
+                         LcdBufferConfig buffer_config);
+    void EnableRenderStats();
+    void ScheduleGlyphPrewarm();
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -46,15 +101,17 @@ protected:
     // 添加protected构造函数
     LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, DisplayFonts fonts, int width, int height);
     
-public:
-    ~LcdDisplay();
-    virtual void SetEmotion(const char* emotion) override;
-    virtual void SetIcon(const char* icon) override;
-    virtual void SetPreviewImage(const lv_img_dsc_t* img_dsc) override;
+    virtual void ApplyEmotion(const char* emotion) override;
+    virtual void ApplyIcon(const char* icon) override;
+    virtual void ApplyPreviewImage(std::shared_ptr<const lv_img_dsc_t> image) override;
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
-    virtual void SetChatMessage(const char* role, const char* content) override; 
+    virtual void ApplyChatMessage(const char* role, const char* content) override; 
+    virtual void ApplyClearChat() override;
 #endif  
 
+public:
+    ~LcdDisplay();
+
     // Add theme switching function
     virtual void SetTheme(const std::string& theme_name) override;
 };
@@ -83,7 +140,7 @@ public:
     SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                   int width, int height, int offset_x, int offset_y,
                   bool mirror_x, bool mirror_y, bool swap_xy,
-                  DisplayFonts fonts);
+                  DisplayFonts fonts, LcdBufferConfig buffer_config = {});
 };
 
 // QSPI LCD显示器
@@ -92,7 +149,7 @@ public:
     QspiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                    int width, int height, int offset_x, int offset_y,
                    bool mirror_x, bool mirror_y, bool swap_xy,
-                   DisplayFonts fonts);
+                   DisplayFonts fonts, LcdBufferConfig buffer_config = {});
 };
 
 // MCU8080 LCD显示器
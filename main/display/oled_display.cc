@@ -3,6 +3,7 @@
 
 #include <string>
 #include <algorithm>
+#include <cstring>
 
 #include <esp_log.h>
 #include <esp_err.h>
@@ -23,39 +24,35 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
     lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
     port_cfg.task_priority = 3;  // 提高任务优先级，避免被其他任务阻塞
     port_cfg.task_stack = 8192;  // 增加栈大小，防止栈溢出
-    port_cfg.timer_period_ms = 200;  // 大幅增加刷新间隔，从50ms改为200ms，减少I2C压力
+    port_cfg.timer_period_ms = 10;  // 只发送变化的页，不再需要靠降低刷新频率来减少I2C压力
     lvgl_port_init(&port_cfg);
 
-    ESP_LOGI(TAG, "Adding OLED display");
-    const lvgl_port_display_cfg_t display_cfg = {
-        .io_handle = panel_io_,
-        .panel_handle = panel_,
-        .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * height_),
-        .double_buffer = false,
-        .trans_size = 0,
-        .hres = static_cast<uint32_t>(width_),
-        .vres = static_cast<uint32_t>(height_),
-        .monochrome = true,
-        .rotation = {
-            .swap_xy = false,
-            .mirror_x = mirror_x,
-            .mirror_y = mirror_y,
-        },
-        .flags = {
-            .buff_dma = 1,
-            .buff_spiram = 0,
-            .sw_rotate = 0,
-            .full_refresh = 0,
-            .direct_mode = 0,
-        },
-    };
+    frame_.resize(width_ * height_ / 8, 0);
+    shadow_.resize(width_ * height_ / 8, 0);
+    tx_buffer_.resize(width_ * height_ / 8, 0);
+    // I1 draw buffers carry an 8-byte palette in front of the pixel data
+    draw_buffer_.resize(lv_draw_buf_width_to_stride(width_, LV_COLOR_FORMAT_I1) * height_ + 8);
 
-    display_ = lvgl_port_add_disp(&display_cfg);
-    if (display_ == nullptr) {
-        ESP_LOGE(TAG, "Failed to add display");
-        return;
+    if (esp_lcd_panel_mirror(panel_, mirror_x, mirror_y) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set panel mirror");
+    }
+
+    ESP_LOGI(TAG, "Adding OLED display");
+    {
+        DisplayLockGuard lock(this);
+        display_ = lv_display_create(width_, height_);
+        if (display_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to add display");
+            return;
+        }
+        lv_display_set_color_format(display_, LV_COLOR_FORMAT_I1);
+        lv_display_set_buffers(display_, draw_buffer_.data(), nullptr, draw_buffer_.size(), LV_DISPLAY_RENDER_MODE_PARTIAL);
+        lv_display_set_user_data(display_, this);
+        lv_display_set_flush_cb(display_, FlushCallback);
+        lv_display_add_event_cb(display_, RounderCallback, LV_EVENT_INVALIDATE_AREA, nullptr);
     }
+    AttachUpdateQueue();
+    stat_start_time_ = esp_timer_get_time();
 
     if (height_ == 64) {
         SetupUI_128x64();
@@ -87,6 +84,126 @@ OledDisplay::~OledDisplay() {
     lvgl_port_deinit();
 }
 
+// Invalidated areas are rounded to whole pages (8 rows) and bytes (8 columns),
+// so every flush maps onto complete bytes of the panel memory and the I1 buffer
+void OledDisplay::RounderCallback(lv_event_t* e) {
+    auto area = static_cast<lv_area_t*>(lv_event_get_param(e));
+    auto disp = static_cast<lv_display_t*>(lv_event_get_target(e));
+    int32_t max_x = lv_display_get_horizontal_resolution(disp) - 1;
+    int32_t max_y = lv_display_get_vertical_resolution(disp) - 1;
+    area->x1 &= ~7;
+    area->y1 &= ~7;
+    area->x2 = std::min<int32_t>(area->x2 | 7, max_x);
+    area->y2 = std::min<int32_t>(area->y2 | 7, max_y);
+}
+
+void OledDisplay::FlushCallback(lv_display_t* disp, const lv_area_t* area, uint8_t* px_map) {
+    auto self = static_cast<OledDisplay*>(lv_display_get_user_data(disp));
+    self->Flush(area, px_map + 8);  // Skip the I1 palette
+    lv_display_flush_ready(disp);
+
+    if (lv_display_flush_is_last(disp)) {
+        self->stat_frames_++;
+        int64_t now = esp_timer_get_time();
+        if (now - self->stat_start_time_ >= 10 * 1000 * 1000) {
+            uint32_t fps = self->stat_frames_ * 1000000ULL / (now - self->stat_start_time_);
+            ESP_LOGI(TAG, "Flush: %lu fps, %lu bytes/frame", fps, self->stat_bytes_ / self->stat_frames_);
+            self->stat_frames_ = 0;
+            self->stat_bytes_ = 0;
+            self->stat_start_time_ = now;
+        }
+    }
+}
+
+void OledDisplay::Flush(const lv_area_t* area, const uint8_t* px_map) {
+    // Convert the rendered area (I1, MSB first, 1 = background) into page layout
+    int32_t stride = lv_draw_buf_width_to_stride(lv_area_get_width(area), LV_COLOR_FORMAT_I1);
+    for (int32_t y = area->y1; y <= area->y2; y++) {
+        const uint8_t* src = px_map + (y - area->y1) * stride;
+        uint8_t* dst = &frame_[(y / 8) * width_];
+        uint8_t mask = 1 << (y % 8);
+        for (int32_t x = area->x1; x <= area->x2; x++) {
+            int32_t i = x - area->x1;
+            if (src[i / 8] & (0x80 >> (i % 8))) {
+                dst[x] &= ~mask;
+            } else {
+                dst[x] |= mask;
+            }
+        }
+    }
+
+    // Diff against the shadow copy, one column range per page. Small gaps are
+    // sent along with the changes because a new transaction costs more bytes.
+    // Pending segments live on the stack, one slot per page of the tallest panel (64 rows);
+    // when they run out the pending ones are sent early and only lose the cross-page merge.
+    constexpr int kMergeGap = 8;
+    constexpr int kMaxSegments = 8;
+    struct Segment {
+        int page_start;
+        int page_end;
+        int x_start;
+        int x_end;
+    };
+    Segment segments[kMaxSegments];
+    int segment_count = 0;
+    auto add_segment = [this, &segments, &segment_count](int page, int x_start, int x_end) {
+        // Extend the segment of the previous page when the columns line up
+        for (int i = 0; i < segment_count; i++) {
+            auto& segment = segments[i];
+            if (segment.page_end == page - 1 && segment.x_start == x_start && segment.x_end == x_end) {
+                segment.page_end = page;
+                return;
+            }
+        }
+        if (segment_count == kMaxSegments) {
+            for (int i = 0; i < segment_count; i++) {
+                SendSegment(segments[i].page_start, segments[i].page_end, segments[i].x_start, segments[i].x_end);
+            }
+            segment_count = 0;
+        }
+        segments[segment_count++] = {page, page, x_start, x_end};
+    };
+    for (int page = area->y1 / 8; page <= area->y2 / 8; page++) {
+        const uint8_t* next = &frame_[page * width_];
+        const uint8_t* prev = &shadow_[page * width_];
+        int x_start = -1, x_end = -1;
+        for (int x = area->x1; x <= area->x2; x++) {
+            if (shadow_valid_ && next[x] == prev[x]) {
+                continue;
+            }
+            if (x_start >= 0 && x - x_end > kMergeGap) {
+                add_segment(page, x_start, x_end);
+                x_start = -1;
+            }
+            if (x_start < 0) {
+                x_start = x;
+            }
+            x_end = x;
+        }
+        if (x_start >= 0) {
+            add_segment(page, x_start, x_end);
+        }
+    }
+
+    for (int i = 0; i < segment_count; i++) {
+        SendSegment(segments[i].page_start, segments[i].page_end, segments[i].x_start, segments[i].x_end);
+    }
+    shadow_valid_ = shadow_valid_ || (area->x1 == 0 && area->y1 == 0 && area->x2 == width_ - 1 && area->y2 == height_ - 1);
+}
+
+void OledDisplay::SendSegment(int page_start, int page_end, int x_start, int x_end) {
+    int columns = x_end - x_start + 1;
+    uint8_t* out = tx_buffer_.data();
+    for (int page = page_start; page <= page_end; page++) {
+        memcpy(out, &frame_[page * width_ + x_start], columns);
+        memcpy(&shadow_[page * width_ + x_start], out, columns);
+        out += columns;
+    }
+    // The panel driver sets the column and page window, the data follows in one transaction
+    esp_lcd_panel_draw_bitmap(panel_, x_start, page_start * 8, x_end + 1, (page_end + 1) * 8, tx_buffer_.data());
+    stat_bytes_ += out - tx_buffer_.data();
+}
+
 bool OledDisplay::Lock(int timeout_ms) {
     return lvgl_port_lock(timeout_ms);
 }
@@ -95,7 +212,7 @@ void OledDisplay::Unlock() {
     lvgl_port_unlock();
 }
 
-void OledDisplay::SetChatMessage(const char* role, const char* content) {
+void OledDisplay::ApplyChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (chat_message_label_ == nullptr) {
         return;
@@ -6,6 +6,8 @@
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 
+#include <vector>
+
 class OledDisplay : public Display {
 private:
     esp_lcd_panel_io_handle_t panel_io_ = nullptr;
@@ -20,18 +22,37 @@ private:
 
     DisplayFonts fonts_;
 
+    // Page-layout (8 vertical pixels per byte) copies of the panel memory:
+    // frame_ holds the latest LVGL output, shadow_ what the panel already shows
+    std::vector<uint8_t> frame_;
+    std::vector<uint8_t> shadow_;
+    std::vector<uint8_t> tx_buffer_;
+    std::vector<uint8_t> draw_buffer_;
+    bool shadow_valid_ = false;
+
+    // Flush statistics, logged periodically
+    uint32_t stat_frames_ = 0;
+    uint32_t stat_bytes_ = 0;
+    int64_t stat_start_time_ = 0;
+
+    static void FlushCallback(lv_display_t* disp, const lv_area_t* area, uint8_t* px_map);
+    static void RounderCallback(lv_event_t* e);
+    void Flush(const lv_area_t* area, const uint8_t* px_map);
+    void SendSegment(int page_start, int page_end, int x_start, int x_end);
+
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
     void SetupUI_128x64();
     void SetupUI_128x32();
 
+protected:
+    virtual void ApplyChatMessage(const char* role, const char* content) override;
+
 public:
     OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, int width, int height, bool mirror_x, bool mirror_y,
                 DisplayFonts fonts);
     ~OledDisplay();
-
-    virtual void SetChatMessage(const char* role, const char* content) override;
 };
 
 #endif // OLED_DISPLAY_H
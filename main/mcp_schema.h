@@ -0,0 +1,182 @@
+#ifndef MCP_SCHEMA_H
+#define MCP_SCHEMA_H
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#include <cJSON.h>
+
+// 编译期描述的工具参数结构：参数直接解码到 C++ 结构体中，校验失败通过返回值报告，不抛出异常
+//
+//   struct VolumeArgs { int volume = 50; };
+//   McpSchema schema(McpField("volume", &VolumeArgs::volume).Range(0, 100));
+
+inline void AppendJsonString(std::string& out, const char* str) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (const char* p = str; *p; p++) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0x0f];
+            } else {
+                out += static_cast<char>(c);
+            }
+            break;
+        }
+    }
+    out += '"';
+}
+
+template<typename S, typename T>
+struct McpField {
+    static_assert(std::is_same_v<T, bool> || std::is_same_v<T, int> || std::is_same_v<T, std::string>,
+                  "MCP arguments must be bool, int or std::string");
+
+    const char* name;
+    T S::* member;
+    bool required = true;   // Optional fields take their default from the struct's initializer
+    bool has_range = false;
+    int min_value = 0;
+    int max_value = 0;
+
+    constexpr McpField(const char* name, T S::* member) : name(name), member(member) {}
+
+    constexpr McpField Optional() const {
+        McpField field = *this;
+        field.required = false;
+        return field;
+    }
+
+    constexpr McpField Range(int min, int max) const {
+        static_assert(std::is_same_v<T, int>, "Range limits only apply to integer properties");
+        McpField field = *this;
+        field.has_range = true;
+        field.min_value = min;
+        field.max_value = max;
+        return field;
+    }
+};
+
+template<typename S, typename... T>
+class McpSchema {
+public:
+    constexpr McpSchema(McpField<S, T>... fields) : fields_(fields...) {}
+
+    // Same layout as McpTool::to_json() produces for a PropertyList
+    std::string to_json() const {
+        const S defaults{};
+        std::string json = "{\"type\":\"object\",\"properties\":{";
+        bool first = true;
+        std::apply([&](const auto&... field) { (AppendProperty(json, field, defaults, first), ...); }, fields_);
+        json += "}";
+
+        std::string required;
+        std::apply([&](const auto&... field) {
+            ([&] {
+                if (field.required) {
+                    if (!required.empty()) {
+                        required += ",";
+                    }
+                    AppendJsonString(required, field.name);
+                }
+            }(), ...);
+        }, fields_);
+        if (!required.empty()) {
+            json += ",\"required\":[" + required + "]";
+        }
+        json += "}";
+        return json;
+    }
+
+    bool Decode(const cJSON* arguments, S& args, std::string& error) const {
+        return std::apply([&](const auto&... field) {
+            return (DecodeField(field, arguments, args, error) && ...);
+        }, fields_);
+    }
+
+private:
+    std::tuple<McpField<S, T>...> fields_;
+
+    template<typename U>
+    static void AppendProperty(std::string& json, const McpField<S, U>& field, const S& defaults, bool& first) {
+        if (!first) {
+            json += ",";
+        }
+        first = false;
+        AppendJsonString(json, field.name);
+        if constexpr (std::is_same_v<U, bool>) {
+            json += ":{\"type\":\"boolean\"";
+            if (!field.required) {
+                json += defaults.*field.member ? ",\"default\":true" : ",\"default\":false";
+            }
+        } else if constexpr (std::is_same_v<U, int>) {
+            json += ":{\"type\":\"integer\"";
+            if (!field.required) {
+                json += ",\"default\":" + std::to_string(defaults.*field.member);
+            }
+            if (field.has_range) {
+                json += ",\"minimum\":" + std::to_string(field.min_value);
+                json += ",\"maximum\":" + std::to_string(field.max_value);
+            }
+        } else {
+            json += ":{\"type\":\"string\"";
+            if (!field.required) {
+                json += ",\"default\":";
+                AppendJsonString(json, (defaults.*field.member).c_str());
+            }
+        }
+        json += "}";
+    }
+
+    template<typename U>
+    static bool DecodeField(const McpField<S, U>& field, const cJSON* arguments, S& args, std::string& error) {
+        const cJSON* value = cJSON_IsObject(arguments) ? cJSON_GetObjectItem(arguments, field.name) : nullptr;
+        bool found = false;
+        if constexpr (std::is_same_v<U, bool>) {
+            if (cJSON_IsBool(value)) {
+                args.*field.member = cJSON_IsTrue(value);
+                found = true;
+            }
+        } else if constexpr (std::is_same_v<U, int>) {
+            if (cJSON_IsNumber(value)) {
+                int number = value->valueint;
+                if (field.has_range && number < field.min_value) {
+                    error = "Value is below minimum allowed: " + std::to_string(field.min_value);
+                    return false;
+                }
+                if (field.has_range && number > field.max_value) {
+                    error = "Value exceeds maximum allowed: " + std::to_string(field.max_value);
+                    return false;
+                }
+                args.*field.member = number;
+                found = true;
+            }
+        } else {
+            if (cJSON_IsString(value)) {
+                args.*field.member = value->valuestring;
+                found = true;
+            }
+        }
+
+        if (!found && field.required) {
+            error = std::string("Missing valid argument: ") + field.name;
+            return false;
+        }
+        return true;
+    }
+};
+
+template<typename S, typename... T>
+McpSchema(McpField<S, T>...) -> McpSchema<S, T...>;
+
+#endif // MCP_SCHEMA_H
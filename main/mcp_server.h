@@ -2,16 +2,22 @@
 #define MCP_SERVER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <atomic>
 #include <functional>
 #include <variant>
 #include <optional>
 #include <stdexcept>
-#include <thread>
+#include <memory>
 
 #include <cJSON.h>
 
+#include "mcp_schema.h"
+#include "mcp_tools_list.h"
+
 // 添加类型别名
 using ReturnValue = std::variant<bool, int, std::string>;
 
@@ -172,11 +178,20 @@ public:
 };
 
 class McpTool {
+public:
+    using ToolCall = std::function<ReturnValue()>;
+    // Decodes the arguments of a typed tool, returns an empty call and sets error on failure
+    using TypedBinder = std::function<ToolCall(const cJSON* arguments, std::string& error)>;
+
 private:
     std::string name_;
     std::string description_;
     PropertyList properties_;
     std::function<ReturnValue(const PropertyList&)> callback_;
+    std::string input_schema_;  // 类型化工具在注册时生成的 inputSchema
+    TypedBinder typed_binder_;
+    int max_concurrency_ = 1;   // 同一工具允许同时执行的调用数
+    int timeout_ms_ = 30000;    // 超时后返回错误，工具本身的结果被丢弃
 
 public:
     McpTool(const std::string& name, 
@@ -188,33 +203,67 @@ public:
         properties_(properties), 
         callback_(callback) {}
 
+    McpTool(const std::string& name,
+            const std::string& description,
+            const std::string& input_schema,
+            TypedBinder typed_binder)
+        : name_(name),
+        description_(description),
+        input_schema_(input_schema),
+        typed_binder_(typed_binder) {}
+
+    // Typed tool: arguments are decoded straight into S, callback takes const S&
+    template<typename S, typename... T, typename F>
+    static McpTool* Create(const std::string& name, const std::string& description, const McpSchema<S, T...>& schema, F callback) {
+        return new McpTool(name, description, schema.to_json(),
+            [schema, callback](const cJSON* arguments, std::string& error) -> ToolCall {
+                S args{};
+                if (!schema.Decode(arguments, args, error)) {
+                    return nullptr;
+                }
+                // 通过指针引用注册时保存的回调，指针加小参数结构可放入 std::function 的内联存储
+                const F* handler = &callback;
+                return [handler, args = std::move(args)]() -> ReturnValue {
+                    return (*handler)(args);
+                };
+            });
+    }
+
     inline const std::string& name() const { return name_; }
     inline const std::string& description() const { return description_; }
     inline const PropertyList& properties() const { return properties_; }
+    inline int max_concurrency() const { return max_concurrency_; }
+    inline int timeout_ms() const { return timeout_ms_; }
+    inline void set_max_concurrency(int max_concurrency) { max_concurrency_ = max_concurrency; }
+    inline void set_timeout_ms(int timeout_ms) { timeout_ms_ = timeout_ms; }
 
     std::string to_json() const {
-        std::vector<std::string> required = properties_.GetRequired();
-        
         cJSON *json = cJSON_CreateObject();
         cJSON_AddStringToObject(json, "name", name_.c_str());
         cJSON_AddStringToObject(json, "description", description_.c_str());
-        
-        cJSON *input_schema = cJSON_CreateObject();
-        cJSON_AddStringToObject(input_schema, "type", "object");
-        
-        cJSON *properties = cJSON_Parse(properties_.to_json().c_str());
-        cJSON_AddItemToObject(input_schema, "properties", properties);
-        
-        if (!required.empty()) {
-            cJSON *required_array = cJSON_CreateArray();
-            for (const auto& property : required) {
-                cJSON_AddItemToArray(required_array, cJSON_CreateString(property.c_str()));
+
+        if (typed_binder_) {
+            cJSON_AddRawToObject(json, "inputSchema", input_schema_.c_str());
+        } else {
+            std::vector<std::string> required = properties_.GetRequired();
+
+            cJSON *input_schema = cJSON_CreateObject();
+            cJSON_AddStringToObject(input_schema, "type", "object");
+            
+            cJSON *properties = cJSON_Parse(properties_.to_json().c_str());
+            cJSON_AddItemToObject(input_schema, "properties", properties);
+            
+            if (!required.empty()) {
+                cJSON *required_array = cJSON_CreateArray();
+                for (const auto& property : required) {
+                    cJSON_AddItemToArray(required_array, cJSON_CreateString(property.c_str()));
+                }
+                cJSON_AddItemToObject(input_schema, "required", required_array);
             }
-            cJSON_AddItemToObject(input_schema, "required", required_array);
+            
+            cJSON_AddItemToObject(json, "inputSchema", input_schema);
         }
         
-        cJSON_AddItemToObject(json, "inputSchema", input_schema);
-        
         char *json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
@@ -223,8 +272,50 @@ public:
         return result;
     }
 
+    // Decode and validate the arguments, the returned call runs the tool on the executor
+    ToolCall Bind(const cJSON* tool_arguments, std::string& error) const {
+        if (typed_binder_) {
+            return typed_binder_(tool_arguments, error);
+        }
+
+        PropertyList arguments = properties_;
+        try {
+            for (auto& argument : arguments) {
+                bool found = false;
+                if (cJSON_IsObject(tool_arguments)) {
+                    auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
+                    if (argument.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
+                        argument.set_value<bool>(value->valueint == 1);
+                        found = true;
+                    } else if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
+                        argument.set_value<int>(value->valueint);
+                        found = true;
+                    } else if (argument.type() == kPropertyTypeString && cJSON_IsString(value)) {
+                        argument.set_value<std::string>(value->valuestring);
+                        found = true;
+                    }
+                }
+
+                if (!argument.has_default_value() && !found) {
+                    error = "Missing valid argument: " + argument.name();
+                    return nullptr;
+                }
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+            return nullptr;
+        }
+
+        return [this, arguments = std::move(arguments)]() {
+            return callback_(arguments);
+        };
+    }
+
     std::string Call(const PropertyList& properties) {
-        ReturnValue return_value = callback_(properties);
+        return FormatResult(callback_(properties));
+    }
+
+    static std::string FormatResult(const ReturnValue& return_value) {
         // 返回结果
         cJSON* result = cJSON_CreateObject();
         cJSON* content = cJSON_CreateArray();
@@ -249,6 +340,8 @@ public:
     }
 };
 
+class McpToolExecutor;
+
 class McpServer {
 public:
     static McpServer& GetInstance() {
@@ -259,8 +352,17 @@ public:
     void AddCommonTools();
     void AddTool(McpTool* tool);
     void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
+
+    // Typed tool: arguments are decoded straight into S, callback takes const S&
+    template<typename S, typename... T, typename F>
+    void AddTool(const std::string& name, const std::string& description, const McpSchema<S, T...>& schema, F callback) {
+        AddTool(McpTool::Create(name, description, schema, callback));
+    }
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
+#if CONFIG_USE_MCP_BENCHMARK
+    void RunBenchmark();
+#endif
 
 private:
     McpServer();
@@ -268,14 +370,22 @@ private:
 
     void ParseCapabilities(const cJSON* capabilities);
 
-    void ReplyResult(int id, const std::string& result);
+    void ReplyResult(int id, std::string_view result);
+    void ReplyToolResult(int id, const ReturnValue& value);
     void ReplyError(int id, const std::string& message);
 
+    bool RegisterTool(McpTool* tool);
     void GetToolsList(int id, const std::string& cursor);
+    void BuildToolsList();
+    void NotifyToolsListChanged();
     void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size);
 
-    std::vector<McpTool*> tools_;
-    std::thread tool_call_thread_;
+    // tools/list 分页结果在首次请求时序列化并缓存；之后的 AddTool 在主循环中重建缓存并通知对端
+    std::vector<McpTool*> tools_;  // Registration order, used for tools/list
+    std::unordered_map<std::string, McpTool*> tool_index_;
+    McpToolsList tools_list_;
+    std::atomic<bool> tools_list_served_{false};
+    std::unique_ptr<McpToolExecutor> executor_;
 };
 
 #endif // MCP_SERVER_H
@@ -0,0 +1,251 @@
+#include "mcp_tool_executor.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cassert>
+
+#define TAG "McpExecutor"
+
+#define TOOLCALL_SMALL_STACK_SIZE 6144
+#define TOOLCALL_SMALL_WORKERS CONFIG_MCP_TOOLCALL_SMALL_WORKERS
+#define TOOLCALL_LARGE_STACK_SIZE 12288
+#define TOOLCALL_LARGE_WORKERS CONFIG_MCP_TOOLCALL_LARGE_WORKERS
+#define TOOLCALL_MAX_QUEUE_DEPTH 4
+#define TOOLCALL_DEADLINE_CHECK_US (100 * 1000)
+#define TOOLCALL_STATS_INTERVAL_US (10 * 1000 * 1000)
+
+McpToolExecutor::McpToolExecutor(ResultCallback on_result, ReplyCallback on_error)
+    : on_result_(on_result), on_error_(on_error) {
+    for (auto [stack_size, workers] : { std::make_pair(TOOLCALL_SMALL_STACK_SIZE, TOOLCALL_SMALL_WORKERS),
+                                        std::make_pair(TOOLCALL_LARGE_STACK_SIZE, TOOLCALL_LARGE_WORKERS) }) {
+        auto worker_class = std::make_unique<WorkerClass>();
+        worker_class->stack_size = stack_size;
+        worker_class->workers = workers;
+        for (int i = 0; i < workers; i++) {
+            StartWorker(worker_class.get());
+        }
+        classes_.push_back(std::move(worker_class));
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<McpToolExecutor*>(arg)->CheckDeadlines();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "mcp_deadline",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &deadline_timer_));
+}
+
+McpToolExecutor::~McpToolExecutor() {
+    // 单例随程序存在，工作任务不会退出，这里只释放定时器
+    if (deadline_timer_ != nullptr) {
+        esp_timer_stop(deadline_timer_);
+        esp_timer_delete(deadline_timer_);
+    }
+}
+
+void McpToolExecutor::StartWorker(WorkerClass* worker_class) {
+    auto worker = std::make_unique<Worker>();
+    worker->executor = this;
+    worker->worker_class = worker_class;
+
+#if CONFIG_MCP_TOOLCALL_STACK_IN_PSRAM
+    worker->task_stack = (StackType_t*)heap_caps_malloc(worker_class->stack_size, MALLOC_CAP_SPIRAM);
+#endif
+    // 默认使用内部 RAM 作为栈，工具中可能有访问 Flash 的操作
+    if (worker->task_stack == nullptr) {
+        worker->task_stack = (StackType_t*)heap_caps_malloc(worker_class->stack_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    assert(worker->task_stack != nullptr);
+    worker->task_buffer = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+    assert(worker->task_buffer != nullptr);
+
+    worker->task = xTaskCreateStatic([](void* arg) {
+        auto worker = (Worker*)arg;
+        worker->executor->WorkerLoop(worker->worker_class);
+        vTaskDelete(NULL);
+    }, "tool_call", worker_class->stack_size, worker.get(), 1, worker->task_stack, worker->task_buffer);
+    workers_.push_back(std::move(worker));
+}
+
+bool McpToolExecutor::Submit(int id, McpTool* tool, McpTool::ToolCall&& call, int stack_size, std::string& error) {
+    // 选择满足栈大小的最小等级
+    WorkerClass* worker_class = classes_.back().get();
+    for (auto& c : classes_) {
+        if (c->stack_size >= (size_t)stack_size) {
+            worker_class = c.get();
+            break;
+        }
+    }
+    if ((size_t)stack_size > worker_class->stack_size) {
+        ESP_LOGW(TAG, "Tool %s requested stack %d, using %u", tool->name().c_str(), stack_size,
+            (unsigned)worker_class->stack_size);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& running = tool_in_flight_[tool];
+    if (running >= tool->max_concurrency()) {
+        stats_.rejected++;
+        bool hung = std::any_of(in_flight_.begin(), in_flight_.end(), [tool](const std::shared_ptr<Job>& job) {
+            return job->tool == tool && job->hung;
+        });
+        error = "Tool " + tool->name() + (hung ? " is still running a call that timed out" : " is busy");
+        return false;
+    }
+    if (worker_class->queue.size() >= TOOLCALL_MAX_QUEUE_DEPTH) {
+        stats_.rejected++;
+        error = "Too many pending tool calls";
+        return false;
+    }
+
+    auto now = esp_timer_get_time();
+    auto job = std::make_shared<Job>();
+    job->id = id;
+    job->tool = tool;
+    job->call = std::move(call);
+    job->enqueue_time = now;
+    job->deadline = now + (int64_t)tool->timeout_ms() * 1000;
+
+    running++;
+    in_flight_.push_back(job);
+    worker_class->queue.push_back(job);
+    stats_.calls++;
+    stats_.queue_depth++;
+    stats_.max_queue_depth = std::max(stats_.max_queue_depth, stats_.queue_depth);
+    if (!esp_timer_is_active(deadline_timer_)) {
+        esp_timer_start_periodic(deadline_timer_, TOOLCALL_DEADLINE_CHECK_US);
+    }
+    worker_class->cv.notify_one();
+    return true;
+}
+
+void McpToolExecutor::Cancel(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& job : in_flight_) {
+        if (job->id == id && !job->finished.exchange(true)) {
+            ESP_LOGI(TAG, "Tool call %d (%s) cancelled", id, job->tool->name().c_str());
+            stats_.cancelled++;
+            return;
+        }
+    }
+}
+
+void McpToolExecutor::WorkerLoop(WorkerClass* worker_class) {
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            worker_class->cv.wait(lock, [worker_class]() { return !worker_class->queue.empty(); });
+            job = std::move(worker_class->queue.front());
+            worker_class->queue.pop_front();
+            stats_.queue_depth--;
+            job->started = true;
+        }
+        Run(job);
+    }
+}
+
+// Whoever marks the job finished first owns the reply
+bool McpToolExecutor::Finish(const std::shared_ptr<Job>& job) {
+    return !job->finished.exchange(true);
+}
+
+// Called with mutex_ held
+void McpToolExecutor::ReleaseSlot(const std::shared_ptr<Job>& job) {
+    if (!job->slot_released) {
+        job->slot_released = true;
+        tool_in_flight_[job->tool]--;
+    }
+}
+
+void McpToolExecutor::Run(const std::shared_ptr<Job>& job) {
+    auto start_time = esp_timer_get_time();
+    bool failed = false;
+
+    // 排队期间已超时或被取消的调用不再执行
+    bool skipped = job->finished.load();
+    if (!skipped) {
+        try {
+            auto value = job->call();
+            if (Finish(job)) {
+                on_result_(job->id, value);
+            }
+        } catch (const std::exception& e) {
+            ESP_LOGE(TAG, "tools/call: %s", e.what());
+            failed = true;
+            if (Finish(job)) {
+                on_error_(job->id, e.what());
+            }
+        }
+    }
+
+    auto end_time = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_.erase(std::find(in_flight_.begin(), in_flight_.end(), job));
+    if (job->hung) {
+        ESP_LOGW(TAG, "Tool call %d (%s) returned after its timeout", job->id, job->tool->name().c_str());
+        stats_.hung--;
+    }
+    ReleaseSlot(job);
+    if (skipped) {
+        stats_.skipped++;
+        return;
+    }
+
+    auto wait_us = start_time - job->enqueue_time;
+    auto run_us = end_time - start_time;
+    stats_.completed++;
+    if (failed) {
+        stats_.failed++;
+    }
+    stats_.total_wait_us += wait_us;
+    stats_.max_wait_us = std::max(stats_.max_wait_us, wait_us);
+    stats_.total_run_us += run_us;
+    stats_.max_run_us = std::max(stats_.max_run_us, run_us);
+
+    if (end_time - last_stats_time_ >= TOOLCALL_STATS_INTERVAL_US) {
+        last_stats_time_ = end_time;
+        ESP_LOGI(TAG, "Tool calls: %lu done, %lu failed, %lu timeout, %lu cancelled, %lu skipped, %lu rejected, "
+            "%lu hung, queue max %lu, wait avg/max %lld/%lld ms, run avg/max %lld/%lld ms",
+            stats_.completed, stats_.failed, stats_.timeouts, stats_.cancelled, stats_.skipped, stats_.rejected,
+            stats_.hung, stats_.max_queue_depth,
+            stats_.total_wait_us / stats_.completed / 1000, stats_.max_wait_us / 1000,
+            stats_.total_run_us / stats_.completed / 1000, stats_.max_run_us / 1000);
+    }
+}
+
+void McpToolExecutor::CheckDeadlines() {
+    std::vector<std::shared_ptr<Job>> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = esp_timer_get_time();
+        for (auto& job : in_flight_) {
+            if (now >= job->deadline && Finish(job)) {
+                expired.push_back(job);
+                stats_.timeouts++;
+                // 正在运行的调用无法被中断，它返回前继续占用该工具的并发槽位，新的调用会被拒绝；
+                // 仍在排队的调用不会再执行，槽位立即归还
+                if (job->started) {
+                    job->hung = true;
+                    stats_.hung++;
+                } else {
+                    ReleaseSlot(job);
+                }
+            }
+        }
+        if (in_flight_.empty()) {
+            esp_timer_stop(deadline_timer_);
+        }
+    }
+
+    // 工具本身无法被中断，仍会占用工作任务直到返回，但结果将被丢弃
+    for (auto& job : expired) {
+        ESP_LOGW(TAG, "Tool call %d (%s) timed out after %d ms", job->id, job->tool->name().c_str(),
+            job->tool->timeout_ms());
+        on_error_(job->id, "Tool call timed out after " + std::to_string(job->tool->timeout_ms()) + " ms");
+    }
+}
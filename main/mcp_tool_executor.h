@@ -0,0 +1,99 @@
+#ifndef MCP_TOOL_EXECUTOR_H
+#define MCP_TOOL_EXECUTOR_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mcp_server.h"
+
+// 工具调用执行器：固定数量的预分配工作任务，按栈大小分级，
+// 支持单工具并发上限、超时与取消
+class McpToolExecutor {
+public:
+    using ResultCallback = std::function<void(int id, const ReturnValue& value)>;
+    using ReplyCallback = std::function<void(int id, const std::string& message)>;
+
+    struct Stats {
+        uint32_t calls = 0;
+        uint32_t completed = 0;
+        uint32_t skipped = 0;   // Timed out or cancelled while queued, never ran
+        uint32_t failed = 0;
+        uint32_t timeouts = 0;
+        uint32_t cancelled = 0;
+        uint32_t rejected = 0;
+        uint32_t hung = 0;      // Workers still running a call that already timed out
+        uint32_t queue_depth = 0;
+        uint32_t max_queue_depth = 0;
+        int64_t total_wait_us = 0;
+        int64_t max_wait_us = 0;
+        int64_t total_run_us = 0;
+        int64_t max_run_us = 0;
+    };
+
+    McpToolExecutor(ResultCallback on_result, ReplyCallback on_error);
+    ~McpToolExecutor();
+
+    // Queue a call, returns false with an error message if it was rejected
+    bool Submit(int id, McpTool* tool, McpTool::ToolCall&& call, int stack_size, std::string& error);
+    // Drop the reply of a queued or running call, per notifications/cancelled
+    void Cancel(int id);
+
+private:
+    struct Job {
+        int id;
+        McpTool* tool;
+        McpTool::ToolCall call;
+        int64_t enqueue_time;
+        int64_t deadline;
+        std::atomic<bool> finished = false;
+        bool started = false;        // Guarded by mutex_
+        bool slot_released = false;  // Guarded by mutex_, tool_in_flight_ already decremented
+        bool hung = false;           // Guarded by mutex_, timed out while running, keeps its slot until it returns
+    };
+
+    struct WorkerClass {
+        size_t stack_size;
+        int workers;
+        std::deque<std::shared_ptr<Job>> queue;
+        std::condition_variable cv;
+    };
+
+    struct Worker {
+        McpToolExecutor* executor;
+        WorkerClass* worker_class;
+        TaskHandle_t task = nullptr;
+        StaticTask_t* task_buffer = nullptr;
+        StackType_t* task_stack = nullptr;
+    };
+
+    ResultCallback on_result_;
+    ReplyCallback on_error_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<WorkerClass>> classes_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::shared_ptr<Job>> in_flight_;
+    std::unordered_map<const McpTool*, int> tool_in_flight_;
+    esp_timer_handle_t deadline_timer_ = nullptr;
+    Stats stats_;
+    int64_t last_stats_time_ = 0;
+
+    void StartWorker(WorkerClass* worker_class);
+    void WorkerLoop(WorkerClass* worker_class);
+    void Run(const std::shared_ptr<Job>& job);
+    bool Finish(const std::shared_ptr<Job>& job);
+    void CheckDeadlines();
+    void ReleaseSlot(const std::shared_ptr<Job>& job);
+};
+
+#endif // MCP_TOOL_EXECUTOR_H
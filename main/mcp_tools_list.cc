@@ -0,0 +1,84 @@
+#include "mcp_tools_list.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "MCP"
+
+static char* CopyToPsram(const std::string& str) {
+    char* data = (char*)heap_caps_malloc(str.size() + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (data == nullptr) {
+        data = (char*)heap_caps_malloc(str.size() + 1, MALLOC_CAP_8BIT);
+    }
+    if (data != nullptr) {
+        memcpy(data, str.c_str(), str.size() + 1);
+    }
+    return data;
+}
+
+void McpToolsList::Clear() {
+    for (auto& page : pages_) {
+        heap_caps_free(page.data);
+    }
+    pages_.clear();
+}
+
+bool McpToolsList::Build(const std::vector<Tool>& tools) {
+    Clear();
+    size_t i = 0;
+    do {
+        Page page;
+        page.cursor = i < tools.size() ? *tools[i].name : "";
+
+        std::string json = "{\"tools\":[";
+        size_t first = i;
+        while (i < tools.size()) {
+            // 预留逗号与 nextCursor 字段的空间
+            if (json.length() + tools[i].json.length() + 31 > max_payload_size_) {
+                break;
+            }
+            if (i > first) {
+                json += ",";
+            }
+            json += tools[i].json;
+            ++i;
+        }
+
+        if (i == first && i < tools.size()) {
+            // 单个 tool 超出大小限制，后续分页无法到达
+            ESP_LOGE(TAG, "tools/list: Tool %s exceeds payload size limit", page.cursor.c_str());
+            pages_.push_back(std::move(page));
+            break;
+        }
+
+        if (i < tools.size()) {
+            json += "],\"nextCursor\":\"" + *tools[i].name + "\"}";
+        } else {
+            json += "]}";
+        }
+
+        page.data = CopyToPsram(json);
+        if (page.data == nullptr) {
+            ESP_LOGE(TAG, "tools/list: Failed to allocate %u bytes", (unsigned)json.size());
+            Clear();
+            return false;
+        }
+        page.size = json.size();
+        pages_.push_back(std::move(page));
+    } while (i < tools.size());
+    return true;
+}
+
+const McpToolsList::Page* McpToolsList::Find(const std::string& cursor) const {
+    if (pages_.empty()) {
+        return nullptr;
+    }
+    if (cursor.empty()) {
+        return &pages_.front();
+    }
+    auto page = std::find_if(pages_.begin(), pages_.end(), [&cursor](const Page& p) { return p.cursor == cursor; });
+    return page != pages_.end() ? &*page : nullptr;
+}
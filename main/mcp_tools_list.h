@@ -0,0 +1,48 @@
+#ifndef MCP_TOOLS_LIST_H
+#define MCP_TOOLS_LIST_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Paged tools/list results, serialized once and served from the cache.
+ *
+ * Each page is a complete tools/list result of at most `max_payload_size` bytes, with a
+ * nextCursor naming the first tool of the next page. Pages live in PSRAM when there is some.
+ * Not thread-safe, McpServer builds and serves it on the main loop.
+ */
+class McpToolsList {
+public:
+    struct Page {
+        std::string cursor;     // Name of the first tool on this page
+        char* data = nullptr;   // Serialized result, nullptr if the first tool does not fit
+        size_t size = 0;
+    };
+
+    struct Tool {
+        const std::string* name;
+        std::string json;  // The tool object as it appears in the tools array
+    };
+
+    explicit McpToolsList(size_t max_payload_size) : max_payload_size_(max_payload_size) {}
+    ~McpToolsList() { Clear(); }
+    McpToolsList(const McpToolsList&) = delete;
+    McpToolsList& operator=(const McpToolsList&) = delete;
+
+    // Tools in registration order. A tool too large for a page ends the list with a page without
+    // data. Returns false, with the cache empty, if a page could not be allocated
+    bool Build(const std::vector<Tool>& tools);
+    void Clear();
+    bool empty() const { return pages_.empty(); }
+
+    // The page starting at `cursor`, the first page for an empty cursor, nullptr if unknown
+    const Page* Find(const std::string& cursor) const;
+    const std::vector<Page>& pages() const { return pages_; }
+
+private:
+    size_t max_payload_size_;
+    std::vector<Page> pages_;
+};
+
+#endif // MCP_TOOLS_LIST_H
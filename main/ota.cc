@@ -1,4 +1,6 @@
 #include "ota.h"
+#include "ota_pipeline.h"
+#include "ota_resume.h"
 #include "system_info.h"
 #include "settings.h"
 #include "assets/lang_config.h"
@@ -10,6 +12,9 @@
 #include <esp_app_format.h>
 #include <esp_efuse.h>
 #include <esp_efuse_table.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <esp_delta_ota.h>
 #ifdef SOC_HMAC_SUPPORTED
 #include <esp_hmac.h>
 #endif
@@ -21,6 +26,150 @@
 
 #define TAG "Ota"
 
+// 下载与写 Flash 流水线：网络读取填充缓冲，独立任务写入分区
+#if CONFIG_SPIRAM
+#define OTA_BUFFER_SIZE (32 * 1024)
+#else
+#define OTA_BUFFER_SIZE (8 * 1024)
+#endif
+#define OTA_BUFFER_COUNT 2
+#define OTA_WRITER_STACK_SIZE 6144
+
+// 断点续传：已写入并校验的进度保存在 Settings 中，重试时通过 HTTP Range 继续下载
+#define OTA_RESUME_NAMESPACE "ota_resume"
+#define OTA_RESUME_SAVE_INTERVAL (256 * 1024)
+
+// 压缩或差分镜像：64 字节头部后跟 detools 补丁（heatshrink 压缩），
+// 压缩镜像即以空镜像为基础的补丁，由 scripts/release.py 生成
+#define OTA_PATCH_MAGIC "XZP1"
+
+struct OtaPatchHeader {
+    char magic[4];
+    uint32_t image_size;     // Size of the patched application image
+    char base_version[32];   // Version the delta applies to, empty for compressed images
+    uint8_t reserved[24];
+};
+static_assert(sizeof(OtaPatchHeader) == 64, "OtaPatchHeader must be 64 bytes");
+
+struct OtaWriter {
+    const esp_partition_t* partition = nullptr;
+    size_t image_size = 0;
+    esp_ota_handle_t handle = 0;
+    bool begun = false;
+    bool failed = false;
+    OtaResume* resume = nullptr;  // Hash of the written image and the resume point
+    bool patched = false;
+    bool header_skipped = false;
+    esp_delta_ota_handle_t patch_handle = nullptr;
+};
+
+static void SaveResumePoint(OtaResume* resume) {
+    Settings settings(OTA_RESUME_NAMESPACE, true);
+    settings.SetInt("offset", resume->offset() + resume->written());
+    settings.SetString("psha", resume->PrefixSha256());
+    // 设置默认延迟提交，下载期间写入会不断推迟提交：这里立即写入 NVS，掉电后才能续传
+    Settings::Flush();
+}
+
+static void ClearResumePoint() {
+    Settings settings(OTA_RESUME_NAMESPACE, true);
+    settings.EraseAll();
+}
+
+static int ReadRunningImage(uint8_t* buf, size_t size, int src_offset) {
+    if (size == 0) {
+        return 0;
+    }
+    return esp_partition_read(esp_ota_get_running_partition(), src_offset, buf, size);
+}
+
+static int WritePatchedImage(const uint8_t* buf, size_t size, void* user_data) {
+    auto writer = (OtaWriter*)user_data;
+    if (size == 0) {
+        return 0;
+    }
+    auto err = esp_ota_write(writer->handle, buf, size);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+        return err;
+    }
+    writer->resume->Update(buf, size);
+    return 0;
+}
+
+static bool WriteChunk(OtaWriter* writer, const uint8_t* data, size_t size) {
+    if (writer->patched) {
+        auto err = esp_delta_ota_feed_patch(writer->patch_handle, data, size);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to apply patch: %s", esp_err_to_name(err));
+            return false;
+        }
+        return true;
+    }
+
+    auto err = esp_ota_write(writer->handle, data, size);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+        return false;
+    }
+    if (writer->resume->Update(data, size)) {
+        SaveResumePoint(writer->resume);
+    }
+    return true;
+}
+
+// Runs on the pipeline's writer task for every buffer, in stream order
+static bool WriteToPartition(OtaWriter* writer, const uint8_t* data, size_t size) {
+    if (!writer->begun) {
+        auto begin_time = esp_timer_get_time();
+#if CONFIG_OTA_PRE_ERASE_PARTITION
+        size_t image_size = writer->image_size;
+#else
+        size_t image_size = OTA_WITH_SEQUENTIAL_WRITES;
+#endif
+        esp_err_t err;
+        if (writer->resume->offset() > 0) {
+            err = esp_ota_resume(writer->partition, image_size, writer->resume->offset(), &writer->handle);
+        } else {
+            err = esp_ota_begin(writer->partition, image_size, &writer->handle);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to begin OTA");
+            return false;
+        }
+        writer->begun = true;
+        ESP_LOGI(TAG, "OTA begin took %lld ms", (esp_timer_get_time() - begin_time) / 1000);
+
+        if (writer->patched) {
+            esp_delta_ota_cfg_t cfg = {
+                .user_data = writer,
+                .read_cb = ReadRunningImage,
+                .write_cb = WritePatchedImage,
+            };
+            writer->patch_handle = esp_delta_ota_init(&cfg);
+            if (writer->patch_handle == nullptr) {
+                ESP_LOGE(TAG, "Failed to initialize patch decoder");
+                return false;
+            }
+        }
+    }
+    // The patch header was already checked by the reader
+    size_t skip = writer->patched && !writer->header_skipped ? sizeof(OtaPatchHeader) : 0;
+    writer->header_skipped = true;
+    return WriteChunk(writer, data + skip, size - skip);
+}
+
+static void FinishPatch(OtaWriter* writer) {
+    if (writer->patch_handle == nullptr) {
+        return;
+    }
+    if (!writer->failed && esp_delta_ota_finalize(writer->patch_handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to finalize patch");
+        writer->failed = true;
+    }
+    esp_delta_ota_deinit(writer->patch_handle);
+    writer->patch_handle = nullptr;
+}
 
 Ota::Ota() {
 #ifdef ESP_EFUSE_BLOCK_USR_DATA
@@ -219,6 +368,15 @@ bool Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        cJSON *sha256 = cJSON_GetObjectItem(firmware, "sha256");
+        firmware_sha256_ = cJSON_IsString(sha256) ? sha256->valuestring : "";
+        // Optional smaller images, the full image at `url` stays the fallback
+        cJSON *delta_url = cJSON_GetObjectItem(firmware, "delta_url");
+        cJSON *delta_from = cJSON_GetObjectItem(firmware, "delta_from");
+        firmware_delta_url_ = cJSON_IsString(delta_url) ? delta_url->valuestring : "";
+        firmware_delta_from_ = cJSON_IsString(delta_from) ? delta_from->valuestring : "";
+        cJSON *compressed_url = cJSON_GetObjectItem(firmware, "compressed_url");
+        firmware_compressed_url_ = cJSON_IsString(compressed_url) ? compressed_url->valuestring : "";
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -262,9 +420,8 @@ void Ota::MarkCurrentVersionValid() {
     }
 }
 
-bool Ota::Upgrade(const std::string& firmware_url) {
-    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
-    esp_ota_handle_t update_handle = 0;
+bool Ota::Upgrade(const std::string& firmware_url, bool patched) {
+    ESP_LOGI(TAG, "Upgrading firmware from %s%s", firmware_url.c_str(), patched ? " (patch)" : "");
     auto update_partition = esp_ota_get_next_update_partition(NULL);
     if (update_partition == NULL) {
         ESP_LOGE(TAG, "Failed to get update partition");
@@ -272,87 +429,187 @@ bool Ota::Upgrade(const std::string& firmware_url) {
     }
 
     ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
-    std::string image_header;
+
+    OtaResume resume(OTA_RESUME_SAVE_INTERVAL);
+    OtaWriter writer;
+    writer.partition = update_partition;
+    writer.patched = patched;
+    writer.resume = &resume;
+
+    // 同一镜像且分区中已写入的内容校验通过时才续传
+    // 补丁解码状态无法恢复，压缩与差分镜像总是完整下载
+    size_t resume_offset = 0;
+    if (!patched) {
+        Settings settings(OTA_RESUME_NAMESPACE);
+        OtaResume::Point saved;
+        saved.url = settings.GetString("url");
+        saved.sha256 = settings.GetString("sha256");
+        saved.partition = (uint32_t)settings.GetInt("partition");
+        saved.size = settings.GetInt("size");
+        saved.offset = settings.GetInt("offset");
+        saved.prefix_sha256 = settings.GetString("psha");
+        OtaResume::Point current;
+        current.url = firmware_url;
+        current.sha256 = firmware_sha256_;
+        current.partition = update_partition->address;
+        resume_offset = resume.Begin(saved, current, [update_partition](size_t offset, uint8_t* data, size_t size) {
+            return esp_partition_read(update_partition, offset, data, size) == ESP_OK;
+        });
+    }
 
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(0);
+    if (resume_offset > 0) {
+        http->SetHeader("Range", "bytes=" + std::to_string(resume_offset) + "-");
+    }
     if (!http->Open("GET", firmware_url)) {
         ESP_LOGE(TAG, "Failed to open HTTP connection");
         return false;
     }
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
+    size_t content_length = http->GetBodyLength();
+    auto response = resume.CheckResponse(http->GetStatusCode(), content_length);
+    if (response == OtaResume::kResponseSizeChanged) {
+        // 镜像已变化，从头下载
+        http->Close();
+        ClearResumePoint();
+        return Upgrade(firmware_url);
+    }
+    if (response != OtaResume::kResponseOk) {
         return false;
     }
-
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
+    resume_offset = resume.offset();
+    size_t image_size = resume.size();
+    if (!patched && image_size > update_partition->size) {
+        ESP_LOGE(TAG, "Firmware size %u exceeds partition size %lu", image_size, update_partition->size);
         return false;
     }
 
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
+    if (!patched && resume_offset == 0) {
+        ClearResumePoint();
+        Settings settings(OTA_RESUME_NAMESPACE, true);
+        settings.SetString("url", firmware_url);
+        settings.SetString("sha256", firmware_sha256_);
+        settings.SetInt("size", image_size);
+        settings.SetInt("partition", update_partition->address);
+        Settings::Flush();
+    }
+
+    writer.image_size = image_size;
+
+    bool image_header_checked = resume_offset > 0;
+    bool retryable = true;  // Keep the resume point if only the connection failed
+    auto read = [&http](uint8_t* data, size_t size) {
+        int ret = http->Read((char*)data, size);
         if (ret < 0) {
             ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return false;
         }
-
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (upgrade_callback_) {
-                upgrade_callback_(progress, recent_read);
+        return ret;
+    };
+    auto inspect = [&](const uint8_t* data, size_t size) {
+        if (image_header_checked) {
+            return true;
+        }
+        image_header_checked = true;
+        if (patched) {
+            OtaPatchHeader header;
+            if (size < sizeof(header)) {
+                ESP_LOGE(TAG, "Patch is too small");
+                return false;
+            }
+            memcpy(&header, data, sizeof(header));
+            header.base_version[sizeof(header.base_version) - 1] = '\0';
+            if (memcmp(header.magic, OTA_PATCH_MAGIC, sizeof(header.magic)) != 0) {
+                ESP_LOGE(TAG, "Invalid patch header");
+                return false;
+            } else if (header.base_version[0] != '\0' && current_version_ != header.base_version) {
+                ESP_LOGE(TAG, "Patch is for version %s, running %s", header.base_version, current_version_.c_str());
+                return false;
+            } else if (header.image_size == 0 || header.image_size > update_partition->size) {
+                ESP_LOGE(TAG, "Invalid patched image size %lu", header.image_size);
+                return false;
             }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
+            ESP_LOGI(TAG, "Patch %u bytes, image %lu bytes", image_size, header.image_size);
+            writer.image_size = header.image_size;
+            return true;
         }
 
-        if (ret == 0) {
-            break;
+        if (size < sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+            ESP_LOGE(TAG, "Firmware image is too small");
+            retryable = false;
+            return false;
         }
+        esp_app_desc_t new_app_info;
+        memcpy(&new_app_info, data + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+        ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
+
+        auto current_version = esp_app_get_description()->version;
+        if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
+            ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
+            retryable = false;
+            return false;
+        }
+        return true;
+    };
+    auto write = [&writer](const uint8_t* data, size_t size) {
+        if (!WriteToPartition(&writer, data, size)) {
+            writer.failed = true;
+        }
+        return !writer.failed;
+    };
+    auto progress = [&](size_t total, size_t recent, const OtaPipeline::Stats& stats) {
+        size_t percent = (resume_offset + total) * 100 / image_size;
+        ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s, Stall: read %lld ms, write %lld ms",
+            percent, resume_offset + total, image_size, recent, stats.read_stall_us / 1000, stats.write_stall_us / 1000);
+        if (upgrade_callback_) {
+            upgrade_callback_(percent, recent);
+        }
+    };
 
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
-
-                auto current_version = esp_app_get_description()->version;
-                if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
-                    ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
-                    return false;
-                }
+    OtaPipeline pipeline(OTA_BUFFER_SIZE, OTA_BUFFER_COUNT, OTA_WRITER_STACK_SIZE);
+    bool success = pipeline.Run(read, inspect, write, progress);
+    http->Close();
+    FinishPatch(&writer);
 
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return false;
-                }
+    auto sha256 = resume.Finish();
 
-                image_header_checked = true;
-                std::string().swap(image_header);
-            }
+    auto& stats = pipeline.stats();
+    ESP_LOGI(TAG, "Downloaded %u bytes in %lld ms (%lld KB/s), flash write %lld ms, stall: read %lld ms, write %lld ms",
+        stats.bytes, stats.elapsed_us / 1000, stats.elapsed_us > 0 ? (int64_t)stats.bytes * 1000 / stats.elapsed_us : 0,
+        stats.write_us / 1000, stats.read_stall_us / 1000, stats.write_stall_us / 1000);
+
+    if (writer.failed) {
+        success = false;
+        retryable = false;
+    }
+    size_t expected_size = patched ? writer.image_size - resume_offset : content_length;
+    if (success && resume.written() != expected_size) {
+        ESP_LOGE(TAG, "Incomplete firmware: %u/%u bytes written", resume_offset + resume.written(), resume_offset + expected_size);
+        success = false;
+    }
+
+    if (success && !firmware_sha256_.empty()) {
+        if (strcasecmp(sha256.c_str(), firmware_sha256_.c_str()) != 0) {
+            ESP_LOGE(TAG, "SHA-256 mismatch: expected %s, got %s", firmware_sha256_.c_str(), sha256.c_str());
+            success = false;
+            retryable = false;
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
-            return false;
+    }
+
+    if (!success) {
+        if (writer.begun) {
+            esp_ota_abort(writer.handle);
+        }
+        if (!retryable && !patched) {
+            ClearResumePoint();
         }
+        return false;
     }
-    http->Close();
 
-    esp_err_t err = esp_ota_end(update_handle);
+    if (!patched) {
+        ClearResumePoint();
+    }
+    esp_err_t err = esp_ota_end(writer.handle);
     if (err != ESP_OK) {
         if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
             ESP_LOGE(TAG, "Image validation failed, image is corrupted");
@@ -374,7 +631,36 @@ bool Ota::Upgrade(const std::string& firmware_url) {
 
 bool Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
     upgrade_callback_ = callback;
-    return Upgrade(firmware_url_);
+
+    // 优先尝试差分与压缩镜像，失败后回退到完整镜像
+    if (!firmware_delta_url_.empty() && firmware_delta_from_ == current_version_) {
+        if (Upgrade(firmware_delta_url_, true)) {
+            return true;
+        }
+        ESP_LOGW(TAG, "Delta upgrade failed, falling back");
+    }
+    if (!firmware_compressed_url_.empty()) {
+        if (Upgrade(firmware_compressed_url_, true)) {
+            return true;
+        }
+        ESP_LOGW(TAG, "Compressed upgrade failed, falling back to full image");
+    }
+
+    const int max_attempts = 3;
+    for (int attempt = 1; attempt <= max_attempts; attempt++) {
+        if (Upgrade(firmware_url_)) {
+            return true;
+        }
+
+        // 仅在连接中断且有续传进度时重试
+        Settings settings(OTA_RESUME_NAMESPACE);
+        if (attempt == max_attempts || settings.GetInt("offset") == 0) {
+            break;
+        }
+        ESP_LOGW(TAG, "Upgrade interrupted, resuming in 3 seconds (attempt %d/%d)", attempt + 1, max_attempts);
+        vTaskDelay(pdMS_TO_TICKS(3000));
+    }
+    return false;
 }
 
 std::vector<int> Ota::ParseVersion(const std::string& version) {
@@ -3,6 +3,7 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 
 #include <esp_err.h>
 #include "board.h"
@@ -42,11 +43,15 @@ private:
     std::string current_version_;
     std::string firmware_version_;
     std::string firmware_url_;
+    std::string firmware_sha256_;
+    std::string firmware_delta_url_;       // Patch against firmware_delta_from_
+    std::string firmware_delta_from_;
+    std::string firmware_compressed_url_;  // Compressed full image
     std::string activation_challenge_;
     std::string serial_number_;
     int activation_timeout_ms_ = 30000;
 
-    bool Upgrade(const std::string& firmware_url);
+    bool Upgrade(const std::string& firmware_url, bool patched = false);
     std::function<void(int progress, size_t speed)> upgrade_callback_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
@@ -0,0 +1,165 @@
+#include "ota_pipeline.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <vector>
+
+#define TAG "OtaPipeline"
+
+#define OTA_PROGRESS_INTERVAL_US (1000 * 1000)
+
+namespace {
+
+struct Chunk {
+    uint8_t* data;
+    size_t size;  // 0 ends the stream
+};
+
+struct Writer {
+    const OtaPipeline::WriteCallback* write;
+    QueueHandle_t free_queue;
+    QueueHandle_t filled_queue;
+    SemaphoreHandle_t done;
+    volatile bool failed = false;
+    int64_t stall_us = 0;
+    int64_t write_us = 0;
+};
+
+void WriterTask(void* arg) {
+    auto writer = (Writer*)arg;
+    while (true) {
+        Chunk chunk;
+        auto wait_start = esp_timer_get_time();
+        xQueueReceive(writer->filled_queue, &chunk, portMAX_DELAY);
+        auto write_start = esp_timer_get_time();
+        writer->stall_us += write_start - wait_start;
+        if (chunk.size == 0) {
+            break;
+        }
+
+        // 失败后继续归还缓冲，读取方据此停止
+        if (!writer->failed && !(*writer->write)(chunk.data, chunk.size)) {
+            writer->failed = true;
+        }
+        writer->write_us += esp_timer_get_time() - write_start;
+        xQueueSend(writer->free_queue, &chunk, portMAX_DELAY);
+    }
+    xSemaphoreGive(writer->done);
+    vTaskDelete(NULL);
+}
+
+}  // namespace
+
+OtaPipeline::OtaPipeline(size_t buffer_size, int buffer_count, int writer_stack_size)
+    : buffer_size_(buffer_size), buffer_count_(buffer_count), writer_stack_size_(writer_stack_size) {
+}
+
+bool OtaPipeline::Run(const ReadCallback& read, const InspectCallback& inspect, const WriteCallback& write,
+                      const ProgressCallback& progress) {
+    stats_ = Stats();
+
+    // 缓冲优先放在 PSRAM，esp_ota_write 会经内部 RAM 中转写入 Flash
+    std::vector<uint8_t*> buffers(buffer_count_, nullptr);
+    for (auto& buffer : buffers) {
+        buffer = (uint8_t*)heap_caps_malloc(buffer_size_, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (buffer == nullptr) {
+            buffer = (uint8_t*)heap_caps_malloc(buffer_size_, MALLOC_CAP_8BIT);
+        }
+        if (buffer == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate OTA buffer");
+            for (auto b : buffers) {
+                heap_caps_free(b);
+            }
+            return false;
+        }
+    }
+
+    Writer writer;
+    writer.write = &write;
+    writer.free_queue = xQueueCreate(buffer_count_, sizeof(Chunk));
+    writer.filled_queue = xQueueCreate(buffer_count_ + 1, sizeof(Chunk));
+    writer.done = xSemaphoreCreateBinary();
+    for (auto buffer : buffers) {
+        Chunk chunk = { buffer, 0 };
+        xQueueSend(writer.free_queue, &chunk, 0);
+    }
+    xTaskCreate(WriterTask, "ota_writer", writer_stack_size_, &writer, 5, NULL);
+
+    bool success = true;
+    bool eof = false;
+    size_t recent = 0;
+    auto start_time = esp_timer_get_time();
+    auto last_progress_time = start_time;
+    while (success && !eof) {
+        // 等待空闲缓冲的时间即网络被 Flash 写入阻塞的时间
+        Chunk chunk;
+        auto wait_start = esp_timer_get_time();
+        xQueueReceive(writer.free_queue, &chunk, portMAX_DELAY);
+        stats_.read_stall_us += esp_timer_get_time() - wait_start;
+        chunk.size = 0;
+
+        while (chunk.size < buffer_size_ && !writer.failed) {
+            int ret = read(chunk.data + chunk.size, buffer_size_ - chunk.size);
+            if (ret < 0) {
+                success = false;
+                break;
+            }
+            chunk.size += ret;
+            recent += ret;
+            stats_.bytes += ret;
+            eof = ret == 0;
+
+            auto now = esp_timer_get_time();
+            if (now - last_progress_time >= OTA_PROGRESS_INTERVAL_US || eof) {
+                stats_.elapsed_us = now - start_time;
+                stats_.write_stall_us = writer.stall_us;
+                if (progress) {
+                    progress(stats_.bytes, recent, stats_);
+                }
+                last_progress_time = now;
+                recent = 0;
+            }
+            if (eof) {
+                break;
+            }
+        }
+
+        if (writer.failed) {
+            success = false;
+        }
+        if (success && chunk.size > 0 && inspect && !inspect(chunk.data, chunk.size)) {
+            success = false;
+        }
+        if (!success || chunk.size == 0) {
+            xQueueSend(writer.free_queue, &chunk, 0);
+        } else {
+            xQueueSend(writer.filled_queue, &chunk, portMAX_DELAY);
+        }
+    }
+
+    // Flush the pipeline and wait for the writer task to exit
+    Chunk end = { nullptr, 0 };
+    xQueueSend(writer.filled_queue, &end, portMAX_DELAY);
+    xSemaphoreTake(writer.done, portMAX_DELAY);
+    if (writer.failed) {
+        success = false;
+    }
+
+    vSemaphoreDelete(writer.done);
+    vQueueDelete(writer.filled_queue);
+    vQueueDelete(writer.free_queue);
+    for (auto buffer : buffers) {
+        heap_caps_free(buffer);
+    }
+
+    stats_.elapsed_us = esp_timer_get_time() - start_time;
+    stats_.write_stall_us = writer.stall_us;
+    stats_.write_us = writer.write_us;
+    return success;
+}
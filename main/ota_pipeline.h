@@ -0,0 +1,50 @@
+#ifndef _OTA_PIPELINE_H
+#define _OTA_PIPELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/*
+ * Download/flash-write pipeline used by Ota::Upgrade.
+ *
+ * The calling task fills large buffers from the network while a separate writer task drains
+ * them, so flash erase/write stalls don't block the socket. Time spent waiting on either side is
+ * accumulated in Stats.
+ */
+class OtaPipeline {
+public:
+    struct Stats {
+        size_t bytes = 0;
+        int64_t elapsed_us = 0;
+        int64_t read_stall_us = 0;   // Reader waiting for a free buffer (flash is the bottleneck)
+        int64_t write_stall_us = 0;  // Writer waiting for a filled buffer (network is the bottleneck)
+        int64_t write_us = 0;
+    };
+
+    // Fill up to `size` bytes, returns the bytes read, 0 at the end of the stream or negative on error
+    using ReadCallback = std::function<int(uint8_t* data, size_t size)>;
+    // Called on the reader side for every filled buffer before it is queued, false stops the pipeline
+    using InspectCallback = std::function<bool(const uint8_t* data, size_t size)>;
+    // Called on the writer task in stream order, false stops the pipeline
+    using WriteCallback = std::function<bool(const uint8_t* data, size_t size)>;
+    // Called on the reader side about once a second and at the end of the stream
+    using ProgressCallback = std::function<void(size_t total, size_t recent, const Stats& stats)>;
+
+    OtaPipeline(size_t buffer_size, int buffer_count, int writer_stack_size);
+
+    // Returns true if the stream ended and every buffer was inspected and written.
+    // The writer task has exited when this returns.
+    bool Run(const ReadCallback& read, const InspectCallback& inspect, const WriteCallback& write,
+             const ProgressCallback& progress);
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    size_t buffer_size_;
+    int buffer_count_;
+    int writer_stack_size_;
+    Stats stats_;
+};
+
+#endif // _OTA_PIPELINE_H
@@ -0,0 +1,116 @@
+#include "ota_resume.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#define TAG "OtaResume"
+
+#define OTA_RESUME_BLOCK_SIZE 4096
+
+static std::string Sha256Hex(const uint8_t* digest) {
+    char hex[65];
+    for (int i = 0; i < 32; i++) {
+        snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    }
+    return std::string(hex, 64);
+}
+
+OtaResume::OtaResume(size_t save_interval) : save_interval_(save_interval), next_save_(save_interval) {
+    mbedtls_sha256_init(&sha256_);
+    mbedtls_sha256_starts(&sha256_, 0);
+}
+
+OtaResume::~OtaResume() {
+    mbedtls_sha256_free(&sha256_);
+}
+
+void OtaResume::Restart() {
+    mbedtls_sha256_free(&sha256_);
+    mbedtls_sha256_init(&sha256_);
+    mbedtls_sha256_starts(&sha256_, 0);
+    offset_ = 0;
+    written_ = 0;
+    next_save_ = save_interval_;
+}
+
+size_t OtaResume::Begin(const Point& saved, const Point& current, const ReadCallback& read_partition) {
+    if (saved.offset == 0 || saved.offset >= saved.size || saved.url != current.url ||
+        saved.sha256 != current.sha256 || saved.partition != current.partition) {
+        return 0;
+    }
+
+    // Re-hash the partial image in the partition, the context then continues from its end
+    auto block = (uint8_t*)heap_caps_malloc(OTA_RESUME_BLOCK_SIZE, MALLOC_CAP_8BIT);
+    if (block == nullptr) {
+        return 0;
+    }
+    bool read = true;
+    for (size_t offset = 0; read && offset < saved.offset; offset += OTA_RESUME_BLOCK_SIZE) {
+        size_t length = std::min<size_t>(OTA_RESUME_BLOCK_SIZE, saved.offset - offset);
+        read = read_partition(offset, block, length);
+        mbedtls_sha256_update(&sha256_, block, length);
+    }
+    heap_caps_free(block);
+
+    offset_ = saved.offset;
+    if (!read || PrefixSha256() != saved.prefix_sha256) {
+        ESP_LOGW(TAG, "Partial image does not match, starting over");
+        Restart();
+        return 0;
+    }
+    ESP_LOGI(TAG, "Resuming download at %u/%u", (unsigned)saved.offset, (unsigned)saved.size);
+    size_ = saved.size;
+    return offset_;
+}
+
+OtaResume::Response OtaResume::CheckResponse(int status_code, size_t content_length) {
+    if (offset_ > 0 && status_code == 206 && offset_ + content_length != size_) {
+        ESP_LOGW(TAG, "Firmware size changed, starting over");
+        Restart();
+        return kResponseSizeChanged;
+    }
+    if (offset_ > 0 && status_code == 200) {
+        ESP_LOGW(TAG, "Server does not support range requests, starting over");
+        Restart();
+    }
+    if (status_code != (offset_ > 0 ? 206 : 200)) {
+        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", status_code);
+        return kResponseFailed;
+    }
+    if (content_length == 0) {
+        ESP_LOGE(TAG, "Failed to get content length");
+        return kResponseFailed;
+    }
+    size_ = offset_ + content_length;
+    return kResponseOk;
+}
+
+bool OtaResume::Update(const uint8_t* data, size_t size) {
+    mbedtls_sha256_update(&sha256_, data, size);
+    written_ += size;
+    if (written_ < next_save_) {
+        return false;
+    }
+    next_save_ = written_ + save_interval_;
+    return true;
+}
+
+std::string OtaResume::PrefixSha256() {
+    // Hash of the prefix, the running context keeps going
+    uint8_t digest[32];
+    mbedtls_sha256_context prefix;
+    mbedtls_sha256_init(&prefix);
+    mbedtls_sha256_clone(&prefix, &sha256_);
+    mbedtls_sha256_finish(&prefix, digest);
+    mbedtls_sha256_free(&prefix);
+    return Sha256Hex(digest);
+}
+
+std::string OtaResume::Finish() {
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha256_, digest);
+    return Sha256Hex(digest);
+}
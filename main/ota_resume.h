@@ -0,0 +1,69 @@
+#ifndef _OTA_RESUME_H
+#define _OTA_RESUME_H
+
+#include <mbedtls/sha256.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/*
+ * Resume bookkeeping for Ota::Upgrade.
+ *
+ * Keeps the SHA-256 of everything written to the update partition. Every `save_interval` bytes
+ * the caller persists offset() + written() and PrefixSha256(); after an interrupted download
+ * the partition prefix is re-hashed and the download continues with an HTTP Range request only
+ * if it still matches. Persistence and partition access stay with the caller.
+ */
+class OtaResume {
+public:
+    struct Point {
+        std::string url;
+        std::string sha256;          // Expected hash of the whole image, may be empty
+        uint32_t partition = 0;      // Address of the update partition
+        size_t size = 0;             // Size of the whole image
+        size_t offset = 0;           // Bytes written and hashed, 0 = nothing to resume
+        std::string prefix_sha256;   // Hash of the first `offset` bytes
+    };
+
+    enum Response {
+        kResponseOk,           // Write the body at offset()
+        kResponseSizeChanged,  // The image behind the URL changed, clear the point and start over
+        kResponseFailed,
+    };
+
+    // Read `size` bytes of the update partition at `offset`
+    using ReadCallback = std::function<bool(size_t offset, uint8_t* data, size_t size)>;
+
+    explicit OtaResume(size_t save_interval);
+    ~OtaResume();
+
+    // `saved` must describe the download of `current` (url, sha256, partition) and its prefix
+    // must hash to the saved value. Returns the offset for the Range request, 0 = from the start
+    size_t Begin(const Point& saved, const Point& current, const ReadCallback& read_partition);
+    // Status and body length of the response to the request Begin() chose
+    Response CheckResponse(int status_code, size_t content_length);
+
+    // Hash bytes written after offset(), returns true when a resume point is due
+    bool Update(const uint8_t* data, size_t size);
+    std::string PrefixSha256();
+    // Hash of the whole image, call once at the end
+    std::string Finish();
+
+    size_t offset() const { return offset_; }
+    size_t written() const { return written_; }
+    size_t size() const { return size_; }
+
+private:
+    size_t save_interval_;
+    mbedtls_sha256_context sha256_;
+    size_t offset_ = 0;
+    size_t size_ = 0;
+    size_t written_ = 0;
+    size_t next_save_;
+
+    void Restart();
+};
+
+#endif // _OTA_RESUME_H
@@ -137,11 +137,21 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
 }
 
 bool MqttProtocol::SendText(const std::string& text) {
+    return Publish(std::string(text));
+}
+
+void MqttProtocol::SendMcpMessage(MessageBuffer& message) {
+    // Publish 按值接收负载：直接移交缓冲中的字符串，不再复制一份
+    WrapMcpMessage(message);
+    Publish(message.Detach());
+}
+
+bool MqttProtocol::Publish(std::string&& text) {
     if (publish_topic_.empty()) {
         return false;
     }
-    if (!mqtt_->Publish(publish_topic_, text)) {
-        ESP_LOGE(TAG, "Failed to publish message: %s", text.c_str());
+    if (!mqtt_->Publish(publish_topic_, std::move(text))) {
+        ESP_LOGE(TAG, "Failed to publish message");
         SetError(Lang::Strings::SERVER_ERROR);
         return false;
     }
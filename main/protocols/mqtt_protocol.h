@@ -31,6 +31,7 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    void SendMcpMessage(MessageBuffer& message) override;
 
 private:
     EventGroupHandle_t event_group_handle_;
@@ -53,6 +54,7 @@ private:
     std::string DecodeHexString(const std::string& hex_string);
 
     bool SendText(const std::string& text) override;
+    bool Publish(std::string&& text);
     std::string GetHelloMessage();
 };
 
@@ -1,9 +1,69 @@
 #include "protocol.h"
 
 #include <esp_log.h>
+#include <cstring>
+#include <mutex>
 
 #define TAG "Protocol"
 
+#define MESSAGE_BUFFER_POOL_SIZE 2
+#define MESSAGE_BUFFER_POOL_MAX_CAPACITY (16 * 1024)
+
+static std::mutex message_buffer_pool_mutex;
+static std::vector<MessageBuffer*> message_buffer_pool;
+
+std::shared_ptr<MessageBuffer> MessageBuffer::Acquire(size_t body_capacity) {
+    MessageBuffer* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(message_buffer_pool_mutex);
+        if (!message_buffer_pool.empty()) {
+            buffer = message_buffer_pool.back();
+            message_buffer_pool.pop_back();
+        }
+    }
+    if (buffer == nullptr) {
+        buffer = new MessageBuffer();
+    }
+    buffer->Reset(body_capacity);
+
+    return std::shared_ptr<MessageBuffer>(buffer, [](MessageBuffer* buffer) {
+        // 只回收较小的缓冲，避免大结果长期占用内存
+        if (buffer->data_.capacity() <= MESSAGE_BUFFER_POOL_MAX_CAPACITY) {
+            std::lock_guard<std::mutex> lock(message_buffer_pool_mutex);
+            if (message_buffer_pool.size() < MESSAGE_BUFFER_POOL_SIZE) {
+                message_buffer_pool.push_back(buffer);
+                return;
+            }
+        }
+        delete buffer;
+    });
+}
+
+void MessageBuffer::Reset(size_t body_capacity) {
+    // Extra room for the closing brace of the envelope
+    data_.clear();
+    data_.reserve(kHeadroom + body_capacity + 8);
+    data_.append(kHeadroom, ' ');
+    offset_ = kHeadroom;
+}
+
+void MessageBuffer::Prepend(const std::string& head) {
+    if (head.size() <= offset_) {
+        offset_ -= head.size();
+        memcpy(&data_[offset_], head.data(), head.size());
+    } else {
+        data_.replace(0, offset_, head);
+        offset_ = 0;
+    }
+}
+
+std::string MessageBuffer::Detach() {
+    // 在原缓冲内前移，不分配新内存
+    data_.erase(0, offset_);
+    offset_ = 0;
+    return std::move(data_);
+}
+
 void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
@@ -73,9 +133,18 @@ void Protocol::SendStopListening() {
     SendText(message);
 }
 
-void Protocol::SendMcpMessage(const std::string& payload) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"payload\":" + payload + "}";
-    SendText(message);
+void Protocol::WrapMcpMessage(MessageBuffer& message) {
+    message.Prepend("{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"payload\":");
+    message.body() += "}";
+}
+
+void Protocol::SendMcpMessage(MessageBuffer& message) {
+    WrapMcpMessage(message);
+    SendRawText(message.data(), message.size());
+}
+
+bool Protocol::SendRawText(const char* data, size_t size) {
+    return SendText(std::string(data, size));
 }
 
 bool Protocol::IsTimeout() const {
@@ -6,6 +6,7 @@
 #include <functional>
 #include <chrono>
 #include <vector>
+#include <memory>
 
 struct AudioStreamPacket {
     int sample_rate = 0;
@@ -14,6 +15,31 @@ struct AudioStreamPacket {
     std::vector<uint8_t> payload;
 };
 
+// 发送缓冲：正文前预留头部空间，协议层就地写入会话信封，正文不再被复制
+class MessageBuffer {
+public:
+    static constexpr size_t kHeadroom = 96;
+
+    // Take a buffer from the pool, it goes back when the last reference is dropped
+    static std::shared_ptr<MessageBuffer> Acquire(size_t body_capacity);
+
+    // Append only, the headroom stays in front of the body
+    inline std::string& body() { return data_; }
+    inline const char* data() const { return data_.data() + offset_; }
+    inline size_t size() const { return data_.size() - offset_; }
+    void Prepend(const std::string& head);
+    // Move the envelope and body out as one string for transports that take ownership,
+    // the buffer is empty afterwards
+    std::string Detach();
+
+private:
+    std::string data_;
+    size_t offset_ = kHeadroom;
+
+    MessageBuffer() = default;
+    void Reset(size_t body_capacity);
+};
+
 struct BinaryProtocol2 {
     uint16_t version;
     uint16_t type;          // Message type (0: OPUS, 1: JSON)
@@ -72,7 +98,7 @@ public:
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
-    virtual void SendMcpMessage(const std::string& message);
+    virtual void SendMcpMessage(MessageBuffer& message);
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
@@ -90,6 +116,10 @@ protected:
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
 
     virtual bool SendText(const std::string& text) = 0;
+    // Send a text frame without copying it into a std::string first, if the transport allows
+    virtual bool SendRawText(const char* data, size_t size);
+    // Write the session envelope around an MCP payload in the buffer's headroom
+    void WrapMcpMessage(MessageBuffer& message);
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
 };
@@ -5,6 +5,7 @@
 #include "settings.h"
 
 #include <cstring>
+#include <algorithm>
 #include <cJSON.h>
 #include <esp_log.h>
 #include <arpa/inet.h>
@@ -71,6 +72,20 @@ bool WebsocketProtocol::SendText(const std::string& text) {
     return true;
 }
 
+bool WebsocketProtocol::SendRawText(const char* data, size_t size) {
+    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+        return false;
+    }
+
+    if (!websocket_->Send(data, size, false)) {
+        ESP_LOGE(TAG, "Failed to send text: %.*s", (int)std::min<size_t>(size, 256), data);
+        SetError(Lang::Strings::SERVER_ERROR);
+        return false;
+    }
+
+    return true;
+}
+
 bool WebsocketProtocol::IsAudioChannelOpened() const {
     return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
 }
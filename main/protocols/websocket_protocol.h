@@ -28,6 +28,7 @@ private:
 
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
+    bool SendRawText(const char* data, size_t size) override;
     std::string GetHelloMessage();
 };
 
@@ -1,88 +1,419 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <mutex>
+#include <vector>
 
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
-}
+#define SETTINGS_COMMIT_DELAY_US (2 * 1000 * 1000)
+// 持续修改时也不会无限推迟：第一次未提交的修改最多等待这么久
+#define SETTINGS_COMMIT_MAX_LATENCY_US (10 * 1000 * 1000)
+#define SETTINGS_SHUTDOWN_LOCK_TIMEOUT_MS 100
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+namespace {
+
+enum SettingType {
+    kSettingTypeInt,
+    kSettingTypeBool,
+    kSettingTypeString
+};
+
+struct SettingValue {
+    SettingType type = kSettingTypeInt;
+    int32_t int_value = 0;
+    std::string string_value;
+
+    bool operator==(const SettingValue& other) const {
+        return type == other.type && int_value == other.int_value && string_value == other.string_value;
+    }
+};
+
+struct SettingsNamespace {
+    std::map<std::string, SettingValue> values;
+    std::set<std::string> dirty_keys;  // Keys missing from values are erased on commit
+    bool erase_all = false;
+};
+
+class SettingsStore {
+public:
+    static SettingsStore& GetInstance() {
+        static SettingsStore instance;
+        return instance;
+    }
+
+    bool Get(const std::string& ns, const std::string& key, SettingType type, SettingValue& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto space = Load(ns);
+        if (space == nullptr) {
+            return false;
+        }
+        auto it = space->values.find(key);
+        if (it == space->values.end() || it->second.type != type) {
+            return false;
         }
-        nvs_close(nvs_handle_);
+        value = it->second;
+        return true;
     }
-}
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+    void Set(const std::string& ns, const std::string& key, SettingValue&& value) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto space = Load(ns);
+            if (space == nullptr) {
+                ESP_LOGE(TAG, "Namespace %s is unavailable, dropping %s", ns.c_str(), key.c_str());
+                return;
+            }
+            auto it = space->values.find(key);
+            if (it != space->values.end() && it->second == value) {
+                return;
+            }
+            space->values[key] = std::move(value);
+            space->dirty_keys.insert(key);
+            ScheduleCommit();
+        }
+        NotifyChange(ns, key);
     }
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+    void Erase(const std::string& ns, const std::string& key) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto space = Load(ns);
+            if (space == nullptr) {
+                ESP_LOGE(TAG, "Namespace %s is unavailable, not erasing %s", ns.c_str(), key.c_str());
+                return;
+            }
+            if (space->values.erase(key) == 0) {
+                return;
+            }
+            space->dirty_keys.insert(key);
+            ScheduleCommit();
+        }
+        NotifyChange(ns, key);
     }
 
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    void EraseAll(const std::string& ns) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto space = Load(ns);
+            if (space == nullptr) {
+                ESP_LOGE(TAG, "Namespace %s is unavailable, not erasing", ns.c_str());
+                return;
+            }
+            space->values.clear();
+            space->dirty_keys.clear();
+            space->erase_all = true;
+            ScheduleCommit();
+        }
+        NotifyChange(ns, "");
     }
-    return value;
+
+    void AddListener(const std::string& ns, Settings::ChangeCallback callback) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        listeners_.emplace_back(ns, callback);
+    }
+
+    void Flush() {
+        // 提交期间持有锁，避免与并发修改交错；积攒的写入量很小
+        std::lock_guard<std::mutex> lock(mutex_);
+        Commit();
+    }
+
+    // NVS was erased underneath the cache: forget every value and pending change
+    void Discard() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        esp_timer_stop(commit_timer_);
+        namespaces_.clear();
+        first_change_time_ = 0;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, SettingsNamespace> namespaces_;
+    std::vector<std::pair<std::string, Settings::ChangeCallback>> listeners_;
+    esp_timer_handle_t commit_timer_ = nullptr;
+    int64_t first_change_time_ = 0;  // Oldest uncommitted change, 0 if none
+
+    // NVS operation counters
+    uint32_t nvs_opens_ = 0;
+    uint32_t nvs_reads_ = 0;
+    uint32_t nvs_writes_ = 0;
+    uint32_t nvs_commits_ = 0;
+
+    SettingsStore() {
+        esp_timer_create_args_t timer_args = {
+            .callback = [](void* arg) {
+                static_cast<SettingsStore*>(arg)->Flush();
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "settings_commit",
+            .skip_unhandled_events = true,
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &commit_timer_));
+
+        // Pending changes must reach flash before esp_restart()
+        esp_register_shutdown_handler([]() {
+            SettingsStore::GetInstance().FlushOnShutdown();
+        });
+    }
+
+    // The restarting task may be the one holding the lock, so don't wait for it indefinitely
+    void FlushOnShutdown() {
+        std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+        for (int i = 0; i < SETTINGS_SHUTDOWN_LOCK_TIMEOUT_MS && !lock.owns_lock(); i++) {
+            vTaskDelay(pdMS_TO_TICKS(1));
+            lock.try_lock();
+        }
+        if (!lock.owns_lock()) {
+            ESP_LOGW(TAG, "Settings are busy, pending changes are not committed");
+            return;
+        }
+        Commit();
+    }
+
+    void ScheduleCommit() {
+        // Debounce: commit once the values stop changing, but no later than the maximum latency
+        auto now = esp_timer_get_time();
+        if (first_change_time_ == 0) {
+            first_change_time_ = now;
+        }
+        int64_t delay = std::min<int64_t>(SETTINGS_COMMIT_DELAY_US,
+            first_change_time_ + SETTINGS_COMMIT_MAX_LATENCY_US - now);
+        esp_timer_stop(commit_timer_);
+        esp_timer_start_once(commit_timer_, std::max<int64_t>(delay, 0));
+    }
+
+    // Called with mutex_ held. Keys that fail to commit stay dirty and are retried on the next commit.
+    void Commit() {
+        esp_timer_stop(commit_timer_);
+        first_change_time_ = 0;
+
+        int changes = 0;
+        int failures = 0;
+        for (auto& [ns, space] : namespaces_) {
+            if (!space.erase_all && space.dirty_keys.empty()) {
+                continue;
+            }
+
+            nvs_handle_t handle;
+            nvs_opens_++;
+            auto err = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to open namespace %s for writing: %s", ns.c_str(), esp_err_to_name(err));
+                failures++;
+                continue;
+            }
+            if (space.erase_all) {
+                nvs_writes_++;
+                err = nvs_erase_all(handle);
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to erase namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+                    nvs_close(handle);
+                    failures++;
+                    continue;
+                }
+            }
+
+            std::set<std::string> failed_keys;
+            for (auto& key : space.dirty_keys) {
+                nvs_writes_++;
+                auto it = space.values.find(key);
+                if (it == space.values.end()) {
+                    err = nvs_erase_key(handle, key.c_str());
+                    if (err == ESP_ERR_NVS_NOT_FOUND) {
+                        err = ESP_OK;
+                    }
+                } else if (it->second.type == kSettingTypeInt) {
+                    err = nvs_set_i32(handle, key.c_str(), it->second.int_value);
+                } else if (it->second.type == kSettingTypeBool) {
+                    err = nvs_set_u8(handle, key.c_str(), it->second.int_value ? 1 : 0);
+                } else {
+                    err = nvs_set_str(handle, key.c_str(), it->second.string_value.c_str());
+                }
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to write %s.%s: %s", ns.c_str(), key.c_str(), esp_err_to_name(err));
+                    failed_keys.insert(key);
+                    failures++;
+                } else {
+                    changes++;
+                }
+            }
+            nvs_commits_++;
+            err = nvs_commit(handle);
+            nvs_close(handle);
+            if (err != ESP_OK) {
+                // Nothing is known to be on flash, keep everything dirty
+                ESP_LOGE(TAG, "Failed to commit namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+                failures++;
+                continue;
+            }
+
+            space.dirty_keys.swap(failed_keys);
+            space.erase_all = false;
+        }
+
+        if (changes > 0 || failures > 0) {
+            ESP_LOGI(TAG, "Committed %d changes, %d failed, NVS: %lu opens, %lu reads, %lu writes, %lu commits",
+                changes, failures, nvs_opens_, nvs_reads_, nvs_writes_, nvs_commits_);
+        }
+    }
+
+    void NotifyChange(const std::string& ns, const std::string& key) {
+        std::vector<Settings::ChangeCallback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& [listener_ns, callback] : listeners_) {
+                if (listener_ns == ns) {
+                    callbacks.push_back(callback);
+                }
+            }
+        }
+        for (auto& callback : callbacks) {
+            callback(ns, key);
+        }
+    }
+
+    // Returns nullptr if the namespace can't be read, nothing is cached in that case
+    SettingsNamespace* Load(const std::string& ns) {
+        auto it = namespaces_.find(ns);
+        if (it != namespaces_.end()) {
+            return &it->second;
+        }
+
+        SettingsNamespace space;
+        nvs_handle_t handle;
+        nvs_opens_++;
+        auto err = nvs_open(ns.c_str(), NVS_READONLY, &handle);
+        if (err == ESP_OK) {
+            nvs_iterator_t iterator = nullptr;
+            auto ret = nvs_entry_find_in_handle(handle, NVS_TYPE_ANY, &iterator);
+            while (ret == ESP_OK) {
+                nvs_entry_info_t info;
+                nvs_entry_info(iterator, &info);
+                SettingValue value;
+                bool supported = true;
+                nvs_reads_++;
+                if (info.type == NVS_TYPE_I32) {
+                    value.type = kSettingTypeInt;
+                    supported = nvs_get_i32(handle, info.key, &value.int_value) == ESP_OK;
+                } else if (info.type == NVS_TYPE_U8) {
+                    uint8_t u8 = 0;
+                    value.type = kSettingTypeBool;
+                    supported = nvs_get_u8(handle, info.key, &u8) == ESP_OK;
+                    value.int_value = u8 != 0;
+                } else if (info.type == NVS_TYPE_STR) {
+                    size_t length = 0;
+                    value.type = kSettingTypeString;
+                    supported = nvs_get_str(handle, info.key, nullptr, &length) == ESP_OK;
+                    if (supported) {
+                        value.string_value.resize(length);
+                        supported = nvs_get_str(handle, info.key, value.string_value.data(), &length) == ESP_OK;
+                        while (!value.string_value.empty() && value.string_value.back() == '\0') {
+                            value.string_value.pop_back();
+                        }
+                    }
+                } else {
+                    supported = false;
+                }
+                if (supported) {
+                    space.values[info.key] = std::move(value);
+                }
+                ret = nvs_entry_next(&iterator);
+            }
+            nvs_release_iterator(iterator);
+            nvs_close(handle);
+        } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+            // NVS is not ready yet, do not cache an empty namespace
+            ESP_LOGW(TAG, "Failed to open namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+            return nullptr;
+        }
+
+        return &namespaces_.emplace(ns, std::move(space)).first->second;
+    }
+};
+
+} // namespace
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+Settings::~Settings() {
+}
+
+void Settings::Flush() {
+    SettingsStore::GetInstance().Flush();
+}
+
+void Settings::Discard() {
+    SettingsStore::GetInstance().Discard();
+}
+
+void Settings::OnChange(const std::string& ns, ChangeCallback callback) {
+    SettingsStore::GetInstance().AddListener(ns, callback);
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    SettingValue value;
+    if (!SettingsStore::GetInstance().Get(ns_, key, kSettingTypeString, value)) {
+        return default_value;
+    }
+    return value.string_value;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        SettingValue setting;
+        setting.type = kSettingTypeString;
+        setting.string_value = value;
+        SettingsStore::GetInstance().Set(ns_, key, std::move(setting));
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    SettingValue value;
+    if (!SettingsStore::GetInstance().Get(ns_, key, kSettingTypeInt, value)) {
         return default_value;
     }
-    return value;
+    return value.int_value;
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        SettingValue setting;
+        setting.type = kSettingTypeInt;
+        setting.int_value = value;
+        SettingsStore::GetInstance().Set(ns_, key, std::move(setting));
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
+    SettingValue value;
+    if (!SettingsStore::GetInstance().Get(ns_, key, kSettingTypeBool, value)) {
         return default_value;
     }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value != 0;
+    return value.int_value != 0;
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
-        dirty_ = true;
+        SettingValue setting;
+        setting.type = kSettingTypeBool;
+        setting.int_value = value ? 1 : 0;
+        SettingsStore::GetInstance().Set(ns_, key, std::move(setting));
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -90,10 +421,7 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsStore::GetInstance().Erase(ns_, key);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -101,7 +429,7 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsStore::GetInstance().EraseAll(ns_);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
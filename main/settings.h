@@ -2,10 +2,15 @@
 #define SETTINGS_H
 
 #include <string>
+#include <functional>
 #include <nvs_flash.h>
 
+// 设置读写经过进程内缓存：每个命名空间首次访问时从 NVS 加载一次，
+// 修改在最后一次变更 2 秒后统一提交，重启或休眠前可通过 Flush() 立即提交
 class Settings {
 public:
+    using ChangeCallback = std::function<void(const std::string& ns, const std::string& key)>;
+
     Settings(const std::string& ns, bool read_write = false);
     ~Settings();
 
@@ -18,11 +23,17 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // Commit pending changes to NVS now
+    static void Flush();
+    // Drop cached values and pending changes, call after the NVS partition is erased
+    static void Discard();
+    // Called after a value in the namespace changes, an empty key means the namespace was erased.
+    // Runs on the writing task, outside the store lock
+    static void OnChange(const std::string& ns, ChangeCallback callback);
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
@@ -8,7 +8,7 @@ HEADER_TEMPLATE = """// Auto-generated language config
 #pragma once
 
 #include <string_view>
-
+{includes}
 #ifndef {lang_code_for_font}
     #define {lang_code_for_font}  // 預設語言
 #endif
@@ -23,7 +23,7 @@ namespace Lang {{
     }}
 
     // 音效资源 (en-US as fallback for missing audio files)
-    namespace Sounds {{
+    namespace Sounds {{{sound_type}
 {sounds}
     }}
 }}
@@ -50,7 +50,15 @@ def get_sound_files(directory):
         return []
     return [f for f in os.listdir(directory) if f.endswith('.ogg')]
 
-def generate_header(lang_code, output_path):
+ASSETS_SOUND_TYPE = """
+        // 音效打包在 assets 分区中，使用时才查找映射后的数据
+        struct Sound {
+            const char* name;
+            operator std::string_view() const { return Assets::GetInstance().Get(name); }
+        };
+"""
+
+def generate_header(lang_code, output_path, sounds_from_assets=False):
     # 从输出路径推导项目结构
     # output_path 通常是 main/assets/lang_config.h
     main_dir = os.path.dirname(output_path)  # main/assets
@@ -141,7 +149,11 @@ def generate_header(lang_code, output_path):
         else:
             sound_lang = 'en_us'
             
-        sounds.append(f'''
+        if sounds_from_assets:
+            sound_dir = lang_code if file in current_sounds else 'en-US'
+            sounds.append(f'        constexpr Sound OGG_{base_name.upper()} {{"locales/{sound_dir}/{file}"}};')
+        else:
+            sounds.append(f'''
         extern const char ogg_{base_name}_start[] asm("_binary_{base_name}_ogg_start");
         extern const char ogg_{base_name}_end[] asm("_binary_{base_name}_ogg_end");
         static const std::string_view OGG_{base_name.upper()} {{
@@ -152,6 +164,9 @@ def generate_header(lang_code, output_path):
     # 生成公共音效常量
     for file in sorted(common_sounds):
         base_name = os.path.splitext(file)[0]
+        if sounds_from_assets:
+            sounds.append(f'        constexpr Sound OGG_{base_name.upper()} {{"common/{file}"}};')
+            continue
         sounds.append(f'''
         extern const char ogg_{base_name}_start[] asm("_binary_{base_name}_ogg_start");
         extern const char ogg_{base_name}_end[] asm("_binary_{base_name}_ogg_end");
@@ -163,6 +178,8 @@ def generate_header(lang_code, output_path):
     # 填充模板
     content = HEADER_TEMPLATE.format(
         lang_code=lang_code,
+        includes='#include "assets.h"\n' if sounds_from_assets else '',
+        sound_type=ASSETS_SOUND_TYPE if sounds_from_assets else '',
         lang_code_for_font=lang_code.replace('-', '_').lower(),
         strings="\n".join(sorted(strings)),
         sounds="\n".join(sorted(sounds))
@@ -177,10 +194,11 @@ if __name__ == "__main__":
     parser = argparse.ArgumentParser(description="Generate language configuration header file with en-US fallback")
     parser.add_argument("--language", required=True, help="Language code (e.g: zh-CN, en-US, ja-JP)")
     parser.add_argument("--output", required=True, help="Output header file path")
+    parser.add_argument("--sounds-from-assets", action="store_true", help="Look up sounds in the assets partition instead of embedded files")
     args = parser.parse_args()
 
     try:
-        generate_header(args.language, args.output)
+        generate_header(args.language, args.output, args.sounds_from_assets)
         print(f"Successfully generated language config file: {args.output}")
     except Exception as e:
         print(f"Error: {e}")
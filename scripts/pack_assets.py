@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""
+打包、查看和校验 assets 分区镜像，格式与 main/assets.h 保持一致：
+
+    AssetsHeader | AssetsEntry[count]（按名称升序） | 数据（4 字节对齐）
+
+用法:
+    pack_assets.py pack --output assets.bin --root main/assets --pattern '*.ogg' [--max-size 0x700000]
+    pack_assets.py list assets.bin
+    pack_assets.py verify assets.bin
+"""
+import argparse
+import fnmatch
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"XZAS"
+VERSION = 1
+NAME_SIZE = 48
+HEADER_FORMAT = "<4sHHIIII"
+ENTRY_FORMAT = f"<{NAME_SIZE}sII"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+ENTRY_SIZE = struct.calcsize(ENTRY_FORMAT)
+ALIGNMENT = 4
+
+
+def crc32(data):
+    # 与 esp_rom_crc32_le(0, ...) 结果一致
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+def collect_files(root, patterns):
+    files = {}
+    for dirpath, _, filenames in os.walk(root):
+        for filename in filenames:
+            if not any(fnmatch.fnmatch(filename, pattern) for pattern in patterns):
+                continue
+            path = os.path.join(dirpath, filename)
+            name = os.path.relpath(path, root).replace(os.sep, "/")
+            if len(name.encode("utf-8")) >= NAME_SIZE:
+                raise ValueError(f"Asset name too long (max {NAME_SIZE - 1} bytes): {name}")
+            files[name] = path
+    return files
+
+
+def pack(root, patterns, output, max_size=None):
+    files = collect_files(root, patterns)
+    names = sorted(files, key=lambda name: name.encode("utf-8"))
+
+    data_offset = HEADER_SIZE + ENTRY_SIZE * len(names)
+    data = bytearray()
+    entries = []
+    for name in names:
+        with open(files[name], "rb") as f:
+            content = f.read()
+        entries.append(struct.pack(ENTRY_FORMAT, name.encode("utf-8"), data_offset + len(data), len(content)))
+        data += content
+        data += b"\0" * (-len(data) % ALIGNMENT)
+
+    index = b"".join(entries)
+    total_size = data_offset + len(data)
+    if max_size is not None and total_size > max_size:
+        raise ValueError(f"Assets image is {total_size} bytes, partition is only {max_size} bytes")
+
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, ENTRY_SIZE, len(names), total_size, crc32(index), crc32(data))
+    os.makedirs(os.path.dirname(os.path.abspath(output)), exist_ok=True)
+    with open(output, "wb") as f:
+        f.write(header + index + data)
+    print(f"Packed {len(names)} assets, {total_size} bytes into {output}")
+
+
+def read_image(path):
+    with open(path, "rb") as f:
+        image = f.read()
+    if len(image) < HEADER_SIZE:
+        raise ValueError("Image is smaller than the header")
+    magic, version, entry_size, count, total_size, index_crc, data_crc = struct.unpack_from(HEADER_FORMAT, image)
+    if magic != MAGIC:
+        raise ValueError(f"Bad magic {magic!r}")
+    if version != VERSION or entry_size != ENTRY_SIZE:
+        raise ValueError(f"Unsupported version {version}, entry size {entry_size}")
+    if total_size > len(image):
+        raise ValueError(f"Image is truncated: header says {total_size} bytes, file has {len(image)}")
+
+    entries = []
+    for i in range(count):
+        raw_name, offset, size = struct.unpack_from(ENTRY_FORMAT, image, HEADER_SIZE + i * ENTRY_SIZE)
+        entries.append((raw_name.split(b"\0", 1)[0], offset, size))
+    header = {
+        "count": count,
+        "total_size": total_size,
+        "index_crc32": index_crc,
+        "data_crc32": data_crc,
+    }
+    return image, header, entries
+
+
+def list_image(path):
+    _, header, entries = read_image(path)
+    for name, offset, size in entries:
+        print(f"{offset:#010x} {size:>8}  {name.decode('utf-8')}")
+    print(f"{header['count']} assets, {header['total_size']} bytes")
+
+
+def verify_image(path):
+    image, header, entries = read_image(path)
+    errors = []
+    data_offset = HEADER_SIZE + ENTRY_SIZE * header["count"]
+    if data_offset > header["total_size"]:
+        errors.append("Index extends past the end of the image")
+    if crc32(image[HEADER_SIZE:data_offset]) != header["index_crc32"]:
+        errors.append("Index checksum mismatch")
+    if crc32(image[data_offset:header["total_size"]]) != header["data_crc32"]:
+        errors.append("Data checksum mismatch")
+
+    names = [name for name, _, _ in entries]
+    if names != sorted(names):
+        errors.append("Index is not sorted by name")
+    if len(set(names)) != len(names):
+        errors.append("Index contains duplicate names")
+    for name, offset, size in entries:
+        if offset < data_offset or offset + size > header["total_size"]:
+            errors.append(f"{name.decode('utf-8', 'replace')} is out of bounds")
+        elif offset % ALIGNMENT != 0:
+            errors.append(f"{name.decode('utf-8', 'replace')} is not {ALIGNMENT}-byte aligned")
+
+    for error in errors:
+        print(f"Error: {error}")
+    if errors:
+        return False
+    print(f"OK: {header['count']} assets, {header['total_size']} bytes")
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack, list and verify the assets partition image")
+    subparsers = parser.add_subparsers(dest="command", required=True)
+
+    pack_parser = subparsers.add_parser("pack", help="Pack files under a directory into an image")
+    pack_parser.add_argument("--root", required=True, help="Directory to pack, names are relative to it")
+    pack_parser.add_argument("--pattern", action="append", default=[], help="File name pattern, may be repeated")
+    pack_parser.add_argument("--output", required=True, help="Output image path")
+    pack_parser.add_argument("--max-size", type=lambda x: int(x, 0), help="Partition size limit")
+
+    list_parser = subparsers.add_parser("list", help="List the assets in an image")
+    list_parser.add_argument("image")
+
+    verify_parser = subparsers.add_parser("verify", help="Validate an image")
+    verify_parser.add_argument("image")
+
+    args = parser.parse_args()
+    try:
+        if args.command == "pack":
+            pack(args.root, args.pattern or ["*"], args.output, args.max_size)
+        elif args.command == "list":
+            list_image(args.image)
+        elif not verify_image(args.image):
+            sys.exit(1)
+    except (OSError, ValueError) as e:
+        print(f"Error: {e}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
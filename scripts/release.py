@@ -3,6 +3,9 @@ import os
 import json
 import zipfile
 import argparse
+import io
+import struct
+import hashlib
 
 # 切换到项目根目录
 os.chdir(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
@@ -42,13 +45,60 @@ def zip_bin(board_type, project_version):
     print(f"zip bin to {output_path} done")
     
 
-def release_current():
+# 压缩/差分 OTA 镜像：64 字节头部 + detools 补丁（heatshrink），与 main/ota.cc 中的 OtaPatchHeader 对应
+OTA_PATCH_MAGIC = b"XZP1"
+APP_DESC_VERSION_OFFSET = 24 + 8 + 16  # esp_image_header_t + esp_image_segment_header_t + offset of version
+
+def get_app_version(app_bin):
+    with open(app_bin, "rb") as f:
+        f.seek(APP_DESC_VERSION_OFFSET)
+        return f.read(32).split(b"\0")[0].decode()
+
+def create_ota_patch(base_data, app_data, base_version):
+    try:
+        import detools
+    except ImportError:
+        print("detools is required to create OTA patches: pip install detools")
+        sys.exit(1)
+    patch = io.BytesIO()
+    detools.create_patch(io.BytesIO(base_data), io.BytesIO(app_data), patch,
+                         compression="heatshrink", patch_type="sequential")
+    header = struct.pack("<4sI32s24x", OTA_PATCH_MAGIC, len(app_data), base_version.encode())
+    return header + patch.getvalue()
+
+def make_ota_images(name, project_version, delta_base=None, app_bin="build/xiaozhi.bin"):
+    with open(app_bin, "rb") as f:
+        app_data = f.read()
+    if not os.path.exists("releases"):
+        os.makedirs("releases")
+
+    print(f"app image: {len(app_data)} bytes, sha256: {hashlib.sha256(app_data).hexdigest()}")
+
+    # 压缩镜像即以空镜像为基础的补丁
+    images = [(f"releases/v{project_version}_{name}.xzp", b"", "")]
+    if delta_base:
+        with open(delta_base, "rb") as f:
+            base_data = f.read()
+        base_version = get_app_version(delta_base)
+        images.append((f"releases/v{project_version}_{name}_from_{base_version}.xzp", base_data, base_version))
+
+    for output_path, base_data, base_version in images:
+        patch = create_ota_patch(base_data, app_data, base_version)
+        with open(output_path, "wb") as f:
+            f.write(patch)
+        reduction = 100 - len(patch) * 100 / len(app_data)
+        kind = f"delta from {base_version}" if base_version else "compressed"
+        print(f"{kind}: {output_path} {len(patch)} bytes ({reduction:.1f}% smaller)")
+
+def release_current(ota_images=False, delta_base=None):
     merge_bin()
     board_type = get_board_type()
     print("board type:", board_type)
     project_version = get_project_version()
     print("project version:", project_version)
     zip_bin(board_type, project_version)
+    if ota_images:
+        make_ota_images(board_type, project_version, delta_base)
 
 def get_all_board_types():
     board_configs = {}
@@ -65,7 +115,7 @@ def get_all_board_types():
                     board_configs[config_name] = board_type
     return board_configs
 
-def release(board_type, board_config, config_filename="config.json"):
+def release(board_type, board_config, config_filename="config.json", ota_images=False):
     config_path = f"main/boards/{board_type}/{config_filename}"
     if not os.path.exists(config_path):
         print(f"跳过 {board_type} 因为 {config_filename} 不存在")
@@ -117,6 +167,8 @@ def release(board_type, board_config, config_filename="config.json"):
             sys.exit(1)
         # Zip bin
         zip_bin(name, project_version)
+        if ota_images:
+            make_ota_images(name, project_version)
         print("-" * 80)
 
 if __name__ == "__main__":
@@ -125,8 +177,14 @@ if __name__ == "__main__":
     parser.add_argument("-c", "--config", default="config.json", help="指定 config 文件名，默认 config.json")
     parser.add_argument("--list-boards", action="store_true", help="列出所有支持的 board 列表")
     parser.add_argument("--json", action="store_true", help="配合 --list-boards，JSON 格式输出")
+    parser.add_argument("--ota-images", action="store_true", help="同时生成压缩 OTA 镜像 (.xzp)")
+    parser.add_argument("--delta-base", default=None, help="基础版本的应用 bin，用于生成差分 OTA 镜像（仅当前构建）")
     args = parser.parse_args()
 
+    # 差分镜像的基础版本只对应一个构建，不能用于多个板子
+    if args.board and args.delta_base:
+        parser.error("--delta-base 只能用于当前构建，不能与 board 参数同时使用")
+
     if args.list_boards:
         board_configs = get_all_board_types()
         boards = list(board_configs.values())
@@ -142,7 +200,7 @@ if __name__ == "__main__":
         found = False
         for board_config, board_type in board_configs.items():
             if args.board == 'all' or board_type == args.board:
-                release(board_type, board_config, config_filename=args.config)
+                release(board_type, board_config, config_filename=args.config, ota_images=args.ota_images)
                 found = True
         if not found:
             print(f"未找到板子类型: {args.board}")
@@ -150,4 +208,4 @@ if __name__ == "__main__":
             for board_type in board_configs.values():
                 print(f"  {board_type}")
     else:
-        release_current()
+        release_current(args.ota_images or args.delta_base is not None, args.delta_base)
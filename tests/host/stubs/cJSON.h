@@ -0,0 +1,145 @@
+#ifndef HOST_STUB_CJSON_H
+#define HOST_STUB_CJSON_H
+
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+// Builds and reads cJSON trees the way the library does: items are a linked list searched
+// case-insensitively by name, numbers keep valueint next to valuedouble. Parsing and printing
+// are declared but not implemented, tests must not call them.
+
+#define cJSON_False  (1 << 0)
+#define cJSON_True   (1 << 1)
+#define cJSON_NULL   (1 << 2)
+#define cJSON_Number (1 << 3)
+#define cJSON_String (1 << 4)
+#define cJSON_Array  (1 << 5)
+#define cJSON_Object (1 << 6)
+#define cJSON_Raw    (1 << 7)
+
+typedef struct cJSON {
+    struct cJSON* next;
+    struct cJSON* prev;
+    struct cJSON* child;
+    int type;
+    char* valuestring;
+    int valueint;
+    double valuedouble;
+    char* string;
+} cJSON;
+
+cJSON* cJSON_Parse(const char* value);
+char* cJSON_PrintUnformatted(const cJSON* item);
+cJSON* cJSON_AddRawToObject(cJSON* object, const char* name, const char* raw);
+
+inline cJSON* cJSON_NewItem(int type) {
+    auto item = (cJSON*)calloc(1, sizeof(cJSON));
+    item->type = type;
+    return item;
+}
+
+inline cJSON* cJSON_CreateObject() {
+    return cJSON_NewItem(cJSON_Object);
+}
+
+inline cJSON* cJSON_CreateArray() {
+    return cJSON_NewItem(cJSON_Array);
+}
+
+inline cJSON* cJSON_CreateString(const char* string) {
+    auto item = cJSON_NewItem(cJSON_String);
+    item->valuestring = strdup(string);
+    return item;
+}
+
+inline cJSON* cJSON_CreateNumber(double number) {
+    auto item = cJSON_NewItem(cJSON_Number);
+    item->valuedouble = number;
+    item->valueint = (int)number;
+    return item;
+}
+
+inline cJSON* cJSON_CreateBool(int boolean) {
+    // The parser sets valueint for true, the PropertyList binding reads it
+    auto item = cJSON_NewItem(boolean ? cJSON_True : cJSON_False);
+    item->valueint = boolean ? 1 : 0;
+    return item;
+}
+
+inline void cJSON_Delete(cJSON* item) {
+    while (item != nullptr) {
+        auto next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+inline void cJSON_free(void* ptr) {
+    free(ptr);
+}
+
+inline int cJSON_AddItemToArray(cJSON* array, cJSON* item) {
+    if (array == nullptr || item == nullptr) {
+        return 0;
+    }
+    if (array->child == nullptr) {
+        array->child = item;
+        item->prev = item;
+    } else {
+        auto last = array->child->prev;
+        last->next = item;
+        item->prev = last;
+        array->child->prev = item;
+    }
+    return 1;
+}
+
+inline int cJSON_AddItemToObject(cJSON* object, const char* name, cJSON* item) {
+    if (item == nullptr) {
+        return 0;
+    }
+    item->string = strdup(name);
+    return cJSON_AddItemToArray(object, item);
+}
+
+inline cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string) {
+    auto item = cJSON_CreateString(string);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+inline cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number) {
+    auto item = cJSON_CreateNumber(number);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+inline cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, int boolean) {
+    auto item = cJSON_CreateBool(boolean);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+inline cJSON* cJSON_GetObjectItem(const cJSON* object, const char* name) {
+    if (object == nullptr) {
+        return nullptr;
+    }
+    for (auto item = object->child; item != nullptr; item = item->next) {
+        if (item->string != nullptr && strcasecmp(item->string, name) == 0) {
+            return item;
+        }
+    }
+    return nullptr;
+}
+
+inline int cJSON_IsObject(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_Object; }
+inline int cJSON_IsBool(const cJSON* item) { return item != nullptr && (item->type & (cJSON_True | cJSON_False)) != 0; }
+inline int cJSON_IsTrue(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_True; }
+inline int cJSON_IsNumber(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_Number; }
+inline int cJSON_IsString(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_String; }
+
+#endif // HOST_STUB_CJSON_H
@@ -0,0 +1,28 @@
+#ifndef HOST_STUB_ESP_HEAP_CAPS_H
+#define HOST_STUB_ESP_HEAP_CAPS_H
+
+#include <cstddef>
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+inline void* heap_caps_malloc(size_t size, unsigned int /* caps */) {
+    return malloc(size);
+}
+
+inline void* heap_caps_calloc(size_t n, size_t size, unsigned int /* caps */) {
+    return calloc(n, size);
+}
+
+inline void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+inline size_t heap_caps_get_free_size(unsigned int /* caps */) {
+    return 0;
+}
+
+#endif // HOST_STUB_ESP_HEAP_CAPS_H
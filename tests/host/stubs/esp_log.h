@@ -0,0 +1,13 @@
+#ifndef HOST_STUB_ESP_LOG_H
+#define HOST_STUB_ESP_LOG_H
+
+#include <cstdio>
+
+// Errors and warnings go to stderr, everything else is dropped to keep test output readable
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) do { if (0) fprintf(stderr, format, ##__VA_ARGS__); } while (0)
+#define ESP_LOGD(tag, format, ...) do { if (0) fprintf(stderr, format, ##__VA_ARGS__); } while (0)
+#define ESP_LOGV(tag, format, ...) do { if (0) fprintf(stderr, format, ##__VA_ARGS__); } while (0)
+
+#endif // HOST_STUB_ESP_LOG_H
@@ -0,0 +1,14 @@
+#ifndef HOST_STUB_ESP_TIMER_H
+#define HOST_STUB_ESP_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+
+#include "esp_err.h"
+
+inline int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // HOST_STUB_ESP_TIMER_H
@@ -0,0 +1,22 @@
+#ifndef HOST_STUB_FREERTOS_H
+#define HOST_STUB_FREERTOS_H
+
+// Just enough of FreeRTOS on top of the C++ standard library to run task/queue code on the host.
+// One tick is one millisecond.
+
+#include <cstdint>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#endif // HOST_STUB_FREERTOS_H
@@ -0,0 +1,71 @@
+#ifndef HOST_STUB_FREERTOS_QUEUE_H
+#define HOST_STUB_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct HostQueue {
+    size_t length = 0;
+    size_t item_size = 0;
+    std::deque<std::vector<uint8_t>> items;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+typedef HostQueue* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    auto queue = new HostQueue();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+inline void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+inline bool HostQueueWait(QueueHandle_t queue, std::unique_lock<std::mutex>& lock, TickType_t ticks,
+                          bool (*ready)(QueueHandle_t)) {
+    auto predicate = [queue, ready]() { return ready(queue); };
+    if (ticks == portMAX_DELAY) {
+        queue->cv.wait(lock, predicate);
+        return true;
+    }
+    return queue->cv.wait_for(lock, std::chrono::milliseconds(ticks), predicate);
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!HostQueueWait(queue, lock, ticks, [](QueueHandle_t q) { return q->items.size() < q->length; })) {
+        return pdFAIL;
+    }
+    // Semaphores pass no item
+    std::vector<uint8_t> data(queue->item_size);
+    if (item != nullptr && queue->item_size > 0) {
+        memcpy(data.data(), item, queue->item_size);
+    }
+    queue->items.push_back(std::move(data));
+    queue->cv.notify_all();
+    return pdPASS;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!HostQueueWait(queue, lock, ticks, [](QueueHandle_t q) { return !q->items.empty(); })) {
+        return pdFAIL;
+    }
+    if (item != nullptr && queue->item_size > 0) {
+        memcpy(item, queue->items.front().data(), queue->item_size);
+    }
+    queue->items.pop_front();
+    queue->cv.notify_all();
+    return pdPASS;
+}
+
+#endif // HOST_STUB_FREERTOS_QUEUE_H
@@ -0,0 +1,24 @@
+#ifndef HOST_STUB_FREERTOS_SEMPHR_H
+#define HOST_STUB_FREERTOS_SEMPHR_H
+
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xQueueCreate(1, 0);
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return xQueueSend(semaphore, nullptr, 0);
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    return xQueueReceive(semaphore, nullptr, ticks);
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    vQueueDelete(semaphore);
+}
+
+#endif // HOST_STUB_FREERTOS_SEMPHR_H
@@ -0,0 +1,49 @@
+#ifndef HOST_STUB_FREERTOS_TASK_H
+#define HOST_STUB_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+#include <chrono>
+#include <thread>
+
+typedef void (*TaskFunction_t)(void*);
+typedef struct HostTask* TaskHandle_t;
+
+// Thrown by vTaskDelete(NULL) to unwind the calling task's thread
+struct HostTaskDeleted {};
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* /* name */, uint32_t /* stack_size */, void* arg,
+                              UBaseType_t /* priority */, TaskHandle_t* handle) {
+    std::thread([function, arg]() {
+        try {
+            function(arg);
+        } catch (const HostTaskDeleted&) {
+        }
+    }).detach();
+    if (handle != nullptr) {
+        *handle = nullptr;
+    }
+    return pdPASS;
+}
+
+typedef struct {
+    uint8_t reserved;
+} StaticTask_t;
+
+// The handle is only good for comparing against nullptr
+inline TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+                                      UBaseType_t priority, StackType_t* /* stack */, StaticTask_t* buffer) {
+    xTaskCreate(function, name, stack_size, arg, priority, nullptr);
+    return (TaskHandle_t)buffer;
+}
+
+inline void vTaskDelete(TaskHandle_t /* task */) {
+    // Only self-deletion is supported
+    throw HostTaskDeleted();
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+#endif // HOST_STUB_FREERTOS_TASK_H
@@ -0,0 +1,19 @@
+#ifndef HOST_STUB_LVGL_H
+#define HOST_STUB_LVGL_H
+
+#include <cstdint>
+
+// Only the image descriptor, for code that passes images around without drawing them
+typedef struct {
+    struct {
+        uint32_t cf;
+        uint32_t w;
+        uint32_t h;
+        uint32_t stride;
+    } header;
+    uint32_t data_size;
+    const uint8_t* data;
+} lv_image_dsc_t;
+typedef lv_image_dsc_t lv_img_dsc_t;
+
+#endif // HOST_STUB_LVGL_H
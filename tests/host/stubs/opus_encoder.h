@@ -0,0 +1,43 @@
+#ifndef HOST_STUB_OPUS_ENCODER_H
+#define HOST_STUB_OPUS_ENCODER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Stand-in for the Opus encoder component: no compression, each packet is the frame's first
+// sample and length. Encode() spins for host_opus_encode_us to stand in for the encoding time.
+inline int host_opus_encode_us = 0;
+inline std::atomic<int> host_opus_encode_count{0};
+
+class OpusEncoderWrapper {
+public:
+    OpusEncoderWrapper(int sample_rate, int channels, int duration_ms)
+        : frame_size_(sample_rate / 1000 * channels * duration_ms) {}
+
+    void SetComplexity(int /* complexity */) {}
+    void ResetState() {}
+
+    bool Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+        if (pcm.size() != (size_t)frame_size_) {
+            return false;
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(host_opus_encode_us);
+        while (std::chrono::steady_clock::now() < deadline) {
+        }
+        host_opus_encode_count++;
+        opus.resize(2 + sizeof(uint32_t));
+        memcpy(opus.data(), pcm.data(), 2);
+        uint32_t size = pcm.size();
+        memcpy(opus.data() + 2, &size, sizeof(size));
+        pcm.clear();
+        return true;
+    }
+
+private:
+    int frame_size_;
+};
+
+#endif // HOST_STUB_OPUS_ENCODER_H
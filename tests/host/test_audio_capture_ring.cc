@@ -0,0 +1,191 @@
+// AudioCaptureRing fed by a synthetic stereo codec.
+//
+// Every frame carries its own position: the mic channel holds the low 16 bits of the frame
+// counter and the reference channel a different function of it, so a consumer can check that
+// each chunk it reads continues exactly where its cursor was, and that no frame is torn.
+
+#include "audio/audio_capture_ring.h"
+#include "test_common.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#define CHANNELS 2
+#define CHUNK_FRAMES 512  // AUDIO_CAPTURE_CHUNK_MS at 16 kHz
+
+class SyntheticCodec {
+public:
+    // One capture chunk, interleaved mic/reference
+    const std::vector<int16_t>& Read(size_t frames) {
+        chunk_.resize(frames * CHANNELS);
+        for (size_t i = 0; i < frames; i++) {
+            chunk_[i * CHANNELS] = MicSample(position_ + i);
+            chunk_[i * CHANNELS + 1] = ReferenceSample(position_ + i);
+        }
+        position_ += frames;
+        return chunk_;
+    }
+
+    static int16_t MicSample(uint32_t position) { return (int16_t)(position & 0xffff); }
+    static int16_t ReferenceSample(uint32_t position) { return (int16_t)((position * 40503u) >> 16); }
+
+private:
+    uint32_t position_ = 0;
+    std::vector<int16_t> chunk_;
+};
+
+// Frames of `data` must be the frames at [position, position + frames)
+static bool IsContinuous(const std::vector<int16_t>& data, uint32_t position) {
+    for (size_t i = 0; i < data.size() / CHANNELS; i++) {
+        if (data[i * CHANNELS] != SyntheticCodec::MicSample(position + i) ||
+            data[i * CHANNELS + 1] != SyntheticCodec::ReferenceSample(position + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Read everything buffered for `cursor` in `frames` sized chunks, checking continuity
+static int Drain(AudioCaptureRing& ring, AudioCaptureRing::Cursor& cursor, size_t frames, uint32_t& expected) {
+    std::vector<int16_t> data;
+    int chunks = 0;
+    while (ring.Read(cursor, data, frames)) {
+        CHECK_MSG(IsContinuous(data, expected), "%s at frame %u", cursor.name, (unsigned)expected);
+        expected += frames;
+        chunks++;
+    }
+    return chunks;
+}
+
+// Consumers with different feed sizes read the same stream, and switching between them the way
+// AudioService does (wake word -> processor -> wake word) starts each one at the write head
+static void TestConsumerSwitch() {
+    AudioCaptureRing ring(CHANNELS, 16000);
+    SyntheticCodec codec;
+    AudioCaptureRing::Cursor wake_word("wake_word");
+    AudioCaptureRing::Cursor processor("processor");
+    AudioCaptureRing::Cursor testing("testing");
+
+    ring.Attach(wake_word);
+    ring.Attach(testing);
+    uint32_t wake_word_expected = 0;
+    uint32_t testing_expected = 0;
+    for (int i = 0; i < 40; i++) {
+        ring.Write(codec.Read(CHUNK_FRAMES).data(), CHUNK_FRAMES);
+        Drain(ring, wake_word, 480, wake_word_expected);
+        Drain(ring, testing, 960, testing_expected);
+    }
+    CHECK(ring.write_position() - wake_word_expected < 480);
+    CHECK(ring.write_position() - testing_expected < 960);
+
+    // Wake word detected: the processor starts at the write head, wake word stops being fed
+    ring.Attach(processor);
+    uint32_t processor_expected = ring.write_position();
+    for (int i = 0; i < 40; i++) {
+        ring.Write(codec.Read(CHUNK_FRAMES).data(), CHUNK_FRAMES);
+        Drain(ring, processor, 256, processor_expected);
+    }
+    CHECK(processor_expected == ring.write_position());
+
+    // Back to listening for the wake word: no stale samples from before the switch
+    ring.Attach(wake_word);
+    wake_word_expected = ring.write_position();
+    for (int i = 0; i < 10; i++) {
+        ring.Write(codec.Read(CHUNK_FRAMES).data(), CHUNK_FRAMES);
+        Drain(ring, wake_word, 480, wake_word_expected);
+    }
+
+    // Re-attaching with pre-roll starts that many frames back
+    ring.Attach(processor, 3200);
+    processor_expected = ring.write_position() - 3200;
+    CHECK(Drain(ring, processor, 320, processor_expected) == 10);
+
+    // Pre-roll is capped by what is still valid in the ring
+    ring.Attach(processor, 1000000);
+    CHECK(ring.write_position() - processor.position.load() == ring.capacity() - CHUNK_FRAMES);
+    processor_expected = processor.position.load();
+    Drain(ring, processor, 256, processor_expected);
+
+    CHECK(wake_word.overruns == 0 && processor.overruns == 0 && testing.overruns == 0);
+}
+
+// A consumer that stops reading for longer than the ring holds is resynced to the write head
+static void TestOverrun() {
+    AudioCaptureRing ring(CHANNELS, 4096);
+    SyntheticCodec codec;
+    AudioCaptureRing::Cursor cursor("stalled");
+    ring.Attach(cursor);
+    for (int i = 0; i < 16; i++) {
+        ring.Write(codec.Read(CHUNK_FRAMES).data(), CHUNK_FRAMES);
+    }
+    CHECK(ring.Available(cursor) == 0);
+    CHECK(cursor.overruns == 1);
+    CHECK(cursor.dropped_frames == 16 * CHUNK_FRAMES);
+
+    uint32_t expected = cursor.position.load();
+    CHECK(expected == ring.write_position());
+    for (int i = 0; i < 4; i++) {
+        ring.Write(codec.Read(CHUNK_FRAMES).data(), CHUNK_FRAMES);
+        Drain(ring, cursor, 256, expected);
+    }
+    CHECK(cursor.overruns == 1);
+}
+
+// The input task writes while two consumer threads read and re-attach. The ring holds only four
+// chunks, so the producer is often overwriting slots next to the ones being copied; every
+// successful read must still be continuous and untorn.
+static void TestConcurrentReaders() {
+    AudioCaptureRing ring(CHANNELS, 2048);
+    std::atomic<bool> running{true};
+
+    auto consumer = [&ring, &running](const char* name, size_t frames, int* reads, uint32_t* overruns) {
+        AudioCaptureRing::Cursor cursor(name);
+        std::vector<int16_t> data;
+        ring.Attach(cursor);
+        int attached_reads = 0;
+        while (running.load()) {
+            uint32_t position = cursor.position.load();
+            if (ring.Read(cursor, data, frames)) {
+                CHECK_MSG(IsContinuous(data, position), "%s at frame %u", name, (unsigned)position);
+                (*reads)++;
+                // Switch consumers every so often, sometimes with pre-roll
+                if (++attached_reads == 50) {
+                    ring.Attach(cursor, (*reads % 2) * 512);
+                    attached_reads = 0;
+                }
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        *overruns = cursor.overruns;
+    };
+
+    int wake_word_reads = 0, processor_reads = 0;
+    uint32_t wake_word_overruns = 0, processor_overruns = 0;
+    std::thread wake_word(consumer, "wake_word", 480, &wake_word_reads, &wake_word_overruns);
+    std::thread processor(consumer, "processor", 256, &processor_reads, &processor_overruns);
+
+    SyntheticCodec codec;
+    // About 100 times real time
+    for (int i = 0; i < 5000; i++) {
+        ring.Write(codec.Read(CHUNK_FRAMES).data(), CHUNK_FRAMES);
+        std::this_thread::sleep_for(std::chrono::microseconds(300));
+    }
+    running = false;
+    wake_word.join();
+    processor.join();
+
+    printf("concurrent: %d wake word reads (%u overruns), %d processor reads (%u overruns)\n",
+        wake_word_reads, (unsigned)wake_word_overruns, processor_reads, (unsigned)processor_overruns);
+    CHECK(wake_word_reads > 0 && processor_reads > 0);
+}
+
+int main() {
+    TestConsumerSwitch();
+    TestOverrun();
+    TestConcurrentReaders();
+    return TEST_RESULT();
+}
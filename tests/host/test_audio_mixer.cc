@@ -0,0 +1,190 @@
+// AudioMixer: how soon a prompt is heard behind a TTS backlog, how soon a barge-in goes quiet,
+// ducking levels and mixing cost.
+//
+// Voice carries 2.4 s of decoded TTS, then a sound and an alert are pushed the way OpusCodecTask
+// pushes decoded frames. Mix() is called in AUDIO_OUTPUT_CHUNK_MS chunks like AudioOutputTask;
+// latency is counted in mixed audio, which is what the listener waits for, not host time.
+
+#include "audio/audio_mixer.h"
+#include "test_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#define SAMPLE_RATE 24000
+#define FRAME_SAMPLES (SAMPLE_RATE * 60 / 1000)   // OPUS_FRAME_DURATION_MS
+#define CHUNK_SAMPLES (SAMPLE_RATE * 20 / 1000)   // AUDIO_OUTPUT_CHUNK_MS
+#define FADE_SAMPLES (SAMPLE_RATE * 10 / 1000)    // AUDIO_ABORT_FADE_MS
+#define DMA_RING_SAMPLES (6 * 240)                // AUDIO_CODEC_DMA_DESC_NUM x AUDIO_CODEC_DMA_FRAME_NUM
+
+static std::vector<int16_t> Tone(double frequency, int16_t amplitude, size_t samples) {
+    std::vector<int16_t> pcm(samples);
+    for (size_t i = 0; i < samples; i++) {
+        pcm[i] = (int16_t)(amplitude * sin(2 * M_PI * frequency * i / SAMPLE_RATE));
+    }
+    return pcm;
+}
+
+// Amplitude of `frequency` in `pcm` (single bin DFT)
+static double Level(const std::vector<int16_t>& pcm, double frequency) {
+    double re = 0, im = 0;
+    for (size_t i = 0; i < pcm.size(); i++) {
+        re += pcm[i] * cos(2 * M_PI * frequency * i / SAMPLE_RATE);
+        im += pcm[i] * sin(2 * M_PI * frequency * i / SAMPLE_RATE);
+    }
+    return 2 * sqrt(re * re + im * im) / pcm.size();
+}
+
+static void TestPromptLatency() {
+    AudioMixer mixer;
+    mixer.Initialize(SAMPLE_RATE);
+    for (int i = 0; i < 40; i++) {
+        mixer.Push(kAudioStreamVoice, Tone(500, 8000, FRAME_SAMPLES), 1000 + i);
+    }
+
+    // Half a second into the reply a prompt comes in
+    std::vector<int16_t> output;
+    uint32_t timestamp;
+    size_t mixed = 0;
+    while (mixed < SAMPLE_RATE / 2) {
+        CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+        mixed += output.size();
+    }
+    for (int i = 0; i < 4; i++) {
+        mixer.Push(kAudioStreamSound, Tone(1500, 8000, FRAME_SAMPLES));
+    }
+    size_t latency = 0;
+    while (true) {
+        CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+        if (mixer.mixed_streams() & (1 << kAudioStreamSound)) {
+            break;
+        }
+        latency += output.size();
+    }
+    printf("prompt mixed after %u ms of output with %u ms of voice still buffered\n",
+        (unsigned)(latency * 1000 / SAMPLE_RATE),
+        (unsigned)(mixer.buffered_samples(kAudioStreamVoice) * 1000 / SAMPLE_RATE));
+    CHECK(latency == 0);
+    CHECK(mixer.buffered_samples(kAudioStreamVoice) > SAMPLE_RATE);
+
+    // After the 20 ms attack the voice is at -12 dB under the sound
+    CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+    double voice = Level(output, 500), sound = Level(output, 1500);
+    printf("ducked under the sound: voice %.1f dB, sound %.1f dB\n",
+        20 * log10(voice / 8000), 20 * log10(sound / 8000));
+    CHECK(fabs(20 * log10(voice / 8000) + 12) < 1);
+    CHECK(fabs(20 * log10(sound / 8000)) < 0.5);
+
+    // An alert on top ducks both lower streams to -18 dB
+    mixer.Push(kAudioStreamAlert, Tone(3000, 8000, FRAME_SAMPLES * 2));
+    CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+    CHECK(mixer.mixed_streams() == 0x7);
+    CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+    CHECK(fabs(20 * log10(Level(output, 1500) / 8000) + 18) < 1);
+    CHECK(fabs(20 * log10(Level(output, 3000) / 8000)) < 0.5);
+
+    // The voice comes back to full level over the 300 ms release once the prompts end
+    while (mixer.buffered_samples(kAudioStreamAlert) > 0 || mixer.buffered_samples(kAudioStreamSound) > 0) {
+        CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+    }
+    for (int i = 0; i < 16; i++) {
+        CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+    }
+    CHECK(mixer.mixed_streams() == (1 << kAudioStreamVoice));
+    CHECK(fabs(20 * log10(Level(output, 500) / 8000)) < 0.5);
+}
+
+// AbortPlayback() with 2.4 s of voice buffered and a prompt playing: the voice must be gone within
+// the fade, without a step at its start, and the prompt must carry on at full level
+static void TestBargeIn() {
+    AudioMixer mixer;
+    mixer.Initialize(SAMPLE_RATE);
+    for (int i = 0; i < 40; i++) {
+        mixer.Push(kAudioStreamVoice, Tone(500, 8000, FRAME_SAMPLES), 1000 + i);
+    }
+    std::vector<int16_t> output;
+    uint32_t timestamp;
+    for (int i = 0; i < 25; i++) {
+        CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+    }
+    int16_t last = output.back();
+
+    // The trigger lands between two chunks of the output task
+    mixer.FadeOut(kAudioStreamVoice, FADE_SAMPLES);
+    CHECK(mixer.buffered_samples(kAudioStreamVoice) == FADE_SAMPLES);
+    std::vector<int16_t> played;
+    while (mixer.Mix(output, timestamp, CHUNK_SAMPLES)) {
+        played.insert(played.end(), output.begin(), output.end());
+    }
+    size_t silence_at = played.size();
+    while (silence_at > 0 && played[silence_at - 1] == 0) {
+        silence_at--;
+    }
+    int max_step = abs(played[0] - last);
+    for (size_t i = 1; i < silence_at; i++) {
+        max_step = std::max(max_step, abs(played[i] - played[i - 1]));
+    }
+    // A 500 Hz tone at 8000 moves at most about 1050 per sample at 24 kHz
+    CHECK_MSG(max_step <= 1100, "step %d", max_step);
+    CHECK(silence_at <= FADE_SAMPLES);
+    CHECK(mixer.empty());
+
+    // End to end, the chunk the output task is writing when the trigger comes is still played. Codecs
+    // that can flush their TX DMA ring are cut right after it, the fade is for those that can't,
+    // which also play out a full ring
+    printf("barge-in: voice silent after %u ms of mixed audio; to silence: flushed %u ms, faded %u ms + %u ms DMA ring\n",
+        (unsigned)(silence_at * 1000 / SAMPLE_RATE), (unsigned)(CHUNK_SAMPLES * 1000 / SAMPLE_RATE),
+        (unsigned)((silence_at + CHUNK_SAMPLES) * 1000 / SAMPLE_RATE), (unsigned)(DMA_RING_SAMPLES * 1000 / SAMPLE_RATE));
+
+    // A prompt playing under the abort is not faded and comes back up from the voice ducking
+    for (int i = 0; i < 40; i++) {
+        mixer.Push(kAudioStreamVoice, Tone(500, 8000, FRAME_SAMPLES), 2000 + i);
+    }
+    mixer.Push(kAudioStreamSound, Tone(1500, 8000, FRAME_SAMPLES * 4));
+    CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+    mixer.FadeOut(kAudioStreamVoice, FADE_SAMPLES);
+    CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+    CHECK(mixer.buffered_samples(kAudioStreamVoice) == 0);
+    CHECK(mixer.Mix(output, timestamp, CHUNK_SAMPLES));
+    CHECK(mixer.mixed_streams() == (1 << kAudioStreamSound));
+    CHECK(fabs(20 * log10(Level(output, 1500) / 8000)) < 0.5);
+    CHECK(Level(output, 500) < 8);
+}
+
+// Host time per output sample with two or three streams active and ramping
+static void Benchmark() {
+    AudioMixer mixer;
+    mixer.Initialize(SAMPLE_RATE);
+    std::vector<int16_t> output;
+    uint32_t timestamp;
+    const int rounds = 2000;
+    double elapsed_ns = 0;
+    size_t samples = 0;
+    for (int round = 0; round < rounds; round++) {
+        mixer.Push(kAudioStreamVoice, Tone(500, 8000, FRAME_SAMPLES));
+        mixer.Push(kAudioStreamSound, Tone(1500, 8000, FRAME_SAMPLES));
+        if (round % 2 == 0) {
+            mixer.Push(kAudioStreamAlert, Tone(3000, 8000, FRAME_SAMPLES));
+        }
+        auto start = std::chrono::steady_clock::now();
+        while (mixer.buffered_samples(kAudioStreamVoice) > 0) {
+            mixer.Mix(output, timestamp, CHUNK_SAMPLES);
+            samples += output.size();
+        }
+        elapsed_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        mixer.Clear(kAudioStreamSound);
+        mixer.Clear(kAudioStreamAlert);
+    }
+    printf("benchmark: %.2f ns per output sample on this host, 2-3 streams\n", elapsed_ns / samples);
+}
+
+int main() {
+    TestPromptLatency();
+    TestBargeIn();
+    Benchmark();
+    return TEST_RESULT();
+}
@@ -0,0 +1,201 @@
+// AudioReframer with AFE fetch sizes that do or don't divide the 960-sample frame, against the
+// insert/erase buffering AfeAudioProcessor used before.
+//
+// Every input sample holds the low 16 bits of its position, so each output frame can be checked
+// to continue where the previous one ended. Heap allocations are counted by replacing the global
+// operator new.
+
+#include "audio/processors/audio_reframer.h"
+#include "test_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static uint64_t BenchNow() { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static uint64_t BenchNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define FRAME_SAMPLES 960   // 60 ms at 16 kHz
+#define BENCH_FRAMES 2000
+
+static size_t heap_allocations = 0;
+
+void* operator new(size_t size) {
+    heap_allocations++;
+    if (void* ptr = malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+// `frames` frames of `channels` interleaved channels, the first channel counts from `position`
+static std::vector<int16_t> Fetch(uint32_t position, size_t frames, int channels) {
+    std::vector<int16_t> data(frames * channels);
+    for (size_t i = 0; i < frames; i++) {
+        data[i * channels] = (int16_t)(position + i);
+        for (int c = 1; c < channels; c++) {
+            data[i * channels + c] = (int16_t)~(position + i);
+        }
+    }
+    return data;
+}
+
+// The buffering before AudioReframer
+class LegacyReframer {
+public:
+    LegacyReframer() { output_buffer_.reserve(FRAME_SAMPLES); }
+
+    void Push(const int16_t* data, size_t frames, int channels,
+        const std::function<void(std::vector<int16_t>&& frame)>& output) {
+        if (channels == 2) {
+            // NoAudioProcessor took the left channel into a new vector
+            auto mono_data = std::vector<int16_t>(frames);
+            for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
+                mono_data[i] = data[j];
+            }
+            output_buffer_.insert(output_buffer_.end(), mono_data.begin(), mono_data.end());
+        } else {
+            output_buffer_.insert(output_buffer_.end(), data, data + frames);
+        }
+        while (output_buffer_.size() >= FRAME_SAMPLES) {
+            if (output_buffer_.size() == FRAME_SAMPLES) {
+                output(std::move(output_buffer_));
+                output_buffer_.clear();
+                output_buffer_.reserve(FRAME_SAMPLES);
+            } else {
+                output(std::vector<int16_t>(output_buffer_.begin(), output_buffer_.begin() + FRAME_SAMPLES));
+                output_buffer_.erase(output_buffer_.begin(), output_buffer_.begin() + FRAME_SAMPLES);
+            }
+        }
+    }
+
+    // AudioService moved every frame into its encode queue and freed it after encoding
+    void Recycle(std::vector<int16_t>&& frame) {
+        std::vector<int16_t> encoded(std::move(frame));
+    }
+
+private:
+    std::vector<int16_t> output_buffer_;
+};
+
+struct Run {
+    uint64_t time;
+    size_t allocations;
+    size_t frames;
+    bool continuous;
+};
+
+// Push BENCH_FRAMES frames worth of `fetch` sized chunks; every output frame is checked and then
+// recycled, as AudioService does after encoding
+template <typename Reframer>
+static Run Push(Reframer& reframer, size_t fetch, int channels) {
+    auto input = Fetch(0, FRAME_SAMPLES * 8, channels);   // reused, positions repeat every 8 frames
+    Run run = { 0, 0, 0, true };
+    uint32_t expected = 0;
+    std::function<void(std::vector<int16_t>&& frame)> output = [&](std::vector<int16_t>&& frame) {
+        if (frame.size() != FRAME_SAMPLES || frame[0] != (int16_t)expected ||
+            frame[FRAME_SAMPLES - 1] != (int16_t)(expected + FRAME_SAMPLES - 1)) {
+            run.continuous = false;
+        }
+        expected = (expected + FRAME_SAMPLES) % (FRAME_SAMPLES * 8);
+        run.frames++;
+        reframer.Recycle(std::move(frame));
+    };
+
+    // One round to fill the pool
+    size_t position = 0;
+    auto push = [&](size_t total) {
+        for (size_t pushed = 0; pushed < total; pushed += fetch, position = (position + fetch) % (FRAME_SAMPLES * 8)) {
+            size_t frames = std::min(fetch, FRAME_SAMPLES * 8 - position);
+            reframer.Push(input.data() + position * channels, frames, channels, output);
+            if (frames < fetch) {
+                reframer.Push(input.data(), fetch - frames, channels, output);
+            }
+        }
+    };
+    push(FRAME_SAMPLES * 8);
+
+    size_t allocations = heap_allocations;
+    uint64_t start = BenchNow();
+    push((size_t)FRAME_SAMPLES * BENCH_FRAMES);
+    run.time = BenchNow() - start;
+    run.allocations = heap_allocations - allocations;
+    return run;
+}
+
+static void TestFetchSizes() {
+    for (int channels : { 1, 2 }) {
+        for (size_t fetch : { 256, 480, 512, 1000 }) {
+            AudioReframer reframer;
+            reframer.Initialize(FRAME_SAMPLES);
+            auto after = Push(reframer, fetch, channels);
+            LegacyReframer legacy;
+            auto before = Push(legacy, fetch, channels);
+
+            CHECK_MSG(after.continuous, "fetch %u, %d channels", (unsigned)fetch, channels);
+            CHECK_MSG(before.continuous, "legacy fetch %u, %d channels", (unsigned)fetch, channels);
+            CHECK(after.frames == before.frames);
+            CHECK_MSG(after.allocations == 0, "fetch %u, %d channels: %u allocations", (unsigned)fetch, channels,
+                (unsigned)after.allocations);
+            printf("fetch %4u, %d ch: %6.0f %s/frame, %4u allocations; before: %6.0f %s/frame, %4u allocations\n",
+                (unsigned)fetch, channels, (double)after.time / BENCH_FRAMES, BENCH_UNIT, (unsigned)after.allocations,
+                (double)before.time / BENCH_FRAMES, BENCH_UNIT, (unsigned)before.allocations);
+        }
+    }
+}
+
+// Reset() drops the partial frame, the next frame starts with the next push
+static void TestReset() {
+    AudioReframer reframer;
+    reframer.Initialize(FRAME_SAMPLES);
+    std::vector<std::vector<int16_t>> frames;
+    auto output = [&frames](std::vector<int16_t>&& frame) { frames.push_back(std::move(frame)); };
+
+    auto data = Fetch(0, 500, 2);
+    reframer.Push(data.data(), 500, 2, output);
+    reframer.Reset();
+    data = Fetch(10000, 1000, 2);
+    reframer.Push(data.data(), 1000, 2, output);
+    CHECK(frames.size() == 1);
+    CHECK(frames.size() == 1 && frames[0][0] == (int16_t)10000 && frames[0][FRAME_SAMPLES - 1] == (int16_t)10959);
+
+    // Again with the 40 samples left over from the last push
+    reframer.Reset();
+    data = Fetch(20000, FRAME_SAMPLES, 2);
+    reframer.Push(data.data(), FRAME_SAMPLES, 2, output);
+    CHECK(frames.size() == 2 && frames[1][0] == (int16_t)20000);
+
+    // A moved-from frame given back is dropped instead of pooled
+    std::vector<int16_t> empty;
+    reframer.Recycle(std::move(empty));
+    data = Fetch(30000, FRAME_SAMPLES, 1);
+    reframer.Push(data.data(), FRAME_SAMPLES, 1, output);
+    CHECK(frames.size() == 3 && frames[2].size() == FRAME_SAMPLES && frames[2][0] == (int16_t)30000);
+}
+
+int main() {
+    TestFetchSizes();
+    TestReset();
+    return TEST_RESULT();
+}
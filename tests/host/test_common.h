@@ -0,0 +1,28 @@
+#ifndef HOST_TEST_COMMON_H
+#define HOST_TEST_COMMON_H
+
+#include <cstdio>
+
+// Minimal checks: failures are printed and counted, main() returns the count
+static int test_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_MSG(condition, format, ...) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s, " format "\n", __FILE__, __LINE__, #condition, ##__VA_ARGS__); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_RESULT() \
+    (printf("%s\n", test_failures == 0 ? "PASS" : "FAIL"), test_failures == 0 ? 0 : 1)
+
+#endif // HOST_TEST_COMMON_H
@@ -0,0 +1,151 @@
+// DisplayUpdateQueue: caller-side latency and transcript integrity under a slow renderer.
+//
+// A renderer thread stands in for the LVGL task: it holds a "display lock" while it applies a
+// batch, spending a fixed time per chat entry. The caller streams chat messages, status and
+// emotion changes at the rate a TTS reply produces them. Every chat entry must be rendered once
+// and in order, however far behind the renderer is; the latency of each call is reported.
+
+#include "display/display_update_queue.h"
+#include "test_common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MESSAGES 120
+
+struct Result {
+    double mean_us = 0;
+    double max_us = 0;
+    uint32_t backlog_applies = 0;
+    size_t largest_batch = 0;
+};
+
+static Result Run(int render_us_per_entry, int message_interval_us) {
+    DisplayUpdateQueue queue;
+    std::mutex display_lock;
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    bool woken = false;
+    std::vector<std::string> rendered;
+    size_t largest_batch = 0;
+
+    // Called with the display lock held, like Display::ApplyPendingUpdates
+    auto apply = [&]() {
+        auto updates = queue.Take();
+        largest_batch = std::max(largest_batch, updates.chat_messages.size());
+        for (auto& update : updates.chat_messages) {
+            std::this_thread::sleep_for(std::chrono::microseconds(render_us_per_entry));
+            rendered.push_back(update.content);
+        }
+    };
+    queue.SetCallbacks([&]() {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        woken = true;
+        wake_cv.notify_one();
+    }, [&]() {
+        std::lock_guard<std::mutex> lock(display_lock);
+        apply();
+    });
+
+    std::atomic<bool> running{true};
+    std::thread renderer([&]() {
+        while (running) {
+            {
+                std::unique_lock<std::mutex> lock(wake_mutex);
+                wake_cv.wait_for(lock, std::chrono::milliseconds(5), [&woken]() { return woken; });
+                woken = false;
+            }
+            std::lock_guard<std::mutex> lock(display_lock);
+            apply();
+        }
+    });
+
+    std::vector<double> latencies;
+    for (int i = 0; i < MESSAGES; i++) {
+        std::string text = "sentence " + std::to_string(i);
+        auto start = std::chrono::steady_clock::now();
+        queue.PushChat(DisplayUpdateQueue::kChatUpdateMessage, "assistant", text.c_str());
+        if (i % 10 == 0) {
+            queue.SetEmotion("happy", false);
+            queue.SetStatus("Speaking");
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        std::this_thread::sleep_for(std::chrono::microseconds(message_interval_us));
+    }
+    while (!queue.empty()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    running = false;
+    renderer.join();
+    {
+        std::lock_guard<std::mutex> lock(display_lock);
+        apply();
+    }
+
+    CHECK_MSG(rendered.size() == MESSAGES, "%u of %d entries rendered", (unsigned)rendered.size(), MESSAGES);
+    for (size_t i = 0; i < rendered.size(); i++) {
+        CHECK_MSG(rendered[i] == "sentence " + std::to_string(i), "entry %u is \"%s\"", (unsigned)i, rendered[i].c_str());
+    }
+
+    Result result;
+    for (double latency : latencies) {
+        result.mean_us += latency / latencies.size();
+        result.max_us = std::max(result.max_us, latency);
+    }
+    result.backlog_applies = queue.backlog_applies();
+    result.largest_batch = largest_batch;
+    return result;
+}
+
+// A clear drops what is queued before it, and a full queue never loses entries after it
+static void TestClear() {
+    DisplayUpdateQueue queue(4);
+    int backlog_applies = 0;
+    std::vector<std::string> applied;
+    queue.SetCallbacks(nullptr, [&]() {
+        backlog_applies++;
+        for (auto& update : queue.Take().chat_messages) {
+            applied.push_back(update.content);
+        }
+    });
+    queue.PushChat(DisplayUpdateQueue::kChatUpdateMessage, "user", "a");
+    queue.PushChat(DisplayUpdateQueue::kChatUpdateMessage, "user", "b");
+    queue.PushChat(DisplayUpdateQueue::kChatUpdateClear, "", "");
+    for (const char* text : { "c", "d", "e", "f" }) {
+        queue.PushChat(DisplayUpdateQueue::kChatUpdateMessage, "assistant", text);
+    }
+    CHECK(backlog_applies == 1);
+    CHECK((applied == std::vector<std::string>{ "", "c", "d", "e" }));
+    auto updates = queue.Take();
+    CHECK(updates.chat_messages.size() == 1 && updates.chat_messages[0].content == "f");
+    CHECK(queue.empty());
+}
+
+int main() {
+    TestClear();
+
+    struct Scenario {
+        const char* name;
+        int render_us_per_entry;
+        int message_interval_us;
+    };
+    static const Scenario scenarios[] = {
+        { "renderer keeps up", 200, 2000 },
+        { "renderer 10x slower", 20000, 2000 },
+    };
+    for (auto& scenario : scenarios) {
+        auto result = Run(scenario.render_us_per_entry, scenario.message_interval_us);
+        printf("%-20s caller latency mean %.1f us, max %.1f ms, %u backlog applies on the caller, "
+            "largest batch %u\n", scenario.name, result.mean_us, result.max_us / 1000,
+            (unsigned)result.backlog_applies, (unsigned)result.largest_batch);
+        // Bounded: never more than the queue limit pending, plus the entry being pushed
+        CHECK(result.largest_batch <= DISPLAY_MAX_PENDING_CHAT_UPDATES);
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,130 @@
+// EchoCanceller ERLE on a simulated echo path.
+//
+// The far end is shaped noise with pauses, played through a random decaying room response. The
+// mic gets the echo plus a little noise, and a near-end talker in one scene. ERLE is measured on
+// the canceller output against the mic, after convergence. The misaligned scenes put the echo
+// later than the reference says; 90 ms is a full TX DMA ring at 16 kHz output, which is what the
+// playback reference was off by when it ignored the DMA backlog.
+
+#include "audio/processors/echo_canceller.h"
+#include "test_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#define SAMPLE_RATE 16000
+#define FRAME_SAMPLES 960   // OPUS_FRAME_DURATION_MS at 16 kHz
+#define TAIL_MS 48          // Kconfig default
+#define SECONDS 12
+
+struct Scene {
+    const char* name;
+    int extra_delay_ms;     // Echo arrives this much later than the reference says
+    bool double_talk;       // Near-end speech from 8 s to 9 s
+};
+
+struct Result {
+    double erle_db = 0;             // Far-end only, from 4 s on
+    double double_talk_erle_db = 0; // Echo against the output minus the near-end speech
+    double us_per_frame = 0;
+};
+
+static Result Run(const Scene& scene) {
+    std::mt19937 generator(3);
+    std::normal_distribution<double> normal(0, 1);
+
+    // Room response: 1.25 ms direct delay, then a decaying random tail of about 35 ms
+    std::vector<double> path(600);
+    for (size_t i = 20; i < path.size(); i++) {
+        path[i] = normal(generator) * 0.5 * exp(-(double)(i - 20) / 120.0);
+    }
+    size_t delay = scene.extra_delay_ms * SAMPLE_RATE / 1000;
+
+    size_t total = SAMPLE_RATE * SECONDS;
+    std::vector<double> far(total), echo(total), near(total);
+    double state = 0;
+    for (size_t i = 0; i < total; i++) {
+        state = 0.9 * state + normal(generator) * 2000;
+        double envelope = (i / 8000) % 3 == 2 ? 0.2 : 1.0;
+        far[i] = std::clamp(state * envelope, -32000.0, 32000.0);
+    }
+    for (size_t i = 0; i < total; i++) {
+        double sum = 0;
+        for (size_t k = 0; k < path.size() && k + delay <= i; k++) {
+            sum += path[k] * far[i - delay - k];
+        }
+        echo[i] = sum + normal(generator) * 30;
+        if (scene.double_talk && i >= 8 * SAMPLE_RATE && i < 9 * SAMPLE_RATE) {
+            near[i] = 3000 * sin(i * 0.05) * sin(i * 0.001);
+        }
+    }
+
+    EchoCanceller canceller(TAIL_MS);
+    std::vector<int16_t> input(FRAME_SAMPLES * 2), output(FRAME_SAMPLES);
+    double mic_energy = 0, output_energy = 0;
+    double double_talk_echo_energy = 0, double_talk_residual_energy = 0;
+    double elapsed_us = 0;
+    int frames = 0;
+    for (size_t offset = 0; offset + FRAME_SAMPLES <= total; offset += FRAME_SAMPLES) {
+        for (size_t i = 0; i < FRAME_SAMPLES; i++) {
+            input[i * 2] = (int16_t)std::clamp(echo[offset + i] + near[offset + i], -32768.0, 32767.0);
+            input[i * 2 + 1] = (int16_t)far[offset + i];
+        }
+        auto start = std::chrono::steady_clock::now();
+        canceller.Process(input.data(), 2, 1, FRAME_SAMPLES, output.data());
+        elapsed_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        frames++;
+
+        for (size_t i = 0; i < FRAME_SAMPLES; i++) {
+            size_t n = offset + i;
+            if (near[n] != 0) {
+                // The near end must pass through while the echo under it is still removed
+                double residual = output[i] - near[n];
+                double_talk_echo_energy += echo[n] * echo[n];
+                double_talk_residual_energy += residual * residual;
+            } else if (n >= 4 * SAMPLE_RATE) {
+                mic_energy += (double)input[i * 2] * input[i * 2];
+                output_energy += (double)output[i] * output[i];
+            }
+        }
+    }
+
+    Result result;
+    result.erle_db = 10 * log10(mic_energy / (output_energy + 1));
+    if (double_talk_echo_energy > 0) {
+        result.double_talk_erle_db = 10 * log10(double_talk_echo_energy / (double_talk_residual_energy + 1));
+    }
+    result.us_per_frame = elapsed_us / frames;
+    return result;
+}
+
+int main() {
+    static const Scene scenes[] = {
+        { "aligned", 0, false },
+        { "aligned, double talk", 0, true },
+        { "reference 20 ms early", 20, false },
+        { "reference 90 ms early", 90, false },
+    };
+
+    Result results[4];
+    for (int i = 0; i < 4; i++) {
+        results[i] = Run(scenes[i]);
+        printf("%-24s ERLE %5.1f dB", scenes[i].name, results[i].erle_db);
+        if (scenes[i].double_talk) {
+            printf(", during double talk %4.1f dB", results[i].double_talk_erle_db);
+        }
+        printf(", %.0f us per 60 ms frame on this host\n", results[i].us_per_frame);
+    }
+
+    CHECK_MSG(results[0].erle_db >= 15, "%.1f dB", results[0].erle_db);
+    CHECK_MSG(results[1].erle_db >= 12, "%.1f dB", results[1].erle_db);
+    CHECK_MSG(results[1].double_talk_erle_db >= 6, "%.1f dB", results[1].double_talk_erle_db);
+    // Within the tail the filter absorbs the offset; a DMA ring beyond it leaves the echo in place
+    CHECK_MSG(results[2].erle_db >= 12, "%.1f dB", results[2].erle_db);
+    CHECK_MSG(results[3].erle_db < 3, "%.1f dB", results[3].erle_db);
+    return TEST_RESULT();
+}
@@ -0,0 +1,230 @@
+// Typed McpSchema binding against the PropertyList binding for the same tool arguments: same
+// results and error messages, and the per-call cost of Bind() plus running the bound call.
+//
+// cJSON comes from stubs/cJSON.h, which builds the same linked-list trees as the library, so
+// argument lookups cost about what they do on the device. Heap allocations are counted by
+// replacing the global operator new.
+
+#include "mcp_server.h"
+#include "test_common.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static uint64_t BenchNow() { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static uint64_t BenchNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define BENCH_CALLS 20000
+
+static size_t heap_allocations = 0;
+
+// Out of line, GCC flags the pairs as mismatched once it sees malloc and free through them
+__attribute__((noinline)) void* operator new(size_t size) {
+    heap_allocations++;
+    if (void* ptr = malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+struct VolumeArgs {
+    int volume = 50;
+};
+
+// Shaped like the camera and music tools: a required string and optional settings
+struct PlayArgs {
+    std::string song;
+    int repeat = 1;
+    bool shuffle = false;
+};
+
+static McpTool* TypedVolume() {
+    return McpTool::Create("self.audio_speaker.set_volume", "",
+        McpSchema(McpField("volume", &VolumeArgs::volume).Range(0, 100)),
+        [](const VolumeArgs& args) -> ReturnValue { return args.volume; });
+}
+
+static McpTool* UntypedVolume() {
+    return new McpTool("self.audio_speaker.set_volume", "",
+        PropertyList({ Property("volume", kPropertyTypeInteger, 0, 100) }),
+        [](const PropertyList& properties) -> ReturnValue { return properties["volume"].value<int>(); });
+}
+
+static McpTool* TypedPlay() {
+    return McpTool::Create("self.music.play", "",
+        McpSchema(McpField("song", &PlayArgs::song),
+            McpField("repeat", &PlayArgs::repeat).Range(1, 10).Optional(),
+            McpField("shuffle", &PlayArgs::shuffle).Optional()),
+        [](const PlayArgs& args) -> ReturnValue {
+            return args.song + "/" + std::to_string(args.repeat) + (args.shuffle ? "/shuffle" : "");
+        });
+}
+
+static McpTool* UntypedPlay() {
+    return new McpTool("self.music.play", "",
+        PropertyList({
+            Property("song", kPropertyTypeString),
+            Property("repeat", kPropertyTypeInteger, 1, 1, 10),
+            Property("shuffle", kPropertyTypeBoolean, false),
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            return properties["song"].value<std::string>() + "/" + std::to_string(properties["repeat"].value<int>()) +
+                (properties["shuffle"].value<bool>() ? "/shuffle" : "");
+        });
+}
+
+// Bind and run, returns the result or the error
+static std::string Call(const McpTool* tool, const cJSON* arguments) {
+    std::string error;
+    auto call = tool->Bind(arguments, error);
+    if (!call) {
+        return "error: " + error;
+    }
+    auto result = call();
+    if (std::holds_alternative<int>(result)) {
+        return std::to_string(std::get<int>(result));
+    }
+    return std::get<std::string>(result);
+}
+
+static void TestSameResults() {
+    auto typed_volume = TypedVolume(), untyped_volume = UntypedVolume();
+    auto typed_play = TypedPlay(), untyped_play = UntypedPlay();
+
+    struct {
+        McpTool* typed;
+        McpTool* untyped;
+        const char* expected;
+        void (*build)(cJSON* arguments);
+    } cases[] = {
+        { typed_volume, untyped_volume, "70", [](cJSON* a) { cJSON_AddNumberToObject(a, "volume", 70); } },
+        { typed_volume, untyped_volume, "error: Value exceeds maximum allowed: 100",
+            [](cJSON* a) { cJSON_AddNumberToObject(a, "volume", 101); } },
+        { typed_volume, untyped_volume, "error: Value is below minimum allowed: 0",
+            [](cJSON* a) { cJSON_AddNumberToObject(a, "volume", -1); } },
+        { typed_volume, untyped_volume, "error: Missing valid argument: volume",
+            [](cJSON* a) { cJSON_AddStringToObject(a, "volume", "70"); } },
+        { typed_play, untyped_play, "intro/1", [](cJSON* a) { cJSON_AddStringToObject(a, "song", "intro"); } },
+        { typed_play, untyped_play, "intro/3/shuffle", [](cJSON* a) {
+            cJSON_AddStringToObject(a, "song", "intro");
+            cJSON_AddNumberToObject(a, "repeat", 3);
+            cJSON_AddBoolToObject(a, "shuffle", true);
+        } },
+        { typed_play, untyped_play, "error: Missing valid argument: song",
+            [](cJSON* a) { cJSON_AddNumberToObject(a, "repeat", 3); } },
+    };
+    for (auto& c : cases) {
+        cJSON* arguments = cJSON_CreateObject();
+        c.build(arguments);
+        auto typed = Call(c.typed, arguments);
+        auto untyped = Call(c.untyped, arguments);
+        CHECK_MSG(typed == c.expected, "typed %s: %s", c.typed->name().c_str(), typed.c_str());
+        CHECK_MSG(untyped == c.expected, "untyped %s: %s", c.untyped->name().c_str(), untyped.c_str());
+        cJSON_Delete(arguments);
+    }
+
+    // Arguments that are not an object
+    cJSON* array = cJSON_CreateArray();
+    CHECK(Call(typed_volume, array) == "error: Missing valid argument: volume");
+    CHECK(Call(typed_play, nullptr) == "error: Missing valid argument: song");
+    cJSON_Delete(array);
+
+    auto schema = McpSchema(McpField("song", &PlayArgs::song),
+        McpField("repeat", &PlayArgs::repeat).Range(1, 10).Optional(),
+        McpField("shuffle", &PlayArgs::shuffle).Optional());
+    CHECK(schema.to_json() == "{\"type\":\"object\",\"properties\":{\"song\":{\"type\":\"string\"},"
+        "\"repeat\":{\"type\":\"integer\",\"default\":1,\"minimum\":1,\"maximum\":10},"
+        "\"shuffle\":{\"type\":\"boolean\",\"default\":false}},\"required\":[\"song\"]}");
+
+    delete typed_volume;
+    delete untyped_volume;
+    delete typed_play;
+    delete untyped_play;
+}
+
+struct Cost {
+    double time;
+    double allocations;
+};
+
+static Cost Measure(const McpTool* tool, const cJSON* arguments) {
+    std::string error;
+    size_t results = 0;
+    size_t allocations = heap_allocations;
+    uint64_t start = BenchNow();
+    for (int i = 0; i < BENCH_CALLS; i++) {
+        auto call = tool->Bind(arguments, error);
+        if (call) {
+            results += std::holds_alternative<std::string>(call()) ? 1 : 2;
+        }
+    }
+    uint64_t time = BenchNow() - start;
+    CHECK(results > 0 || !error.empty());
+    return { (double)time / BENCH_CALLS, (double)(heap_allocations - allocations) / BENCH_CALLS };
+}
+
+static void Benchmark() {
+    auto typed_volume = TypedVolume(), untyped_volume = UntypedVolume();
+    auto typed_play = TypedPlay(), untyped_play = UntypedPlay();
+
+    cJSON* volume = cJSON_CreateObject();
+    cJSON_AddNumberToObject(volume, "volume", 70);
+    cJSON* out_of_range = cJSON_CreateObject();
+    cJSON_AddNumberToObject(out_of_range, "volume", 101);
+    cJSON* play = cJSON_CreateObject();
+    cJSON_AddStringToObject(play, "song", "intro");
+    cJSON_AddNumberToObject(play, "repeat", 3);
+    cJSON_AddBoolToObject(play, "shuffle", true);
+
+    struct {
+        const char* name;
+        McpTool* typed;
+        McpTool* untyped;
+        cJSON* arguments;
+    } cases[] = {
+        { "set_volume", typed_volume, untyped_volume, volume },
+        { "set_volume out of range", typed_volume, untyped_volume, out_of_range },
+        { "play, 3 arguments", typed_play, untyped_play, play },
+    };
+    for (auto& c : cases) {
+        auto typed = Measure(c.typed, c.arguments);
+        auto untyped = Measure(c.untyped, c.arguments);
+        printf("%-24s typed %6.0f %s, %.1f allocations; PropertyList %6.0f %s, %.1f allocations (%.1fx)\n",
+            c.name, typed.time, BENCH_UNIT, typed.allocations, untyped.time, BENCH_UNIT, untyped.allocations,
+            untyped.time / typed.time);
+    }
+
+    cJSON_Delete(volume);
+    cJSON_Delete(out_of_range);
+    cJSON_Delete(play);
+    delete typed_volume;
+    delete untyped_volume;
+    delete typed_play;
+    delete untyped_play;
+}
+
+int main() {
+    TestSameResults();
+    Benchmark();
+    return TEST_RESULT();
+}
@@ -0,0 +1,156 @@
+// McpToolsList with 100 tools: paging invariants, cursor walk and the cost of building the pages
+// versus serving a cached one.
+//
+// The tool objects are synthetic strings shaped like McpTool::to_json() output with descriptions
+// of the lengths board tools use; cJSON isn't available on the host, so the per-tool
+// serialization that precedes Build() is not part of the numbers.
+
+#include "mcp_tools_list.h"
+#include "test_common.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static uint64_t BenchNow() { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static uint64_t BenchNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define TOOLS 100
+#define MAX_PAYLOAD_SIZE 8000   // TOOLS_LIST_MAX_PAYLOAD_SIZE
+#define BENCH_ROUNDS 200
+
+static std::vector<std::string> MakeNames(int count) {
+    std::vector<std::string> names;
+    for (int i = 0; i < count; i++) {
+        names.push_back("self.device_" + std::to_string(i) + ".set_level");
+    }
+    return names;
+}
+
+static std::vector<McpToolsList::Tool> MakeTools(const std::vector<std::string>& names) {
+    std::vector<McpToolsList::Tool> tools;
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string description = "Set the level of device " + std::to_string(i) + ".";
+        while (description.size() < 80 + (i * 37) % 320) {
+            description += " If the current level is unknown, call `self.get_device_status` first.";
+        }
+        tools.push_back({ &names[i], "{\"name\":\"" + names[i] + "\",\"description\":\"" + description +
+            "\",\"inputSchema\":{\"type\":\"object\",\"properties\":{\"level\":{\"type\":\"integer\","
+            "\"minimum\":0,\"maximum\":100}},\"required\":[\"level\"]}}" });
+    }
+    return tools;
+}
+
+// Follow nextCursor from the first page, every tool must come back once and in order
+static void TestPaging() {
+    auto names = MakeNames(TOOLS);
+    auto tools = MakeTools(names);
+    McpToolsList list(MAX_PAYLOAD_SIZE);
+    CHECK(list.Build(tools));
+    CHECK(list.pages().size() > 1);
+
+    std::string cursor;
+    size_t next_tool = 0;
+    size_t pages = 0;
+    while (true) {
+        auto page = list.Find(cursor);
+        CHECK_MSG(page != nullptr, "cursor %s", cursor.c_str());
+        if (page == nullptr) {
+            break;
+        }
+        pages++;
+        CHECK(page->data != nullptr && page->size == strlen(page->data));
+        CHECK_MSG(page->size <= MAX_PAYLOAD_SIZE, "page of %u bytes", (unsigned)page->size);
+        std::string json(page->data, page->size);
+        CHECK(json.compare(0, 10, "{\"tools\":[") == 0);
+        CHECK(cursor.empty() || page->cursor == cursor);
+
+        size_t pos = 10;
+        while (next_tool < tools.size() && json.compare(pos, tools[next_tool].json.size(), tools[next_tool].json) == 0) {
+            pos += tools[next_tool].json.size();
+            next_tool++;
+            if (json[pos] == ',') {
+                pos++;
+            }
+        }
+        auto next = json.find("],\"nextCursor\":\"", pos);
+        if (next == std::string::npos) {
+            CHECK(json.compare(pos, std::string::npos, "]}") == 0);
+            break;
+        }
+        CHECK(next == pos);
+        cursor = json.substr(next + 16, json.size() - next - 18);
+    }
+    CHECK_MSG(next_tool == tools.size(), "%u of %u tools listed", (unsigned)next_tool, (unsigned)tools.size());
+    CHECK(pages == list.pages().size());
+    CHECK(list.Find("self.unknown") == nullptr);
+
+    // A tool larger than a page ends the list, tools after it can't be reached
+    std::string huge_name = "self.huge";
+    std::vector<McpToolsList::Tool> with_huge(tools.begin(), tools.begin() + 10);
+    with_huge.push_back({ &huge_name, "{\"name\":\"self.huge\",\"description\":\"" + std::string(MAX_PAYLOAD_SIZE, 'x') + "\"}" });
+    with_huge.insert(with_huge.end(), tools.begin() + 10, tools.end());
+    CHECK(list.Build(with_huge));
+    auto last = list.pages().back();
+    CHECK(last.cursor == "self.huge" && last.data == nullptr);
+    CHECK(list.Find("self.huge") == &list.pages().back());
+
+    McpToolsList empty(MAX_PAYLOAD_SIZE);
+    CHECK(empty.Build({}));
+    CHECK(empty.pages().size() == 1 && strcmp(empty.Find("")->data, "{\"tools\":[]}") == 0);
+}
+
+// Build() is what every tools/list request paid before the cache; a cached page is one append
+// into the reply buffer, as in McpServer::ReplyResult
+static void Benchmark() {
+    auto names = MakeNames(TOOLS);
+    auto tools = MakeTools(names);
+    McpToolsList list(MAX_PAYLOAD_SIZE);
+
+    uint64_t start = BenchNow();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        list.Build(tools);
+    }
+    double build = (double)(BenchNow() - start) / BENCH_ROUNDS;
+
+    size_t bytes = 0;
+    start = BenchNow();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (auto& page : list.pages()) {
+            std::string reply;
+            reply.reserve(page.size + 48);
+            reply += "{\"jsonrpc\":\"2.0\",\"id\":";
+            reply += std::to_string(round);
+            reply += ",\"result\":";
+            reply.append(page.data, page.size);
+            reply += "}";
+            bytes += reply.size();
+        }
+    }
+    double serve = (double)(BenchNow() - start) / BENCH_ROUNDS;
+
+    size_t total = 0;
+    for (auto& page : list.pages()) {
+        total += page.size;
+    }
+    printf("%d tools, %u pages, %u bytes: build %.0f %s, serve all cached pages %.0f %s (%.1fx)\n", TOOLS,
+        (unsigned)list.pages().size(), (unsigned)total, build, BENCH_UNIT, serve, BENCH_UNIT, build / serve);
+    CHECK(bytes > total * BENCH_ROUNDS);
+}
+
+int main() {
+    TestPaging();
+    Benchmark();
+    return TEST_RESULT();
+}
@@ -0,0 +1,278 @@
+// OtaPipeline against a local HTTP stand-in server and a file-backed partition.
+//
+// The server throttles the body and the partition sleeps on every write. A serial
+// download-then-write loop never has a read and a write in progress at the same time; the
+// pipeline should spend most of the shorter side overlapped with the other. Overlap is measured
+// from the callbacks' own intervals, so a loaded machine stretches both sides but doesn't
+// make the check flaky the way a wall-clock bound does.
+
+#include "ota_pipeline.h"
+#include "test_common.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define IMAGE_SIZE (2 * 1024 * 1024 + 1234)
+#define BUFFER_SIZE (32 * 1024)
+#define SERVER_SLICE (8 * 1024)
+#define SERVER_SLICE_DELAY_US 1000   // About 8 MB/s
+#define FLASH_DELAY_US_PER_KB 125    // About 8 MB/s
+
+// Serves one GET with the whole image, or closes the connection after `truncate_at` bytes
+class HttpStandIn {
+public:
+    HttpStandIn(const std::vector<uint8_t>& body, size_t truncate_at) : body_(body), truncate_at_(truncate_at) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listen_fd_, (sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 1);
+        socklen_t length = sizeof(addr);
+        getsockname(listen_fd_, (sockaddr*)&addr, &length);
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread([this]() { Serve(); });
+    }
+
+    ~HttpStandIn() {
+        thread_.join();
+        close(listen_fd_);
+    }
+
+    int port() const { return port_; }
+
+private:
+    const std::vector<uint8_t>& body_;
+    size_t truncate_at_;
+    int listen_fd_;
+    int port_;
+    std::thread thread_;
+
+    void Serve() {
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        std::string request;
+        char c;
+        while (request.find("\r\n\r\n") == std::string::npos && recv(fd, &c, 1, 0) == 1) {
+            request += c;
+        }
+        std::string head = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body_.size()) + "\r\n\r\n";
+        send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+        size_t end = std::min(body_.size(), truncate_at_);
+        for (size_t offset = 0; offset < end; offset += SERVER_SLICE) {
+            size_t size = std::min<size_t>(SERVER_SLICE, end - offset);
+            if (send(fd, body_.data() + offset, size, MSG_NOSIGNAL) != (ssize_t)size) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(SERVER_SLICE_DELAY_US));
+        }
+        close(fd);
+    }
+};
+
+// Plays the part of Http: GET, parse Content-Length, then Read() the body
+class HttpClient {
+public:
+    bool Open(int port) {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (connect(fd_, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            return false;
+        }
+        std::string request = "GET /firmware.bin HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        send(fd_, request.data(), request.size(), MSG_NOSIGNAL);
+
+        std::string head;
+        char c;
+        while (head.find("\r\n\r\n") == std::string::npos && recv(fd_, &c, 1, 0) == 1) {
+            head += c;
+        }
+        auto pos = head.find("Content-Length: ");
+        if (pos == std::string::npos) {
+            return false;
+        }
+        remaining_ = strtoul(head.c_str() + pos + 16, nullptr, 10);
+        return true;
+    }
+
+    int Read(uint8_t* data, size_t size) {
+        if (remaining_ == 0) {
+            return 0;
+        }
+        ssize_t ret = recv(fd_, data, std::min(size, remaining_), 0);
+        if (ret <= 0) {
+            return -1;  // Connection closed before the end of the body
+        }
+        remaining_ -= ret;
+        return ret;
+    }
+
+    ~HttpClient() {
+        close(fd_);
+    }
+
+private:
+    int fd_ = -1;
+    size_t remaining_ = 0;
+};
+
+using Interval = std::pair<int64_t, int64_t>;
+
+static int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t Total(const std::vector<Interval>& intervals) {
+    int64_t total = 0;
+    for (auto& interval : intervals) {
+        total += interval.second - interval.first;
+    }
+    return total;
+}
+
+// Time during which an interval of `a` and one of `b` were both open; each list is in order and
+// doesn't overlap itself, since each side runs on one thread
+static int64_t Overlap(const std::vector<Interval>& a, const std::vector<Interval>& b) {
+    int64_t overlap = 0;
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        int64_t begin = std::max(a[i].first, b[j].first);
+        int64_t end = std::min(a[i].second, b[j].second);
+        overlap += std::max<int64_t>(end - begin, 0);
+        if (a[i].second < b[j].second) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    return overlap;
+}
+
+struct Result {
+    bool success;
+    OtaPipeline::Stats stats;
+    std::vector<uint8_t> partition;
+    std::vector<size_t> progress;
+    std::vector<Interval> reads;
+    std::vector<Interval> writes;
+    int inspected = 0;
+    int written = 0;
+};
+
+// write_fail_at: fail the n-th write (1-based), 0 never; reject: inspect refuses the first buffer
+static Result RunPipeline(const std::vector<uint8_t>& image, size_t truncate_at, int write_fail_at, bool reject) {
+    HttpStandIn server(image, truncate_at);
+    HttpClient http;
+    Result result;
+    if (!http.Open(server.port())) {
+        result.success = false;
+        return result;
+    }
+
+    FILE* partition = tmpfile();
+    OtaPipeline pipeline(BUFFER_SIZE, 2, 4096);
+    result.success = pipeline.Run(
+        [&http, &result](uint8_t* data, size_t size) {
+            int64_t start = NowUs();
+            int ret = http.Read(data, size);
+            result.reads.emplace_back(start, NowUs());
+            return ret;
+        },
+        [&result, reject](const uint8_t*, size_t) {
+            result.inspected++;
+            return !reject;
+        },
+        [&result, partition, write_fail_at](const uint8_t* data, size_t size) {
+            result.written++;
+            if (result.written == write_fail_at) {
+                return false;
+            }
+            int64_t start = NowUs();
+            fwrite(data, 1, size, partition);
+            // Flash erase and program time
+            std::this_thread::sleep_for(std::chrono::microseconds(size / 1024 * FLASH_DELAY_US_PER_KB));
+            result.writes.emplace_back(start, NowUs());
+            return true;
+        },
+        [&result](size_t total, size_t, const OtaPipeline::Stats&) {
+            result.progress.push_back(total);
+        });
+    result.stats = pipeline.stats();
+
+    result.partition.resize(ftell(partition));
+    rewind(partition);
+    size_t read = fread(result.partition.data(), 1, result.partition.size(), partition);
+    result.partition.resize(read);
+    fclose(partition);
+    return result;
+}
+
+int main() {
+    std::vector<uint8_t> image(IMAGE_SIZE);
+    uint32_t seed = 12345;
+    for (auto& b : image) {
+        seed = seed * 1103515245 + 12345;
+        b = seed >> 24;
+    }
+
+    // Full image: the partition must hold exactly the served bytes
+    auto result = RunPipeline(image, image.size(), 0, false);
+    CHECK(result.success);
+    CHECK(result.stats.bytes == image.size());
+    CHECK(result.partition == image);
+    CHECK(result.inspected == (int)((image.size() + BUFFER_SIZE - 1) / BUFFER_SIZE));
+    CHECK(!result.progress.empty() && result.progress.back() == image.size());
+    CHECK(std::is_sorted(result.progress.begin(), result.progress.end()));
+
+    int64_t network_us = (int64_t)(image.size() / SERVER_SLICE) * SERVER_SLICE_DELAY_US;
+    int64_t flash_us = (int64_t)(image.size() / 1024) * FLASH_DELAY_US_PER_KB;
+    printf("%u bytes in %lld ms (%lld KB/s), serial lower bound %lld ms, flash write %lld ms, "
+        "stall: read %lld ms, write %lld ms\n",
+        (unsigned)result.stats.bytes, (long long)result.stats.elapsed_us / 1000,
+        (long long)(result.stats.bytes * 1000 / std::max<int64_t>(result.stats.elapsed_us, 1)),
+        (long long)(network_us + flash_us) / 1000, (long long)result.stats.write_us / 1000,
+        (long long)result.stats.read_stall_us / 1000, (long long)result.stats.write_stall_us / 1000);
+    // Overlapped: most of the flash writes happen while the next buffer is being downloaded
+    int64_t read_us = Total(result.reads), written_us = Total(result.writes);
+    int64_t overlap_us = Overlap(result.reads, result.writes);
+    printf("read %lld ms, write %lld ms, both in progress %lld ms\n", (long long)read_us / 1000,
+        (long long)written_us / 1000, (long long)overlap_us / 1000);
+    CHECK_MSG(overlap_us > std::min(read_us, written_us) / 2, "overlap %lld us", (long long)overlap_us);
+    CHECK(result.stats.write_us >= flash_us);
+
+    // Flash write error: the pipeline stops, drains and reports failure
+    result = RunPipeline(image, image.size(), 3, false);
+    CHECK(!result.success);
+    CHECK(result.written == 3);
+    CHECK(result.partition.size() == 2 * BUFFER_SIZE);
+    CHECK(result.stats.bytes < image.size());
+
+    // Connection dropped half way
+    result = RunPipeline(image, image.size() / 2, 0, false);
+    CHECK(!result.success);
+    CHECK(result.partition.size() <= image.size() / 2);
+    CHECK(std::equal(result.partition.begin(), result.partition.end(), image.begin()));
+
+    // Image rejected by the header check: nothing reaches the partition
+    result = RunPipeline(image, image.size(), 0, true);
+    CHECK(!result.success);
+    CHECK(result.inspected == 1);
+    CHECK(result.written == 0);
+
+    return TEST_RESULT();
+}
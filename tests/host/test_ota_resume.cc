@@ -0,0 +1,432 @@
+// OtaResume against a local HTTP stand-in server that supports Range requests and drops
+// connections at random offsets, with a memory-backed partition and resume point.
+//
+// Upgrade() below follows Ota::Upgrade: pick the resume offset, check the response, write the
+// body through OtaPipeline and save the resume point when OtaResume asks for it. Whatever the
+// drops, the partition must end up holding exactly the served image with the expected SHA-256.
+
+#include "ota_pipeline.h"
+#include "ota_resume.h"
+#include "test_common.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define IMAGE_SIZE (1024 * 1024 + 1234)
+#define PARTITION_SIZE (2 * 1024 * 1024)
+#define PARTITION_ADDRESS 0x110000
+#define BUFFER_SIZE (8 * 1024)
+#define SAVE_INTERVAL (64 * 1024)
+#define SERVER_SLICE (4 * 1024)
+#define MAX_ATTEMPTS 50
+#define FIRMWARE_URL "http://localhost/firmware.bin"
+
+// Serves GETs one connection at a time, honouring "Range: bytes=N-" unless told not to
+class HttpStandIn {
+public:
+    explicit HttpStandIn(const std::vector<uint8_t>& image) : image_(image) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listen_fd_, (sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 4);
+        socklen_t length = sizeof(addr);
+        getsockname(listen_fd_, (sockaddr*)&addr, &length);
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread([this]() { Serve(); });
+    }
+
+    ~HttpStandIn() {
+        shutdown(listen_fd_, SHUT_RDWR);
+        thread_.join();
+        close(listen_fd_);
+    }
+
+    int port() const { return port_; }
+
+    // The next `count` connections are closed at a random offset into their body
+    void DropConnections(int count, uint32_t seed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        drops_ = count;
+        random_.seed(seed);
+    }
+
+    void SetImage(const std::vector<uint8_t>& image) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        image_ = image;
+    }
+
+    void SetRangeSupported(bool supported) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        range_supported_ = supported;
+    }
+
+    // Range start of every request, -1 for requests without one
+    std::vector<long> requests() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return requests_;
+    }
+
+    size_t bytes_served() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return bytes_served_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<uint8_t> image_;
+    bool range_supported_ = true;
+    int drops_ = 0;
+    std::mt19937 random_;
+    std::vector<long> requests_;
+    size_t bytes_served_ = 0;
+    int listen_fd_;
+    int port_;
+    std::thread thread_;
+
+    void Serve() {
+        while (true) {
+            int fd = accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) {
+                break;
+            }
+            std::string request;
+            char c;
+            while (request.find("\r\n\r\n") == std::string::npos && recv(fd, &c, 1, 0) == 1) {
+                request += c;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            long range = -1;
+            auto pos = request.find("Range: bytes=");
+            if (pos != std::string::npos) {
+                range = strtol(request.c_str() + pos + 13, nullptr, 10);
+            }
+            requests_.push_back(range);
+
+            size_t start = range >= 0 && range_supported_ ? std::min<size_t>(range, image_.size()) : 0;
+            size_t body = image_.size() - start;
+            std::string head;
+            if (range >= 0 && range_supported_) {
+                head = "HTTP/1.1 206 Partial Content\r\nContent-Length: " + std::to_string(body) +
+                    "\r\nContent-Range: bytes " + std::to_string(start) + "-" + std::to_string(image_.size() - 1) +
+                    "/" + std::to_string(image_.size()) + "\r\n\r\n";
+            } else {
+                head = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body) + "\r\n\r\n";
+            }
+            send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+
+            size_t end = body;
+            if (drops_ > 0) {
+                drops_--;
+                end = std::uniform_int_distribution<size_t>(0, body - 1)(random_);
+            }
+            for (size_t offset = 0; offset < end; offset += SERVER_SLICE) {
+                size_t size = std::min<size_t>(SERVER_SLICE, end - offset);
+                if (send(fd, image_.data() + start + offset, size, MSG_NOSIGNAL) != (ssize_t)size) {
+                    break;
+                }
+                bytes_served_ += size;
+            }
+            close(fd);
+        }
+    }
+};
+
+// Plays the part of Http: GET with an optional Range, then Read() the body
+class HttpClient {
+public:
+    bool Open(int port, size_t range_start) {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (connect(fd_, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            return false;
+        }
+        std::string request = "GET /firmware.bin HTTP/1.1\r\nHost: localhost\r\n";
+        if (range_start > 0) {
+            request += "Range: bytes=" + std::to_string(range_start) + "-\r\n";
+        }
+        request += "\r\n";
+        send(fd_, request.data(), request.size(), MSG_NOSIGNAL);
+
+        std::string head;
+        char c;
+        while (head.find("\r\n\r\n") == std::string::npos && recv(fd_, &c, 1, 0) == 1) {
+            head += c;
+        }
+        auto pos = head.find("Content-Length: ");
+        if (head.compare(0, 9, "HTTP/1.1 ") != 0 || pos == std::string::npos) {
+            return false;
+        }
+        status_code_ = atoi(head.c_str() + 9);
+        remaining_ = content_length_ = strtoul(head.c_str() + pos + 16, nullptr, 10);
+        return true;
+    }
+
+    int Read(uint8_t* data, size_t size) {
+        if (remaining_ == 0) {
+            return 0;
+        }
+        ssize_t ret = recv(fd_, data, std::min(size, remaining_), 0);
+        if (ret <= 0) {
+            return -1;  // Connection closed before the end of the body
+        }
+        remaining_ -= ret;
+        return ret;
+    }
+
+    void Close() {
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    ~HttpClient() {
+        Close();
+    }
+
+    int status_code() const { return status_code_; }
+    size_t content_length() const { return content_length_; }
+
+private:
+    int fd_ = -1;
+    int status_code_ = 0;
+    size_t content_length_ = 0;
+    size_t remaining_ = 0;
+};
+
+// What survives a reboot: the partition and the resume point in NVS
+struct Device {
+    std::vector<uint8_t> partition = std::vector<uint8_t>(PARTITION_SIZE, 0xff);
+    OtaResume::Point saved;
+    std::string sha256;  // Of the last successful upgrade
+};
+
+static bool Upgrade(Device& device, int port, const std::string& sha256) {
+    OtaResume resume(SAVE_INTERVAL);
+    OtaResume::Point current;
+    current.url = FIRMWARE_URL;
+    current.sha256 = sha256;
+    current.partition = PARTITION_ADDRESS;
+    size_t offset = resume.Begin(device.saved, current, [&device](size_t offset, uint8_t* data, size_t size) {
+        memcpy(data, device.partition.data() + offset, size);
+        return true;
+    });
+
+    HttpClient http;
+    if (!http.Open(port, offset)) {
+        return false;
+    }
+    auto response = resume.CheckResponse(http.status_code(), http.content_length());
+    if (response == OtaResume::kResponseSizeChanged) {
+        http.Close();
+        device.saved = OtaResume::Point();
+        return Upgrade(device, port, sha256);
+    }
+    if (response != OtaResume::kResponseOk || resume.size() > PARTITION_SIZE) {
+        return false;
+    }
+    if (resume.offset() == 0) {
+        device.saved = current;
+        device.saved.size = resume.size();
+    }
+
+    OtaPipeline pipeline(BUFFER_SIZE, 2, 4096);
+    bool success = pipeline.Run(
+        [&http](uint8_t* data, size_t size) {
+            return http.Read(data, size);
+        },
+        nullptr,
+        [&device, &resume](const uint8_t* data, size_t size) {
+            memcpy(device.partition.data() + resume.offset() + resume.written(), data, size);
+            if (resume.Update(data, size)) {
+                device.saved.offset = resume.offset() + resume.written();
+                device.saved.prefix_sha256 = resume.PrefixSha256();
+            }
+            return true;
+        },
+        nullptr);
+    http.Close();
+
+    auto hash = resume.Finish();
+    if (!success || resume.written() != http.content_length()) {
+        return false;
+    }
+    if (!sha256.empty() && hash != sha256) {
+        device.saved = OtaResume::Point();
+        return false;
+    }
+    device.saved = OtaResume::Point();
+    device.sha256 = hash;
+    return true;
+}
+
+static int UpgradeWithRetries(Device& device, int port, const std::string& sha256) {
+    for (int attempt = 1; attempt <= MAX_ATTEMPTS; attempt++) {
+        if (Upgrade(device, port, sha256)) {
+            return attempt;
+        }
+    }
+    return -1;
+}
+
+static std::vector<uint8_t> MakeImage(size_t size, uint32_t seed) {
+    std::vector<uint8_t> image(size);
+    for (auto& b : image) {
+        seed = seed * 1103515245 + 12345;
+        b = seed >> 24;
+    }
+    return image;
+}
+
+static std::string Sha256(const std::vector<uint8_t>& data) {
+    OtaResume hash(SIZE_MAX);
+    hash.Update(data.data(), data.size());
+    return hash.Finish();
+}
+
+static bool PartitionHolds(const Device& device, const std::vector<uint8_t>& image) {
+    return std::equal(image.begin(), image.end(), device.partition.begin());
+}
+
+// Several drops at random offsets, every retry continues from the last saved resume point
+static void TestRandomDrops(uint32_t seed, int drops) {
+    auto image = MakeImage(IMAGE_SIZE, seed);
+    auto sha256 = Sha256(image);
+    HttpStandIn server(image);
+    server.DropConnections(drops, seed);
+    Device device;
+
+    int attempts = UpgradeWithRetries(device, server.port(), sha256);
+    CHECK_MSG(attempts == drops + 1, "seed %u: %d attempts", (unsigned)seed, attempts);
+    CHECK_MSG(PartitionHolds(device, image), "seed %u", (unsigned)seed);
+    CHECK(device.sha256 == sha256);
+    CHECK(device.saved.offset == 0);
+
+    // Retries only ask for what is past the last resume point, which never moves back
+    auto requests = server.requests();
+    CHECK(requests.size() == (size_t)attempts && requests[0] == -1);
+    long last = 0;
+    for (size_t i = 1; i < requests.size(); i++) {
+        long start = std::max(requests[i], 0L);
+        CHECK_MSG(start % SAVE_INTERVAL == 0 && start >= last, "seed %u: request %u at %ld", (unsigned)seed,
+            (unsigned)i, requests[i]);
+        last = start;
+    }
+    // Each drop loses at most the bytes since the last resume point and the buffers in flight
+    size_t limit = image.size() + drops * (SAVE_INTERVAL + 3 * BUFFER_SIZE);
+    CHECK_MSG(server.bytes_served() <= limit, "seed %u: %u bytes served", (unsigned)seed,
+        (unsigned)server.bytes_served());
+    printf("seed %u: %d drops, %u KB served for a %u KB image, resumed at", (unsigned)seed, drops,
+        (unsigned)server.bytes_served() / 1024, (unsigned)image.size() / 1024);
+    for (size_t i = 1; i < requests.size(); i++) {
+        printf(" %ld", requests[i] / 1024);
+    }
+    printf(" KB\n");
+}
+
+// A server without Range support answers 200 with the whole image: start over and still finish
+static void TestRangeNotSupported() {
+    auto image = MakeImage(IMAGE_SIZE, 7);
+    auto sha256 = Sha256(image);
+    HttpStandIn server(image);
+    Device device;
+    server.DropConnections(1, 3);
+    while (device.saved.offset == 0) {
+        Upgrade(device, server.port(), sha256);
+        server.DropConnections(1, 3 + server.requests().size());
+    }
+    server.DropConnections(0, 0);
+    server.SetRangeSupported(false);
+
+    CHECK(Upgrade(device, server.port(), sha256));
+    CHECK(PartitionHolds(device, image));
+    CHECK(device.sha256 == sha256);
+    CHECK(server.requests().back() > 0);
+}
+
+// The image behind the URL grew between attempts (no SHA-256 to tell): 206 with the wrong length
+static void TestSizeChanged() {
+    auto image = MakeImage(IMAGE_SIZE, 11);
+    auto updated = MakeImage(IMAGE_SIZE + 5000, 12);
+    HttpStandIn server(image);
+    Device device;
+    while (device.saved.offset == 0) {
+        server.DropConnections(1, 5 + server.requests().size());
+        Upgrade(device, server.port(), "");
+    }
+    server.DropConnections(0, 0);
+    server.SetImage(updated);
+
+    CHECK(Upgrade(device, server.port(), ""));
+    CHECK(PartitionHolds(device, updated));
+    CHECK(device.sha256 == Sha256(updated));
+    auto requests = server.requests();
+    CHECK(requests.size() >= 3 && requests[requests.size() - 2] > 0 && requests.back() == -1);
+}
+
+// The partition prefix no longer matches its saved hash, or the resume point belongs to another download
+static void TestStalePrefix() {
+    auto image = MakeImage(IMAGE_SIZE, 21);
+    auto sha256 = Sha256(image);
+    HttpStandIn server(image);
+    Device device;
+    while (device.saved.offset == 0) {
+        server.DropConnections(1, 9 + server.requests().size());
+        Upgrade(device, server.port(), sha256);
+    }
+    server.DropConnections(0, 0);
+
+    auto saved = device.saved;
+    bool read = false;
+    auto read_partition = [&device, &read](size_t offset, uint8_t* data, size_t size) {
+        read = true;
+        memcpy(data, device.partition.data() + offset, size);
+        return true;
+    };
+    OtaResume::Point other = saved;
+    other.sha256 = Sha256(MakeImage(100, 1));
+    OtaResume identity(SAVE_INTERVAL);
+    CHECK(identity.Begin(saved, other, read_partition) == 0);
+    CHECK(!read);
+    OtaResume matching(SAVE_INTERVAL);
+    CHECK(matching.Begin(saved, saved, read_partition) == saved.offset);
+    CHECK(matching.PrefixSha256() == saved.prefix_sha256);
+
+    device.partition[100] ^= 0x55;
+    CHECK(Upgrade(device, server.port(), sha256));
+    CHECK(PartitionHolds(device, image));
+    CHECK(server.requests().back() == -1);
+}
+
+int main() {
+    // The host SHA-256 against the FIPS 180-2 "abc" vector
+    OtaResume abc(SIZE_MAX);
+    abc.Update((const uint8_t*)"abc", 3);
+    CHECK(abc.Finish() == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    for (uint32_t seed = 1; seed <= 5; seed++) {
+        TestRandomDrops(seed, 2 + seed);
+    }
+    TestRangeNotSupported();
+    TestSizeChanged();
+    TestStalePrefix();
+    return TEST_RESULT();
+}
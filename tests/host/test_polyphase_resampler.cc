@@ -0,0 +1,205 @@
+// PolyphaseResampler frequency response, streaming behaviour and cost.
+//
+// Each ratio the firmware runs is swept with full-scale-ish tones: the passband up to 0.8 of the
+// lower Nyquist must stay flat, and everything the filter should remove (aliases when decimating,
+// images when interpolating) must sit well below the tone. Tones are measured with a single bin
+// DFT over the settled middle half second of one second of output, on whole-cycle frequencies.
+
+#include "audio/polyphase_resampler.h"
+#include "test_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static uint64_t BenchNow() { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static uint64_t BenchNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define AMPLITUDE 16000
+#define BENCH_ROUNDS 2000
+
+struct Ratio {
+    int input_sample_rate;
+    int output_sample_rate;
+    double min_rejection_db;
+};
+
+// Codec to 16 kHz capture, server rate to codec playback, and the odd 44.1 kHz codec
+static const Ratio kRatios[] = {
+    { 48000, 16000, 60 },
+    { 44100, 16000, 60 },
+    { 24000, 16000, 60 },
+    { 16000, 24000, 60 },
+    { 24000, 48000, 60 },
+    { 16000, 44100, 60 },
+};
+
+// Even frequencies complete whole cycles in the half second window, so the DFT bin doesn't leak
+static double Bin(double frequency) {
+    return 2 * round(frequency / 2);
+}
+
+static std::vector<int16_t> Resample(const Ratio& ratio, double frequency) {
+    PolyphaseResampler resampler;
+    resampler.Configure(ratio.input_sample_rate, ratio.output_sample_rate);
+    std::vector<int16_t> input(ratio.input_sample_rate);
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = (int16_t)lrint(AMPLITUDE * sin(2 * M_PI * frequency * i / ratio.input_sample_rate));
+    }
+    std::vector<int16_t> output(resampler.GetOutputSamples(input.size()));
+    output.resize(resampler.Process(input.data(), input.size(), output.data()));
+    return output;
+}
+
+// Level of `frequency` and of everything else, in dB relative to the input tone
+static void Measure(const std::vector<int16_t>& output, int sample_rate, double frequency,
+    double& tone_db, double& residual_db) {
+    size_t begin = output.size() / 4, end = output.size() * 3 / 4;
+    double re = 0, im = 0, total = 0;
+    for (size_t i = begin; i < end; i++) {
+        re += output[i] * cos(2 * M_PI * frequency * i / sample_rate);
+        im += output[i] * sin(2 * M_PI * frequency * i / sample_rate);
+        total += (double)output[i] * output[i];
+    }
+    size_t n = end - begin;
+    double amplitude = 2 * sqrt(re * re + im * im) / n;
+    double residual = std::max(total / n - amplitude * amplitude / 2, 1e-3);
+    tone_db = 20 * log10(amplitude / AMPLITUDE);
+    residual_db = 10 * log10(residual / (AMPLITUDE * AMPLITUDE / 2.0));
+}
+
+static void TestFrequencyResponse(const Ratio& ratio) {
+    int lower = std::min(ratio.input_sample_rate, ratio.output_sample_rate);
+    double tone_db, residual_db;
+
+    double passband_min = 1e9, passband_max = -1e9;
+    for (double frequency = 100; frequency <= 0.4 * lower; frequency += lower / 97.0) {
+        double f = Bin(frequency);
+        Measure(Resample(ratio, f), ratio.output_sample_rate, f, tone_db, residual_db);
+        passband_min = std::min(passband_min, tone_db);
+        passband_max = std::max(passband_max, tone_db);
+    }
+
+    // Decimating: tones above 0.56 of the lower rate only come out as aliases.
+    // Interpolating: tones in the passband come out with their images around the input rate.
+    double rejection = 1e9;
+    if (ratio.input_sample_rate > ratio.output_sample_rate) {
+        for (double frequency = 0.56 * lower; frequency < ratio.input_sample_rate / 2.0;
+             frequency += ratio.input_sample_rate / 211.0) {
+            double f = Bin(frequency);
+            Measure(Resample(ratio, f), ratio.output_sample_rate, f, tone_db, residual_db);
+            rejection = std::min(rejection, -residual_db);
+        }
+    } else {
+        for (double frequency = 100; frequency <= 0.4 * lower; frequency += lower / 97.0) {
+            double f = Bin(frequency);
+            Measure(Resample(ratio, f), ratio.output_sample_rate, f, tone_db, residual_db);
+            rejection = std::min(rejection, tone_db - residual_db);
+        }
+    }
+
+    printf("%5d -> %5d Hz: passband %+.3f..%+.3f dB, rejection %.1f dB\n", ratio.input_sample_rate,
+        ratio.output_sample_rate, passband_min, passband_max, rejection);
+    CHECK_MSG(passband_min > -0.1 && passband_max < 0.1, "%d -> %d", ratio.input_sample_rate, ratio.output_sample_rate);
+    CHECK_MSG(rejection >= ratio.min_rejection_db, "%d -> %d: %.1f dB", ratio.input_sample_rate,
+        ratio.output_sample_rate, rejection);
+}
+
+// Random chunk sizes and a strided channel must give exactly the one-shot mono output
+static void TestStreaming(const Ratio& ratio) {
+    std::vector<int16_t> input(ratio.input_sample_rate);
+    srand(1);
+    for (auto& sample : input) {
+        sample = (int16_t)(rand() % 40000 - 20000);
+    }
+
+    PolyphaseResampler one_shot, chunked, strided;
+    one_shot.Configure(ratio.input_sample_rate, ratio.output_sample_rate);
+    chunked.Configure(ratio.input_sample_rate, ratio.output_sample_rate);
+    strided.Configure(ratio.input_sample_rate, ratio.output_sample_rate);
+
+    std::vector<int16_t> expected(one_shot.GetOutputSamples(input.size()));
+    expected.resize(one_shot.Process(input.data(), input.size(), expected.data()));
+
+    std::vector<int16_t> output, chunk(chunked.GetOutputSamples(1000));
+    for (size_t offset = 0; offset < input.size();) {
+        size_t samples = std::min<size_t>(1 + rand() % 999, input.size() - offset);
+        size_t produced = chunked.Process(input.data() + offset, samples, chunk.data());
+        output.insert(output.end(), chunk.begin(), chunk.begin() + produced);
+        offset += samples;
+    }
+    CHECK_MSG(output == expected, "%d -> %d chunked", ratio.input_sample_rate, ratio.output_sample_rate);
+
+    std::vector<int16_t> interleaved(input.size() * 2), interleaved_output(expected.size() * 2 + 2);
+    for (size_t i = 0; i < input.size(); i++) {
+        interleaved[i * 2] = input[i];
+        interleaved[i * 2 + 1] = -input[i];
+    }
+    size_t produced = strided.Process(interleaved.data(), input.size(), interleaved_output.data(), 2);
+    bool equal = produced == expected.size();
+    for (size_t i = 0; equal && i < produced; i++) {
+        equal = interleaved_output[i * 2] == expected[i];
+    }
+    CHECK_MSG(equal, "%d -> %d strided", ratio.input_sample_rate, ratio.output_sample_rate);
+}
+
+// Resamplers on the same ratio use one table, a reconfigured one moves to the table of its new ratio
+static void TestSharedTables() {
+    PolyphaseResampler input, reference, playback;
+    input.Configure(48000, 16000);
+    reference.Configure(48000, 16000);
+    playback.Configure(24000, 48000);
+    CHECK(input.coefficients() == reference.coefficients());
+    CHECK(input.coefficients() != playback.coefficients());
+
+    reference.Configure(24000, 48000);
+    CHECK(reference.coefficients() == playback.coefficients());
+    {
+        PolyphaseResampler stream;
+        stream.Configure(16000, 24000);
+        CHECK(stream.coefficients() != playback.coefficients());
+    }
+}
+
+// Cycles per output sample over 60 ms input frames, the OPUS_FRAME_DURATION_MS chunks the service feeds
+static void Benchmark(const Ratio& ratio) {
+    PolyphaseResampler resampler;
+    resampler.Configure(ratio.input_sample_rate, ratio.output_sample_rate);
+    std::vector<int16_t> input(ratio.input_sample_rate * 60 / 1000);
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = (int16_t)lrint(AMPLITUDE * sin(2 * M_PI * 440 * i / ratio.input_sample_rate));
+    }
+    std::vector<int16_t> output(resampler.GetOutputSamples(input.size()));
+    size_t produced = 0;
+    uint64_t start = BenchNow();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        produced += resampler.Process(input.data(), input.size(), output.data());
+    }
+    double per_sample = (double)(BenchNow() - start) / produced;
+    printf("%5d -> %5d Hz: %d taps, %.1f %s per output sample on this host\n", ratio.input_sample_rate,
+        ratio.output_sample_rate, resampler.taps(), per_sample, BENCH_UNIT);
+}
+
+int main() {
+    for (auto& ratio : kRatios) {
+        TestFrequencyResponse(ratio);
+        TestStreaming(ratio);
+    }
+    TestSharedTables();
+    for (auto& ratio : kRatios) {
+        Benchmark(ratio);
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,120 @@
+// NoAudioCodec sample format kernels against the code they replaced, plus cycles per sample.
+//
+// The reference Write computed the gain with pow() and saturated every sample through an int64
+// multiply; the reference Read copied the 32-bit slots before converting. The kernels must match
+// them bit for bit at every volume and for lengths that don't divide by the unroll factor.
+
+#include "audio/codecs/sample_format.h"
+#include "test_common.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static uint64_t BenchNow() { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static uint64_t BenchNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define FRAME_SAMPLES 960
+#define BENCH_ROUNDS 20000
+
+static void ReferenceWrite(const int16_t* data, int samples, int volume, std::vector<int32_t>& output) {
+    std::vector<int32_t> buffer(samples);
+    int32_t gain = pow((double)volume / 100.0, 2) * 65536;
+    for (int i = 0; i < samples; i++) {
+        int64_t value = (int64_t)data[i] * gain;
+        buffer[i] = value > INT32_MAX ? INT32_MAX : value < INT32_MIN ? INT32_MIN : (int32_t)value;
+    }
+    output.swap(buffer);
+}
+
+static void ReferenceRead(const int32_t* data, int16_t* dest, int samples) {
+    std::vector<int32_t> buffer(data, data + samples);
+    for (int i = 0; i < samples; i++) {
+        int32_t value = buffer[i] >> 12;
+        dest[i] = value > INT16_MAX ? INT16_MAX : value < -INT16_MAX ? -INT16_MAX : (int16_t)value;
+    }
+}
+
+// Keep the compiler from dropping the benchmarked stores
+static void Consume(const void* data) {
+    asm volatile("" : : "r"(data) : "memory");
+}
+
+int main() {
+    uint32_t seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return seed;
+    };
+    std::vector<int16_t> pcm(FRAME_SAMPLES);
+    std::vector<int32_t> slots(FRAME_SAMPLES);
+    for (int i = 0; i < FRAME_SAMPLES; i++) {
+        pcm[i] = (int16_t)(random() >> 16);
+        slots[i] = (int32_t)random();
+    }
+    // Full scale edges
+    pcm[0] = INT16_MIN;
+    pcm[1] = INT16_MAX;
+    slots[0] = INT32_MIN;
+    slots[1] = INT32_MAX;
+
+    std::vector<int32_t> output(FRAME_SAMPLES), expected;
+    for (int volume = 0; volume <= 100; volume++) {
+        for (int samples : { FRAME_SAMPLES, FRAME_SAMPLES - 1, 3, 0 }) {
+            ScaleToInt32(pcm.data(), output.data(), samples, volume * volume * 65536 / 10000);
+            ReferenceWrite(pcm.data(), samples, volume, expected);
+            CHECK_MSG(std::equal(expected.begin(), expected.end(), output.begin()), "volume %d, %d samples",
+                volume, samples);
+        }
+    }
+
+    std::vector<int16_t> dest(FRAME_SAMPLES), dest_expected(FRAME_SAMPLES);
+    for (int samples : { FRAME_SAMPLES, FRAME_SAMPLES - 1, 3 }) {
+        Int32ToInt16(slots.data(), dest.data(), samples);
+        ReferenceRead(slots.data(), dest_expected.data(), samples);
+        CHECK_MSG(std::equal(dest.begin(), dest.begin() + samples, dest_expected.begin()), "%d samples", samples);
+    }
+
+    // Cycles per sample over 60 ms frames at 16 kHz, the reference including its allocation
+    auto per_sample = [](uint64_t start) {
+        return (double)(BenchNow() - start) / BENCH_ROUNDS / FRAME_SAMPLES;
+    };
+    uint64_t start = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        ReferenceWrite(pcm.data(), FRAME_SAMPLES, 70, expected);
+        Consume(expected.data());
+    }
+    double reference_write = per_sample(start);
+    start = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        ScaleToInt32(pcm.data(), output.data(), FRAME_SAMPLES, 70 * 70 * 65536 / 10000);
+        Consume(output.data());
+    }
+    double write = per_sample(start);
+    start = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        ReferenceRead(slots.data(), dest_expected.data(), FRAME_SAMPLES);
+        Consume(dest_expected.data());
+    }
+    double reference_read = per_sample(start);
+    start = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        Int32ToInt16(slots.data(), dest.data(), FRAME_SAMPLES);
+        Consume(dest.data());
+    }
+    double read = per_sample(start);
+    printf("%s per sample on this host: write %.2f (reference %.2f), read %.2f (reference %.2f)\n",
+        BENCH_UNIT, write, reference_write, read, reference_read);
+
+    return TEST_RESULT();
+}
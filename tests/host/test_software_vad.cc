@@ -0,0 +1,304 @@
+// SoftwareVad on labelled synthetic recordings, plus its CPU cost per frame.
+//
+// Each scene is background noise with utterances made of voiced syllables (a glottal pulse train
+// through two formant resonators, with pitch drift and a syllable envelope) and short fricatives.
+// The label of every 20 ms sub-frame is known, so the detector is scored on onset latency, speech
+// recall, release after the hangover and false alarms in the noise between utterances.
+
+#include "audio/processors/software_vad.h"
+#include "test_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#define SAMPLE_RATE 16000
+#define SUBFRAME_SAMPLES 320
+#define FRAME_SAMPLES 960      // OPUS_FRAME_DURATION_MS at 16 kHz, as NoAudioProcessor feeds it
+#define THRESHOLD_DB 9         // Kconfig defaults
+#define HANGOVER_MS 600
+
+class Random {
+public:
+    explicit Random(uint32_t seed) : state_(seed) {}
+    // Uniform in [-1, 1)
+    double Next() {
+        state_ = state_ * 1664525u + 1013904223u;
+        return (int32_t)state_ / 2147483648.0;
+    }
+
+private:
+    uint32_t state_;
+};
+
+// Two-pole resonator used as a formant
+class Resonator {
+public:
+    Resonator(double frequency, double bandwidth) {
+        double r = exp(-M_PI * bandwidth / SAMPLE_RATE);
+        a1_ = 2 * r * cos(2 * M_PI * frequency / SAMPLE_RATE);
+        a2_ = -r * r;
+        gain_ = 1 - r;
+    }
+    double Process(double x) {
+        double y = gain_ * x + a1_ * y1_ + a2_ * y2_;
+        y2_ = y1_;
+        y1_ = y;
+        return y;
+    }
+
+private:
+    double a1_, a2_, gain_;
+    double y1_ = 0, y2_ = 0;
+};
+
+enum NoiseType { kNoiseWhite, kNoiseHiss, kNoisePink };
+
+struct Scene {
+    const char* name;
+    NoiseType noise;
+    double noise_dbfs;
+    double speech_dbfs;
+    // Background steps up to its level after this many seconds
+    double noise_start_s;
+};
+
+struct Recording {
+    std::vector<int16_t> samples;
+    std::vector<bool> speech;  // Per sub-frame
+    std::vector<std::pair<size_t, size_t>> utterances;  // Sub-frame ranges [begin, end)
+};
+
+static double DbfsToAmplitude(double dbfs) {
+    return 32768.0 * pow(10.0, dbfs / 20.0);
+}
+
+// 4 s of noise, then 3 utterances of 5-8 syllables separated by 1.5-2.5 s of noise
+static Recording Synthesize(const Scene& scene, uint32_t seed) {
+    Random random(seed);
+    Recording recording;
+    std::vector<double> signal;
+    std::vector<bool> speech_samples;
+
+    auto silence = [&](double seconds) {
+        size_t count = (size_t)(seconds * SAMPLE_RATE);
+        signal.insert(signal.end(), count, 0.0);
+        speech_samples.insert(speech_samples.end(), count, false);
+    };
+
+    double pitch = 140;
+    silence(4.0);
+    for (int utterance = 0; utterance < 3; utterance++) {
+        size_t begin = signal.size();
+        int syllables = 5 + (int)((random.Next() + 1) * 1.5);
+        for (int s = 0; s < syllables; s++) {
+            // Some syllables open with a fricative
+            if (s % 3 == 1) {
+                size_t count = SAMPLE_RATE * 60 / 1000;
+                double last = 0;
+                for (size_t i = 0; i < count; i++) {
+                    double white = random.Next();
+                    signal.push_back((white - last) * 0.1);
+                    speech_samples.push_back(true);
+                    last = white;
+                }
+            }
+
+            Resonator f1(500 + 300 * (random.Next() + 1), 90);
+            Resonator f2(1100 + 600 * (random.Next() + 1), 120);
+            size_t count = SAMPLE_RATE * (140 + (int)((random.Next() + 1) * 60)) / 1000;
+            double phase = 0;
+            for (size_t i = 0; i < count; i++) {
+                pitch = std::clamp(pitch + random.Next() * 0.5, 100.0, 240.0);
+                phase += pitch / SAMPLE_RATE;
+                double pulse = 0;
+                if (phase >= 1) {
+                    phase -= 1;
+                    pulse = 1;
+                }
+                double envelope = sin(M_PI * i / count);
+                double x = f1.Process(pulse) * 2.5 + f2.Process(pulse);
+                signal.push_back(x * envelope);
+                speech_samples.push_back(true);
+            }
+
+            // Gaps between syllables are shorter than the hangover and stay labelled speech
+            size_t gap = SAMPLE_RATE * (40 + (int)((random.Next() + 1) * 60)) / 1000;
+            signal.insert(signal.end(), gap, 0.0);
+            speech_samples.insert(speech_samples.end(), gap, true);
+        }
+        recording.utterances.push_back({ begin / SUBFRAME_SAMPLES, signal.size() / SUBFRAME_SAMPLES });
+        silence(1.5 + (random.Next() + 1) * 0.5);
+    }
+
+    // Scale the speech so its RMS over the labelled speech is at the nominal level
+    double speech_power = 0;
+    size_t speech_count = 0;
+    for (size_t i = 0; i < signal.size(); i++) {
+        if (speech_samples[i]) {
+            speech_power += signal[i] * signal[i];
+            speech_count++;
+        }
+    }
+    double speech_gain = DbfsToAmplitude(scene.speech_dbfs) / sqrt(speech_power / speech_count);
+    for (auto& x : signal) {
+        x *= speech_gain;
+    }
+
+    // Background noise over the whole scene, also scaled to its nominal RMS
+    size_t noise_start = (size_t)(scene.noise_start_s * SAMPLE_RATE);
+    std::vector<double> noise(signal.size());
+    double last = 0;
+    double pink[3] = { 0, 0, 0 };
+    double highpass = 0, last_value = 0;
+    double noise_power = 0;
+    for (size_t i = 0; i < signal.size(); i++) {
+        double white = random.Next();
+        double value = white;
+        if (scene.noise == kNoiseHiss) {
+            value = white - last;
+        } else if (scene.noise == kNoisePink) {
+            pink[0] = 0.997 * pink[0] + 0.029591 * white;
+            pink[1] = 0.985 * pink[1] + 0.032534 * white;
+            pink[2] = 0.950 * pink[2] + 0.048056 * white;
+            value = pink[0] + pink[1] + pink[2] + 0.05 * white;
+        }
+        last = white;
+        // The codec high-pass filter removes the rumble below about 100 Hz
+        highpass = 0.96 * (highpass + value - last_value);
+        last_value = value;
+        value = scene.noise == kNoisePink ? highpass : value;
+        noise[i] = value;
+        noise_power += value * value;
+    }
+    double noise_gain = DbfsToAmplitude(scene.noise_dbfs) / sqrt(noise_power / noise.size());
+    for (size_t i = 0; i < signal.size(); i++) {
+        // 30 dB quieter before a background step
+        signal[i] += noise[i] * (i < noise_start ? noise_gain / 32 : noise_gain);
+    }
+
+    recording.samples.resize(signal.size() / SUBFRAME_SAMPLES * SUBFRAME_SAMPLES);
+    for (size_t i = 0; i < recording.samples.size(); i++) {
+        recording.samples[i] = (int16_t)std::clamp(signal[i], -32768.0, 32767.0);
+    }
+    for (size_t i = 0; i + SUBFRAME_SAMPLES <= recording.samples.size(); i += SUBFRAME_SAMPLES) {
+        recording.speech.push_back(speech_samples[i + SUBFRAME_SAMPLES / 2]);
+    }
+    return recording;
+}
+
+struct Score {
+    int max_onset_ms = 0;
+    int max_release_ms = 0;
+    int missed_utterances = 0;
+    double recall = 0;        // Labelled speech sub-frames reported as speaking, after the onset
+    double false_alarm = 0;   // Noise sub-frames reported as speaking, outside the hangover window
+};
+
+// Noise before `first_scored_subframe` is not scored, the floor is still adapting there
+static Score Evaluate(const Recording& recording, size_t first_scored_subframe) {
+    SoftwareVad vad(THRESHOLD_DB, HANGOVER_MS);
+    std::vector<bool> speaking;
+    for (size_t i = 0; i < recording.speech.size(); i++) {
+        vad.Process(recording.samples.data() + i * SUBFRAME_SAMPLES, SUBFRAME_SAMPLES);
+        speaking.push_back(vad.speaking());
+    }
+
+    Score score;
+    int speech_total = 0, speech_hit = 0;
+    int noise_total = 0, noise_hit = 0;
+    size_t hangover_subframes = HANGOVER_MS / 20;
+    for (auto& [begin, end] : recording.utterances) {
+        size_t onset = begin;
+        while (onset < end && !speaking[onset]) {
+            onset++;
+        }
+        if (onset == end) {
+            score.missed_utterances++;
+            continue;
+        }
+        score.max_onset_ms = std::max(score.max_onset_ms, (int)(onset - begin) * 20);
+        for (size_t i = onset; i < end; i++) {
+            speech_total++;
+            speech_hit += speaking[i];
+        }
+        size_t release = end;
+        while (release < speaking.size() && speaking[release]) {
+            release++;
+        }
+        score.max_release_ms = std::max(score.max_release_ms, (int)(release - end) * 20);
+    }
+
+    // Noise sub-frames, skipping each hangover window
+    size_t after_utterance = 0;
+    for (size_t i = first_scored_subframe; i < recording.speech.size(); i++) {
+        if (recording.speech[i]) {
+            after_utterance = i + 1 + hangover_subframes + 5;
+            continue;
+        }
+        if (i < after_utterance) {
+            continue;
+        }
+        noise_total++;
+        noise_hit += speaking[i];
+    }
+    score.recall = speech_total > 0 ? (double)speech_hit / speech_total : 0;
+    score.false_alarm = noise_total > 0 ? (double)noise_hit / noise_total : 0;
+    return score;
+}
+
+static void TestScenes() {
+    static const Scene scenes[] = {
+        { "quiet room, 40 dB SNR", kNoiseWhite, -65, -25, 0 },
+        { "white noise, 20 dB SNR", kNoiseWhite, -45, -25, 0 },
+        { "pink noise, 15 dB SNR", kNoisePink, -40, -25, 0 },
+        { "hiss, 15 dB SNR", kNoiseHiss, -40, -25, 0 },
+        { "hiss switched on after 1 s", kNoiseHiss, -40, -25, 1.0 },
+        { "noise switched on after 1 s", kNoiseWhite, -45, -25, 1.0 },
+        { "soft speech, 12 dB SNR", kNoiseWhite, -50, -38, 0 },
+    };
+
+    for (auto& scene : scenes) {
+        for (uint32_t seed = 1; seed <= 3; seed++) {
+            auto recording = Synthesize(scene, seed * 7919);
+            // 1 s for the floor to settle at start-up; after a background step the minimum window
+            // (up to 1.6 s) and the hangover have to pass as well
+            double settle_s = scene.noise_start_s > 0 ? scene.noise_start_s + 1.6 + HANGOVER_MS / 1000.0 + 0.1 : 1.0;
+            auto score = Evaluate(recording, (size_t)(settle_s * 50));
+            printf("%-28s seed %u: onset %3d ms, release %3d ms, recall %5.1f%%, false alarm %4.1f%%, missed %d\n",
+                scene.name, (unsigned)seed, score.max_onset_ms, score.max_release_ms, score.recall * 100,
+                score.false_alarm * 100, score.missed_utterances);
+            CHECK_MSG(score.missed_utterances == 0, "%s", scene.name);
+            CHECK_MSG(score.max_onset_ms <= 100, "%s onset %d ms", scene.name, score.max_onset_ms);
+            CHECK_MSG(score.recall >= 0.95, "%s recall %.3f", scene.name, score.recall);
+            CHECK_MSG(score.max_release_ms <= HANGOVER_MS + 100, "%s release %d ms", scene.name, score.max_release_ms);
+            CHECK_MSG(score.false_alarm <= 0.02, "%s false alarm %.3f", scene.name, score.false_alarm);
+        }
+    }
+}
+
+// Host time per 60 ms frame; the device logs its own average in the VAD stats
+static void Benchmark() {
+    auto recording = Synthesize({ "benchmark", kNoiseWhite, -45, -25, 0 }, 1);
+    SoftwareVad vad(THRESHOLD_DB, HANGOVER_MS);
+    size_t frames = recording.samples.size() / FRAME_SAMPLES;
+    int speech_frames = 0;
+    const int rounds = 50;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < frames; i++) {
+            speech_frames += vad.Process(recording.samples.data() + i * FRAME_SAMPLES, FRAME_SAMPLES);
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    printf("benchmark: %.0f ns per 60 ms frame (%.1f ns per sample) on this host, %d speech frames\n",
+        elapsed / (frames * rounds), elapsed / (frames * rounds * FRAME_SAMPLES), speech_frames);
+}
+
+int main() {
+    TestScenes();
+    Benchmark();
+    return TEST_RESULT();
+}
@@ -0,0 +1,177 @@
+// WakeWordEncoder against the buffering it replaced: detection-to-first-packet and
+// detection-to-last-packet latency, and how many frames are left to encode after detection.
+//
+// The Opus encoder is a stand-in (stubs/opus_encoder.h) that spins for ENCODE_FRAME_US per
+// frame, so the latencies scale with that assumed cost, not with a device measurement. The
+// firmware logs the real per-frame cost when a window is sealed. The frame counts don't depend
+// on it: the old buffer encoded the whole window after detection, the new one at most the tail.
+
+#include "audio/wake_words/wake_word_encoder.h"
+#include "test_common.h"
+
+#include <esp_timer.h>
+#include <opus_encoder.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define SAMPLE_RATE 16000
+#define FRAME_DURATION_MS 60
+#define FRAME_SAMPLES (SAMPLE_RATE * FRAME_DURATION_MS / 1000)
+#define WINDOW_MS 2000
+#define CHUNK_SAMPLES 512           // AFE fetch size at 16 kHz, 32 ms
+#define CHUNK_INTERVAL_US 8000      // 4x real time
+#define ENCODE_FRAME_US 5000        // Assumed cost of one 60 ms frame at complexity 0
+
+// Every sample holds the low 16 bits of its position, so a packet names the frame it encodes
+static std::vector<int16_t> Chunk(uint32_t position) {
+    std::vector<int16_t> chunk(CHUNK_SAMPLES);
+    for (size_t i = 0; i < chunk.size(); i++) {
+        chunk[i] = (int16_t)(position + i);
+    }
+    return chunk;
+}
+
+static uint16_t FrameStart(const std::vector<uint8_t>& packet) {
+    uint16_t start;
+    memcpy(&start, packet.data(), sizeof(start));
+    return start;
+}
+
+// The buffering before WakeWordEncoder: a deque of chunks, all encoded on a new task with a new
+// encoder after detection
+class LegacyWakeWordBuffer {
+public:
+    void Store(const int16_t* data, size_t samples) {
+        pcm_.emplace_back(std::vector<int16_t>(data, data + samples));
+        while (pcm_.size() > 2000 / 30) {
+            pcm_.pop_front();
+        }
+    }
+
+    void Seal() {
+        std::thread([this]() {
+            auto encoder = std::make_unique<OpusEncoderWrapper>(SAMPLE_RATE, 1, FRAME_DURATION_MS);
+            std::vector<int16_t> frame;
+            for (auto& pcm : pcm_) {
+                frame.insert(frame.end(), pcm.begin(), pcm.end());
+                while (frame.size() >= FRAME_SAMPLES) {
+                    std::vector<int16_t> input(frame.begin(), frame.begin() + FRAME_SAMPLES);
+                    frame.erase(frame.begin(), frame.begin() + FRAME_SAMPLES);
+                    std::vector<uint8_t> opus;
+                    encoder->Encode(std::move(input), opus);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    opus_.push_back(std::move(opus));
+                    cv_.notify_all();
+                }
+            }
+            pcm_.clear();
+            std::lock_guard<std::mutex> lock(mutex_);
+            opus_.push_back(std::vector<uint8_t>());
+            cv_.notify_all();
+        }).detach();
+    }
+
+    bool Pop(std::vector<uint8_t>& opus) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return !opus_.empty(); });
+        opus.swap(opus_.front());
+        opus_.pop_front();
+        return !opus.empty();
+    }
+
+private:
+    std::deque<std::vector<int16_t>> pcm_;
+    std::deque<std::vector<uint8_t>> opus_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+struct Latency {
+    std::vector<std::vector<uint8_t>> packets;
+    int encoded_after_detection;
+    int64_t first_us;
+    int64_t last_us;
+};
+
+// Feed `samples` at CHUNK_INTERVAL_US per chunk from `position`, then detect and drain
+template <typename Buffer>
+static Latency Detect(Buffer& buffer, uint32_t position, uint32_t samples) {
+    for (uint32_t fed = 0; fed < samples; fed += CHUNK_SAMPLES) {
+        auto chunk = Chunk(position + fed);
+        buffer.Store(chunk.data(), chunk.size());
+        std::this_thread::sleep_for(std::chrono::microseconds(CHUNK_INTERVAL_US));
+    }
+
+    Latency latency;
+    int encoded = host_opus_encode_count;
+    int64_t detected = esp_timer_get_time();
+    buffer.Seal();
+    std::vector<uint8_t> opus;
+    while (buffer.Pop(opus)) {
+        if (latency.packets.empty()) {
+            latency.first_us = esp_timer_get_time() - detected;
+        }
+        latency.packets.push_back(opus);
+    }
+    latency.last_us = esp_timer_get_time() - detected;
+    latency.encoded_after_detection = host_opus_encode_count - encoded;
+    return latency;
+}
+
+// Packets must be consecutive frames starting at `first`
+static void CheckWindow(const Latency& latency, uint32_t first, size_t packets) {
+    CHECK_MSG(latency.packets.size() == packets, "%u packets", (unsigned)latency.packets.size());
+    for (size_t i = 0; i < latency.packets.size(); i++) {
+        CHECK_MSG(FrameStart(latency.packets[i]) == (uint16_t)(first + i * FRAME_SAMPLES), "packet %u starts at %u",
+            (unsigned)i, (unsigned)FrameStart(latency.packets[i]));
+    }
+}
+
+int main() {
+    host_opus_encode_us = ENCODE_FRAME_US;
+    const uint32_t samples = 94 * CHUNK_SAMPLES;  // 3 s: 50 frames and a 128 sample tail
+    const size_t window = WINDOW_MS / FRAME_DURATION_MS;
+
+    LegacyWakeWordBuffer legacy;
+    auto before = Detect(legacy, 0, samples);
+    // 66 chunks of 512 samples, the partial frame at the end is dropped
+    CheckWindow(before, samples - 66 * CHUNK_SAMPLES, 66 * CHUNK_SAMPLES / FRAME_SAMPLES);
+
+    // Destroying the encoder deletes its task, which the host stubs can't do; it lives for the
+    // whole process, as it does in the firmware
+    auto encoder = new WakeWordEncoder(WINDOW_MS, FRAME_DURATION_MS);
+    encoder->Reset();
+    auto after = Detect(*encoder, 0, samples);
+    // The latest full frames plus the zero padded tail
+    CheckWindow(after, (samples / FRAME_SAMPLES - window) * FRAME_SAMPLES, window + 1);
+    // The encoder keeps up with the feed, only the tail (and a frame completed by the last
+    // chunk) can be left at detection
+    CHECK_MSG(after.encoded_after_detection <= 2, "%d frames encoded after detection", after.encoded_after_detection);
+
+    printf("before: %u packets, %d encoded after detection, first packet %.1f ms, last %.1f ms\n",
+        (unsigned)before.packets.size(), before.encoded_after_detection, before.first_us / 1000.0,
+        before.last_us / 1000.0);
+    printf("after:  %u packets, %d encoded after detection, first packet %.1f ms, last %.1f ms\n",
+        (unsigned)after.packets.size(), after.encoded_after_detection, after.first_us / 1000.0,
+        after.last_us / 1000.0);
+    printf("idle cost: one %d us encode per %d ms frame, %.1f%% of one core (assumed encode cost)\n",
+        ENCODE_FRAME_US, FRAME_DURATION_MS, 100.0 * ENCODE_FRAME_US / (FRAME_DURATION_MS * 1000));
+
+    // Reset() drops the window, the next one starts at the reset
+    encoder->Reset();
+    auto again = Detect(*encoder, samples, 20 * CHUNK_SAMPLES);
+    CheckWindow(again, samples, 20 * CHUNK_SAMPLES / FRAME_SAMPLES + 1);
+
+    // Pop() before Seal() has nothing to hand out
+    encoder->Reset();
+    std::vector<uint8_t> opus;
+    CHECK(!encoder->Pop(opus));
+    return TEST_RESULT();
+}